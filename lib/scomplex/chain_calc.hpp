@@ -1,5 +1,7 @@
 #pragma once
 
+#include <scomplex/memory.hpp>
+#include <scomplex/metrics.hpp>
 #include <scomplex/simplicial_complex.hpp>
 #include <scomplex/types.hpp>
 
@@ -28,6 +30,8 @@ class bounding_chain {
     bounding_chain(std::vector<point_t>& points, std::vector<cell_t>& tris);
     ~bounding_chain();
     chain_t get_bounding_chain(chain_t&);
+    // the solver's own copies of the boundary matrices
+    memory_report get_memory_report();
 };
 
 //---------------------------------------
@@ -52,6 +56,7 @@ bounding_chain::bounding_chain(std::vector<point_t>& points,
 }
 
 void bounding_chain::populate_matrices() {
+    GSIMP_PHASE("solver.matrices");
     for (int d = 0; d < s_comp->dimension(); ++d) {
         auto level_matrix = s_comp->get_boundary_matrix(d);
         boundary_matrices.push_back(
@@ -59,6 +64,14 @@ void bounding_chain::populate_matrices() {
     }
 }
 
+memory_report bounding_chain::get_memory_report() {
+    memory_report report;
+    for (size_t d = 0; d < boundary_matrices.size(); ++d)
+        report.add("boundary_matrices[" + std::to_string(d) + "]",
+                   memory::matrix_bytes(*boundary_matrices[d]));
+    return report;
+}
+
 // round vectors for comparison
 vector_t round_vec(vector_t vec) {
     vector_t rounded_vec(vec.rows());
@@ -69,14 +82,10 @@ vector_t round_vec(vector_t vec) {
     return rounded_vec;
 }
 
+// quiet, callers (the query server on stdout among them) report mismatches
 bool equals(vector_t vec1, vector_t vec2) {
-    for (int i = 0; i < vec1.rows(); ++i) {
-        if (vec1.coeffRef(i) != vec2.coeffRef(i)) {
-            std::cout << i << ": " << vec1.coeffRef(i) << " "
-                      << vec2.coeffRef(i) << '\n';
-            return false;
-        }
-    }
+    for (int i = 0; i < vec1.rows(); ++i)
+        if (vec1.coeffRef(i) != vec2.coeffRef(i)) return false;
     return true;
 }
 
@@ -85,12 +94,14 @@ chain_t bounding_chain::get_bounding_chain(chain_t& chain) {
     vector_t chain_v;
     std::tie<int, vector_t>(chain_d, chain_v) = chain;
 
+    GSIMP_PHASE("solver.lscg");
     if (chain_d >= s_comp->dimension()) throw non_zero_chain();
 
     Eigen::LeastSquaresConjugateGradient<matrix_t> lscg;
     lscg.compute(*(boundary_matrices.at(chain_d)));
 
     vector_t bound_chain(round_vec(lscg.solve(chain_v)));
+    GSIMP_HISTOGRAM("solver.lscg_iterations", lscg.iterations());
     vector_t result(round_vec(*(boundary_matrices.at(chain_d)) * bound_chain));
 
     if (equals(result, chain_v))
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <scomplex/simplicial_complex.hpp>
+#include <scomplex/types.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gsimp {
+
+/*
+ * sparse on-disk format for chains
+ *
+ * file:
+ *   magic "GSCH", format version (1 byte)
+ *   header: varint length + snapshot name, varint number of levels,
+ *           varint size of each level of the complex
+ *   records, appended one after the other until the end of the file
+ *
+ * record:
+ *   varint payload length (bytes after this field)
+ *   varint dimension, varint number of nonzero coefficients
+ *   varint gaps between consecutive sorted indices (the first is absolute)
+ *   zigzag varint coefficients
+ *
+ * coefficients have to be integers, the size of a chain is the size of its
+ * level in the header.
+ */
+
+typedef std::vector<std::pair<size_t, int64_t>> chain_support_t;
+
+struct chain_file_header {
+    std::string snapshot;
+    std::vector<size_t> level_sizes;
+
+    bool operator==(const chain_file_header& other) const {
+        return snapshot == other.snapshot && level_sizes == other.level_sizes;
+    }
+    bool operator!=(const chain_file_header& other) const {
+        return !(*this == other);
+    }
+};
+
+// header describing the complex the chains live in
+inline chain_file_header chain_header(simplicial_complex& s_comp,
+                                      std::string snapshot) {
+    chain_file_header header;
+    header.snapshot = snapshot;
+    for (int d = 0; d <= s_comp.dimension(); ++d)
+        header.level_sizes.push_back(s_comp.get_level_size(d));
+    return header;
+}
+
+namespace chain_io {
+
+const char magic[4] = {'G', 'S', 'C', 'H'};
+const uint8_t version = 1;
+
+inline void put_varint(std::string& out, uint64_t val) {
+    while (val >= 0x80) {
+        out.push_back(char((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    out.push_back(char(val));
+}
+
+inline uint64_t zigzag(int64_t val) {
+    return (uint64_t(val) << 1) ^ uint64_t(val >> 63);
+}
+
+inline int64_t unzigzag(uint64_t val) {
+    return int64_t(val >> 1) ^ -int64_t(val & 1);
+}
+
+// read a varint from [pos, end), advancing pos
+inline uint64_t get_varint(const char*& pos, const char* end) {
+    uint64_t val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == end) throw std::runtime_error("truncated chain record\n");
+        uint8_t byte = uint8_t(*pos++);
+        val |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return val;
+    }
+    throw std::runtime_error("malformed varint in chain file\n");
+}
+
+inline uint64_t get_varint(std::istream& in) {
+    uint64_t val = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == EOF) throw std::runtime_error("truncated chain file\n");
+        val |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return val;
+    }
+    throw std::runtime_error("malformed varint in chain file\n");
+}
+
+inline int64_t to_integer(double coef) {
+    double rounded = std::round(coef);
+    // int64_t holds less than 2^63 either way
+    if (rounded != coef || !(std::fabs(rounded) < 9223372036854775808.0))
+        throw std::runtime_error("chain coefficients must be integers (got " +
+                                 std::to_string(coef) + ")\n");
+    return int64_t(rounded);
+}
+
+inline std::string encode_header(const chain_file_header& header) {
+    std::string out(magic, magic + 4);
+    out.push_back(char(version));
+    put_varint(out, header.snapshot.size());
+    out += header.snapshot;
+    put_varint(out, header.level_sizes.size());
+    for (size_t s : header.level_sizes) put_varint(out, s);
+    return out;
+}
+
+// reads n bytes into out, which only grows as they come in: a length from a
+// corrupt file cannot allocate much more than the file holds
+inline void read_bytes(std::istream& in, uint64_t n, std::string& out) {
+    const uint64_t chunk = 1 << 16;
+    out.clear();
+    while (out.size() < n) {
+        size_t old_size = out.size();
+        out.resize(old_size + std::min(chunk, n - old_size));
+        in.read(&out[old_size], out.size() - old_size);
+        if (size_t(in.gcount()) != out.size() - old_size)
+            throw std::runtime_error("truncated chain file\n");
+    }
+}
+
+// reads the header, returns false on an empty stream
+inline bool decode_header(std::istream& in, chain_file_header& header) {
+    char head[5];
+    in.read(head, 5);
+    if (in.gcount() == 0) return false;
+    if (in.gcount() < 5 || !std::equal(magic, magic + 4, head))
+        throw std::runtime_error("not a chain file\n");
+    if (uint8_t(head[4]) != version)
+        throw std::runtime_error("unsupported chain file version\n");
+    read_bytes(in, get_varint(in), header.snapshot);
+    // every level size takes at least a byte
+    header.level_sizes.clear();
+    for (uint64_t n = get_varint(in); n > 0; --n)
+        header.level_sizes.push_back(get_varint(in));
+    if (!in) throw std::runtime_error("truncated chain file header\n");
+    return true;
+}
+
+// append the record of a chain, support must be sorted by index
+inline void encode_record(std::string& out, int d,
+                          const chain_support_t& support) {
+    std::string payload;
+    put_varint(payload, d);
+    put_varint(payload, support.size());
+    size_t last = 0;
+    for (auto& entry : support) {
+        put_varint(payload, entry.first - last);
+        last = entry.first;
+    }
+    for (auto& entry : support) put_varint(payload, zigzag(entry.second));
+    put_varint(out, payload.size());
+    out += payload;
+}
+
+inline void decode_record(const char* pos, const char* end, int& d,
+                          chain_support_t& support) {
+    d = int(get_varint(pos, end));
+    // every entry takes at least two bytes
+    uint64_t count = get_varint(pos, end);
+    if (count > uint64_t(end - pos) / 2)
+        throw std::runtime_error("truncated chain record\n");
+    support.resize(count);
+    size_t index = 0;
+    for (auto& entry : support) {
+        index += get_varint(pos, end);
+        entry.first = index;
+    }
+    for (auto& entry : support) entry.second = unzigzag(get_varint(pos, end));
+}
+
+inline chain_support_t support(chain_v& chain) {
+    chain_support_t supp;
+    auto& rep = chain_rep_v(chain);
+    for (size_t i = 0; i < rep.size(); ++i)
+        if (rep[i] != 0) supp.emplace_back(i, to_integer(rep[i]));
+    return supp;
+}
+
+inline chain_support_t support(chain_t& chain) {
+    chain_support_t supp;
+    // sparse vector entries are stored sorted by index
+    for (vector_t::InnerIterator it(chain_rep(chain)); it; ++it)
+        if (it.value() != 0)
+            supp.emplace_back(it.index(), to_integer(it.value()));
+    return supp;
+}
+
+};  // namespace chain_io
+
+/**
+ * @brief appends chains to a chain file
+ *
+ * a new (or empty) file gets the header, an existing file must have been
+ * written for the same snapshot. records are buffered and written on flush
+ * or destruction.
+ */
+class chain_writer {
+    std::string filename;
+    std::ofstream out;
+    chain_file_header header;
+    std::string pending;
+    size_t written{0};
+
+   public:
+    static constexpr size_t flush_size = 1 << 20;
+
+    chain_writer(std::string _filename, chain_file_header _header)
+        : filename(_filename), header(_header) {
+        std::ifstream existing(filename, std::ios::binary);
+        chain_file_header old_header;
+        bool has_header =
+            existing.is_open() && chain_io::decode_header(existing, old_header);
+        existing.close();
+        if (has_header && old_header != header)
+            throw std::runtime_error("\"" + filename +
+                                     "\" belongs to snapshot \"" +
+                                     old_header.snapshot + "\"\n");
+
+        out.open(filename, std::ios::binary | std::ios::app);
+        if (!out.is_open())
+            throw std::runtime_error("failed to open \"" + filename + "\"\n");
+        if (!has_header) pending = chain_io::encode_header(header);
+    }
+
+    // errors are lost here, call flush first to see them
+    ~chain_writer() {
+        try {
+            flush();
+        } catch (std::runtime_error&) {
+        }
+    }
+
+    // support sorted by index, without repeats
+    void write(int d, const chain_support_t& support) {
+        if (d < 0 || size_t(d) >= header.level_sizes.size())
+            throw std::runtime_error("chain dimension not in the complex\n");
+        for (size_t i = 0; i < support.size(); ++i) {
+            if (i > 0 && support[i].first <= support[i - 1].first)
+                throw std::runtime_error(
+                    "chain support not sorted by index\n");
+            if (support[i].first >= header.level_sizes[d])
+                throw std::runtime_error("chain index out of the complex\n");
+        }
+        chain_io::encode_record(pending, d, support);
+        ++written;
+        if (pending.size() >= flush_size) flush();
+    }
+
+    void write(chain_v& chain) {
+        write(chain_dim(chain), chain_io::support(chain));
+    }
+    void write(chain_t& chain) {
+        write(chain_dim(chain), chain_io::support(chain));
+    }
+
+    void flush() {
+        out.write(pending.data(), pending.size());
+        out.flush();
+        pending.clear();
+        if (!out)
+            throw std::runtime_error("failed to write \"" + filename +
+                                     "\"\n");
+    }
+
+    size_t chains_written() { return written; }
+};
+
+/**
+ * @brief reads chains back from a chain file, in the order they were written
+ */
+class chain_reader {
+    std::ifstream in;
+    chain_file_header file_header;
+    std::string record;
+
+   public:
+    explicit chain_reader(std::string filename)
+        : in(filename, std::ios::binary) {
+        if (!in.is_open())
+            throw std::runtime_error("failed to open \"" + filename + "\"\n");
+        if (!chain_io::decode_header(in, file_header))
+            throw std::runtime_error("\"" + filename + "\" is empty\n");
+    }
+
+    const chain_file_header& header() { return file_header; }
+
+    // next record as (dimension, support), false at the end of the file
+    bool read(int& d, chain_support_t& support) {
+        if (in.peek() == EOF) return false;
+        chain_io::read_bytes(in, chain_io::get_varint(in), record);
+        chain_io::decode_record(record.data(), record.data() + record.size(),
+                                d, support);
+        if (d < 0 || size_t(d) >= file_header.level_sizes.size())
+            throw std::runtime_error("chain dimension not in the complex\n");
+        // gaps that wrap around show up as indices out of order
+        for (size_t i = 0; i < support.size(); ++i) {
+            if (i > 0 && support[i].first <= support[i - 1].first)
+                throw std::runtime_error(
+                    "chain support not sorted by index\n");
+            if (support[i].first >= file_header.level_sizes[d])
+                throw std::runtime_error("chain index out of the complex\n");
+        }
+        return true;
+    }
+
+    bool read(chain_v& chain) {
+        int d;
+        chain_support_t support;
+        if (!read(d, support)) return false;
+        std::vector<double> rep(file_header.level_sizes[d], 0);
+        for (auto& entry : support) rep[entry.first] = entry.second;
+        chain = chain_v(d, rep);
+        return true;
+    }
+
+    bool read(chain_t& chain) {
+        int d;
+        chain_support_t support;
+        if (!read(d, support)) return false;
+        vector_t rep(file_header.level_sizes[d]);
+        rep.reserve(support.size());
+        for (auto& entry : support)
+            rep.insertBack(entry.first) = double(entry.second);
+        chain = chain_t(d, rep);
+        return true;
+    }
+};
+
+};  // namespace gsimp
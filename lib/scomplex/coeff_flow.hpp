@@ -4,142 +4,738 @@
 #include <iostream>
 #include <queue>
 #include <scomplex/types.hpp>
+#include <scomplex/coeff_ring.hpp>
 #include <scomplex/simplicial_complex.hpp>
+#include <scomplex/metrics.hpp>
+#include <scomplex/workspace.hpp>
+#include <scomplex/thread_pool.hpp>
 #include "types.hpp"
 #include "simplicial_complex.hpp"
 
 namespace gsimp {
 using namespace std;
 
-typedef tuple<cell_t, cell_t, double> q_elem_t;
-typedef queue<q_elem_t> queue_t;
-
 class out_of_context : exception {};
 class no_bounding_chain : exception {};
 
-chain_v coeff_flow(simplicial_complex& s_comp,  //
-                   chain_v p,                   //
-                   cell_t sigma_0,              //
-                   double c_0) {                //
-
-    if (chain_dim(p) != s_comp.dimension() - 1) throw out_of_context();
-    // 01
-    vector<double> c_vec(s_comp.get_level_size(s_comp.dimension()),0);
+namespace flow_detail {
 
-    vector<bool> seen_sigma((size_t)s_comp.get_level_size(s_comp.dimension()),
-                            false);
-    vector<bool> seen_tau((size_t)s_comp.get_level_size(s_comp.dimension() - 1),
-                          false);
+// the flow itself, over the cells reached from sigma_0 only: c_vec has one
+// entry per top cell and the others are left as they are
+void flow_from(const simplicial_complex::incidence_view& faces,
+               const simplicial_complex::incidence_view& cofaces,
+               const vector<double>& p_vec,  //
+               size_t sigma_0,               //
+               double c_0,                   //
+               vector<double>& c_vec,        //
+               workspace& ws) {
+    ws.seen_cells.reset(c_vec.size());
+    ws.seen_faces.reset(p_vec.size());
+    fifo<flow_item>& queue = ws.flow_queue;
+    queue.clear();
 
     size_t seen_taus = 0;
-    seen_sigma[s_comp.cell_to_index(sigma_0)] = true;
-    c_vec[s_comp.cell_to_index(sigma_0)] = c_0;
+    ws.seen_cells.set(sigma_0);
+    c_vec[sigma_0] = c_0;
     size_t seen_sigmas = 1;
 
-    queue_t queue;
-    for (cell_t tau : s_comp.cell_boundary(sigma_0)) {
-        queue.emplace(sigma_0, tau, c_0);
-    }
+    for (size_t k = faces.begin(sigma_0); k < faces.end(sigma_0); ++k)
+        queue.push({sigma_0, faces.cells[k], faces.signs[k], c_0});
 
+    size_t max_queue = queue.size();
     while (not queue.empty()) {
-        /* // useful debug output
-         *
-         * size_t ind = 0;
-         * if (ind % 1000 == 0) {
-         *     cout << ind << ": ";
-         *     cout << " taus visited: " << seen_taus << "/" <<
-         * seen_tau.size();
-         *     cout << " sigmas visited: " << seen_sigmas << "/" <<
-         * seen_sigma.size();
-         *     cout << " queue size: " << queue.size() << "\n";
-         *     cout.flush();
-         * }
-         * ind++;
-         */
+        max_queue = max(max_queue, queue.size());
 
         // dequeue the first element
-        cell_t sigma;
-        cell_t tau;
-        double c;
-        tie(sigma, tau, c) = queue.front();
+        flow_item item = queue.front();
         queue.pop();
 
-        // get the indices of the respective cells
-        size_t sigma_i = s_comp.cell_to_index(sigma);
-        size_t tau_i = s_comp.cell_to_index(tau);
-
-        if (seen_sigma[sigma_i]) {
+        if (ws.seen_cells.test(item.sigma)) {
             // found local incoherence
-            if (c_vec[sigma_i] != c) throw no_bounding_chain();
+            if (c_vec[item.sigma] != item.c) throw no_bounding_chain();
         } else {
-            seen_sigma[sigma_i] = true;
-            c_vec[sigma_i] = c;
+            ws.seen_cells.set(item.sigma);
+            c_vec[item.sigma] = item.c;
             seen_sigmas++;
         }
 
-        if (seen_tau[tau_i]) continue;
-        seen_tau[tau_i] = true;
+        if (ws.seen_faces.test(item.tau)) continue;
+        ws.seen_faces.set(item.tau);
         seen_taus++;
 
-        cell_t sigma_p;
-        size_t sigma_p_i;
+        size_t sigma_p = 0;
+        int sigma_p_sign = 0;
         bool is_boundary = true;
-        for (auto coface : s_comp.get_cof_and_ind(tau)) {
-            size_t coface_i = s_comp.cell_to_index(get<1>(coface));
-            if (coface_i != sigma_i) {
+        for (size_t k = cofaces.begin(item.tau); k < cofaces.end(item.tau);
+             ++k) {
+            if (cofaces.cells[k] != item.sigma) {
                 is_boundary = false;
-                sigma_p_i = coface_i;
-                sigma_p = s_comp.index_to_cell(s_comp.dimension(), sigma_p_i);
+                sigma_p = cofaces.cells[k];
+                sigma_p_sign = cofaces.signs[k];
             }
         }
 
-        double predicted_bdry = s_comp.boundary_inclusion_index(tau, sigma) * c;
+        double predicted_bdry = item.sign * item.c;
         if (is_boundary) {
             // sigma is the only coface of tau
             // check that we get the same value on tau
-            if (predicted_bdry != chain_val(p, tau_i))
-                throw no_bounding_chain();
+            if (predicted_bdry != p_vec[item.tau]) throw no_bounding_chain();
         } else {
             // there is another coface we now focus on it
-            double c_p = s_comp.boundary_inclusion_index(tau, sigma_p) *
-                         (chain_val(p, tau_i) -
-                          s_comp.boundary_inclusion_index(tau, sigma) * c);
-            for (cell_t tau_p : s_comp.cell_boundary(sigma_p)) {
-                size_t tau_p_i = s_comp.cell_to_index(tau_p);
-                if (not seen_tau[tau_p_i]) {
-                    // each tau only needs to be processed once
-                    queue.emplace(sigma_p, tau_p, c_p);
+            double c_p = sigma_p_sign * (p_vec[item.tau] - predicted_bdry);
+            for (size_t k = faces.begin(sigma_p); k < faces.end(sigma_p);
+                 ++k) {
+                // each tau only needs to be processed once
+                if (not ws.seen_faces.test(faces.cells[k]))
+                    queue.push({sigma_p, faces.cells[k], faces.signs[k], c_p});
+            }
+        }
+    }
+
+    GSIMP_COUNT("coeff_flow.seen_taus", seen_taus);
+    GSIMP_COUNT("coeff_flow.seen_sigmas", seen_sigmas);
+    GSIMP_HISTOGRAM("coeff_flow.max_queue", max_queue);
+}
+
+};  // namespace flow_detail
+
+/*
+ * coefficient flow over cell indices, from the top cell sigma_0 with value
+ * c_0, into out. it only reads the flat incidence arrays of the complex and
+ * uses the scratch space of ws, once out and ws are large enough it does
+ * not allocate. cells of other connected components stay at zero (see
+ * coeff_flow_components in components.hpp).
+ */
+void coeff_flow(simplicial_complex& s_comp,  //
+                const chain_v& p,            //
+                size_t sigma_0,              //
+                double c_0,                  //
+                chain_v& out,                //
+                workspace& ws = thread_workspace()) {
+    GSIMP_PHASE("coeff_flow");
+    int d = s_comp.dimension();
+    if (p.first != d - 1) throw out_of_context();
+    // 01
+    size_t num_sigmas = s_comp.get_level_size(d);
+    out.first = d;
+    out.second.assign(num_sigmas, 0);
+    flow_detail::flow_from(s_comp.faces_view(d), s_comp.cofaces_view(d - 1),
+                           p.second, sigma_0, c_0, out.second, ws);
+}
+
+chain_v coeff_flow(simplicial_complex& s_comp,  //
+                   chain_v p,                   //
+                   cell_t sigma_0,              //
+                   double c_0) {                //
+    chain_v c_chain;
+    coeff_flow(s_comp, p, s_comp.cell_to_index(sigma_0), c_0, c_chain);
+    return c_chain;
+}
+
+// starts from the first boundary facet of the complex, the coefficient of
+// its coface is then fixed by the value of p on the facet
+void coeff_flow_embedded(simplicial_complex& s_comp, const chain_v& p,
+                         chain_v& out, workspace& ws = thread_workspace()) {
+    GSIMP_PHASE("coeff_flow_embedded");
+    int d = s_comp.dimension();
+    if (p.first != d - 1) throw out_of_context();
+
+    const auto& boundary = s_comp.boundary_facets();
+    if (boundary.empty()) throw out_of_context();
+    const simplicial_complex::boundary_facet& start = boundary.front();
+    coeff_flow(s_comp, p, start.coface, start.sign * p.second[start.facet],
+               out, ws);
+}
+
+chain_v coeff_flow_embedded(simplicial_complex& s_comp, chain_v p) {
+    chain_v c_chain;
+    coeff_flow_embedded(s_comp, p, c_chain);
+    return c_chain;
+}
+
+/*
+ * coefficient flow over the ring R (see coeff_ring.hpp): the same flow with
+ * exact comparisons over the integer rings, which throw
+ * std::overflow_error when a coefficient leaves the type, and over z2_ring
+ * with the orientations dropped, only the support of the chain is found.
+ * every facet is crossed once, from the first of its cofaces reached.
+ */
+template <typename R>
+void coeff_flow(simplicial_complex& s_comp,         //
+                const ring_chain<R>& p,             //
+                size_t sigma_0,                     //
+                typename R::value_type c_0,         //
+                ring_chain<R>& out,                 //
+                workspace& ws = thread_workspace()) {
+    typedef typename R::value_type value_type;
+    GSIMP_PHASE("coeff_flow");
+    int d = s_comp.dimension();
+    if (p.dimension() != d - 1) throw out_of_context();
+    size_t num_sigmas = s_comp.get_level_size(d);
+    simplicial_complex::incidence_view faces = s_comp.faces_view(d);
+    simplicial_complex::incidence_view cofaces = s_comp.cofaces_view(d - 1);
+
+    out.assign(d, num_sigmas);
+    ws.seen_cells.reset(num_sigmas);
+    ws.seen_faces.reset(p.size());
+    fifo<size_t>& queue = ws.cell_queue;
+    queue.clear();
+
+    ws.seen_cells.set(sigma_0);
+    out.set(sigma_0, c_0);
+    queue.push(sigma_0);
+    size_t seen_sigmas = 1;
+
+    while (not queue.empty()) {
+        size_t sigma = queue.front();
+        queue.pop();
+        value_type c = out.get(sigma);
+
+        for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k) {
+            size_t tau = faces.cells[k];
+            if (ws.seen_faces.test(tau)) continue;
+            ws.seen_faces.set(tau);
+
+            size_t sigma_p = sigma;
+            int sigma_p_sign = 0;
+            for (size_t j = cofaces.begin(tau); j < cofaces.end(tau); ++j) {
+                if (cofaces.cells[j] != sigma) {
+                    sigma_p = cofaces.cells[j];
+                    sigma_p_sign = cofaces.signs[j];
+                }
+            }
+
+            value_type predicted_bdry = R::act(faces.signs[k], c);
+            if (sigma_p == sigma) {
+                if (predicted_bdry != p.get(tau)) throw no_bounding_chain();
+                continue;
+            }
+            value_type c_p =
+                R::act(sigma_p_sign, R::minus(p.get(tau), predicted_bdry));
+            if (ws.seen_cells.test(sigma_p)) {
+                // found local incoherence
+                if (out.get(sigma_p) != c_p) throw no_bounding_chain();
+            } else {
+                ws.seen_cells.set(sigma_p);
+                out.set(sigma_p, c_p);
+                queue.push(sigma_p);
+                seen_sigmas++;
+            }
+        }
+    }
+
+    GSIMP_COUNT("coeff_flow.seen_sigmas", seen_sigmas);
+}
+
+template <typename R>
+void coeff_flow_embedded(simplicial_complex& s_comp, const ring_chain<R>& p,
+                         ring_chain<R>& out,
+                         workspace& ws = thread_workspace()) {
+    GSIMP_PHASE("coeff_flow_embedded");
+    int d = s_comp.dimension();
+    if (p.dimension() != d - 1) throw out_of_context();
+
+    const auto& boundary = s_comp.boundary_facets();
+    if (boundary.empty()) throw out_of_context();
+    const simplicial_complex::boundary_facet& start = boundary.front();
+    coeff_flow(s_comp, p, start.coface, R::act(start.sign, p.get(start.facet)),
+               out, ws);
+}
+/*
+ * parallel coefficient flow, top cells split into num_parts ranges of
+ * indices (one per thread of the pool when 0)
+ *
+ * every range floods its cells from a seed of its own, at the same time as
+ * the others. a cell then holds c = l + s * delta, l and s = +-1 found by
+ * the flood and delta the unknown offset of its region (cells of the range
+ * reached from the same seed). facets inside a region leave either nothing
+ * to check or fix delta (a boundary facet, or a loop that flips s), facets
+ * between regions of different ranges give one equation in two offsets.
+ * that small system is solved by a traversal from the region of sigma_0,
+ * whose offset is 0, and any equation it cannot satisfy means there is no
+ * bounding chain. regions it does not reach stay at 0, as coeff_flow
+ * leaves the cells it does not reach. the ranges are contiguous indices,
+ * so the interfaces are small when the cells are ordered for locality (see
+ * simplicial_complex::reorder_cells).
+ *
+ * falls back to coeff_flow when a facet has more than two cofaces.
+ */
+namespace flow_detail {
+
+const uint32_t no_region = uint32_t(-1);
+
+// the offset a region is forced to, if any
+struct region_info {
+    bool fixed = false;
+    bool incoherent = false;
+    double delta = 0;
+
+    void fix(double value) {
+        if (!fixed) {
+            fixed = true;
+            delta = value;
+        } else if (delta != value) {
+            incoherent = true;
+        }
+    }
+};
+
+// facet tau between sigma and sigma_p, in different ranges
+struct interface_facet {
+    size_t tau, sigma, sigma_p;
+    int sign, sign_p;
+};
+
+struct flow_part {
+    vector<region_info> regions;
+    vector<interface_facet> interfaces;
+    bool non_manifold = false;
+};
+
+};  // namespace flow_detail
+
+void coeff_flow_parallel(simplicial_complex& s_comp,  //
+                         const chain_v& p,            //
+                         size_t sigma_0,              //
+                         double c_0,                  //
+                         chain_v& out,                //
+                         thread_pool& pool,           //
+                         size_t num_parts = 0) {
+    using namespace flow_detail;
+    GSIMP_PHASE("coeff_flow_parallel");
+    int d = s_comp.dimension();
+    if (p.first != d - 1) throw out_of_context();
+    size_t num_sigmas = s_comp.get_level_size(d);
+    const vector<double>& p_vec = p.second;
+    simplicial_complex::incidence_view faces = s_comp.faces_view(d);
+    simplicial_complex::incidence_view cofaces = s_comp.cofaces_view(d - 1);
+    // tombstones (see simplicial_complex::update_cells) are in no region
+    const vector<uint8_t>& removed = s_comp.tombstones(d);
+
+    if (num_parts == 0) num_parts = pool.size();
+    num_parts = max<size_t>(1, min(num_parts, num_sigmas));
+    size_t part_size = (num_sigmas + num_parts - 1) / num_parts;
+    num_parts = (num_sigmas + part_size - 1) / part_size;
+
+    out.first = d;
+    vector<double>& c_vec = out.second;  // l while flooding
+    c_vec.assign(num_sigmas, 0);
+    vector<int8_t> flip(num_sigmas, 1);                 // s
+    vector<uint32_t> region(num_sigmas, no_region);  // within the range
+    vector<flow_part> parts(num_parts);
+
+    parallel_for(pool, num_parts, [&](size_t part) {
+        flow_part& fp = parts[part];
+        size_t lo = part * part_size, hi = min(num_sigmas, lo + part_size);
+        vector<size_t> queue;
+        // floods the region of seed, false on a non manifold facet
+        auto flood = [&](size_t seed, double c) {
+            uint32_t r = fp.regions.size();
+            fp.regions.emplace_back();
+            region[seed] = r;
+            c_vec[seed] = c;
+            queue.assign(1, seed);
+            for (size_t head = 0; head < queue.size(); ++head) {
+                size_t sigma = queue[head];
+                double l = c_vec[sigma];
+                int s = flip[sigma];
+                for (size_t k = faces.begin(sigma); k < faces.end(sigma);
+                     ++k) {
+                    size_t tau = faces.cells[k];
+                    int sign = faces.signs[k];
+                    size_t first = cofaces.begin(tau);
+                    size_t num_cofaces = cofaces.end(tau) - first;
+                    if (num_cofaces > 2) return false;
+                    if (num_cofaces == 1) {
+                        // sign * (l + s * delta) = p
+                        fp.regions[r].fix(s * (sign * p_vec[tau] - l));
+                        continue;
+                    }
+                    size_t j =
+                        cofaces.cells[first] == sigma ? first + 1 : first;
+                    size_t sigma_p = cofaces.cells[j];
+                    int sign_p = cofaces.signs[j];
+                    if (sigma_p < lo || sigma_p >= hi) {
+                        if (sigma_p > sigma)
+                            fp.interfaces.push_back(
+                                {tau, sigma, sigma_p, sign, sign_p});
+                        continue;
+                    }
+                    double l_p = sign_p * (p_vec[tau] - sign * l);
+                    int s_p = -sign_p * sign * s;
+                    if (region[sigma_p] == no_region) {
+                        region[sigma_p] = r;
+                        c_vec[sigma_p] = l_p;
+                        flip[sigma_p] = s_p;
+                        queue.push_back(sigma_p);
+                    } else if (s_p == flip[sigma_p]) {
+                        // found local incoherence
+                        if (l_p != c_vec[sigma_p])
+                            fp.regions[r].incoherent = true;
+                    } else {
+                        // l_p + s_p * delta = l' + s' * delta
+                        fp.regions[r].fix((c_vec[sigma_p] - l_p) /
+                                          (s_p - flip[sigma_p]));
+                    }
                 }
+            }
+            return true;
+        };
+
+        // the region of sigma_0 takes its value, its offset is 0
+        if (lo <= sigma_0 && sigma_0 < hi) {
+            if (!flood(sigma_0, c_0)) fp.non_manifold = true;
+            fp.regions[0].fix(0);
+        }
+        for (size_t sigma = lo; sigma < hi && !fp.non_manifold; ++sigma)
+            if (region[sigma] == no_region &&
+                (removed.empty() || !removed[sigma]) && !flood(sigma, 0))
+                fp.non_manifold = true;
+    });
+
+    for (auto& fp : parts) {
+        if (fp.non_manifold) {
+            coeff_flow(s_comp, p, sigma_0, c_0, out);
+            return;
         }
     }
+
+    // the reduced system: one offset per region, regions numbered range by
+    // range, and the interfaces as edges between them
+    vector<size_t> first_region(num_parts + 1, 0);
+    for (size_t part = 0; part < num_parts; ++part)
+        first_region[part + 1] =
+            first_region[part] + parts[part].regions.size();
+    size_t num_regions = first_region[num_parts];
+    auto region_of = [&](size_t sigma) {
+        return first_region[sigma / part_size] + region[sigma];
+    };
+
+    vector<size_t> offsets(num_regions + 1, 0);
+    for (auto& fp : parts)
+        for (auto& f : fp.interfaces) {
+            offsets[region_of(f.sigma) + 1]++;
+            offsets[region_of(f.sigma_p) + 1]++;
+        }
+    for (size_t r = 0; r < num_regions; ++r) offsets[r + 1] += offsets[r];
+    vector<const interface_facet*> edges(offsets[num_regions]);
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (auto& fp : parts)
+        for (auto& f : fp.interfaces) {
+            edges[next[region_of(f.sigma)]++] = &f;
+            edges[next[region_of(f.sigma_p)]++] = &f;
+        }
+
+    vector<double> delta(num_regions, 0);
+    vector<bool> reached(num_regions, false);
+    vector<size_t> queue(1, region_of(sigma_0));
+    reached[queue[0]] = true;
+    for (size_t head = 0; head < queue.size(); ++head) {
+        size_t r = queue[head];
+        size_t part =
+            upper_bound(first_region.begin(), first_region.end(), r) -
+            first_region.begin() - 1;
+        const region_info& info = parts[part].regions[r - first_region[part]];
+        if (info.incoherent) throw no_bounding_chain();
+        if (info.fixed && info.delta != delta[r]) throw no_bounding_chain();
+        for (size_t k = offsets[r]; k < offsets[r + 1]; ++k) {
+            const interface_facet& f = *edges[k];
+            // sign (l + s delta) + sign_p (l_p + s_p delta_p) = p, solved
+            // for the far side
+            bool forward = region_of(f.sigma) == r;
+            size_t near = forward ? f.sigma : f.sigma_p;
+            size_t far = forward ? f.sigma_p : f.sigma;
+            int near_sign = forward ? f.sign : f.sign_p;
+            int far_sign = forward ? f.sign_p : f.sign;
+            double far_delta =
+                (p_vec[f.tau] -
+                 near_sign * (c_vec[near] + flip[near] * delta[r]) -
+                 far_sign * c_vec[far]) *
+                (far_sign * flip[far]);
+            size_t r_p = region_of(far);
+            if (!reached[r_p]) {
+                reached[r_p] = true;
+                delta[r_p] = far_delta;
+                queue.push_back(r_p);
+            } else if (delta[r_p] != far_delta) {
+                throw no_bounding_chain();
+            }
+        }
     }
 
-    /*
-     * // useful live debugging info
-     * cout << "sigmas seen: " << seen_sigmas << "/" << s_comp.get_level_size(s_comp.dimension());
-     * cout << " taus seen: " << seen_taus << "/" << s_comp.get_level_size(s_comp.dimension() - 1);
-     * cout << '\n';
-     */
+    parallel_for(pool, num_parts, [&](size_t part) {
+        size_t lo = part * part_size, hi = min(num_sigmas, lo + part_size);
+        for (size_t sigma = lo; sigma < hi; ++sigma) {
+            if (region[sigma] == no_region) {
+                c_vec[sigma] = 0;
+                continue;
+            }
+            size_t r = region_of(sigma);
+            c_vec[sigma] = reached[r] ? c_vec[sigma] + flip[sigma] * delta[r]
+                                      : 0;
+        }
+    });
+
+    GSIMP_COUNT("coeff_flow_parallel.regions", num_regions);
+    GSIMP_COUNT("coeff_flow_parallel.interfaces", edges.size() / 2);
+}
 
-    chain_v c_chain(s_comp.dimension(),c_vec);
+chain_v coeff_flow_parallel(simplicial_complex& s_comp,  //
+                            chain_v p,                   //
+                            cell_t sigma_0,              //
+                            double c_0,                  //
+                            thread_pool& pool) {         //
+    chain_v c_chain;
+    coeff_flow_parallel(s_comp, p, s_comp.cell_to_index(sigma_0), c_0,
+                        c_chain, pool);
     return c_chain;
 }
 
-chain_v coeff_flow_embedded(simplicial_complex& s_comp, chain_v p) {
-    if (chain_dim(p) != s_comp.dimension() - 1) throw out_of_context();
-
-    cell_t sigma;
-    double c;
-    for (auto tau : s_comp.get_level(s_comp.dimension() - 1)) {
-        if (s_comp.get_cofaces(tau).size() < 2) {
-            int sigma_ind;
-            size_t tau_i = s_comp.cell_to_index(tau);
-            tie(sigma_ind, sigma) = s_comp.get_cof_and_ind(tau)[0];
-            c = sigma_ind * chain_val(p, tau_i);
-            chain_v sol = coeff_flow(s_comp, p, sigma, c);
-            return sol;
+// parallel coeff_flow_embedded
+void coeff_flow_embedded_parallel(simplicial_complex& s_comp,
+                                  const chain_v& p, chain_v& out,
+                                  thread_pool& pool) {
+    int d = s_comp.dimension();
+    if (p.first != d - 1) throw out_of_context();
+
+    const auto& boundary = s_comp.boundary_facets();
+    if (boundary.empty()) throw out_of_context();
+    const simplicial_complex::boundary_facet& start = boundary.front();
+    coeff_flow_parallel(s_comp, p, start.coface,
+                        start.sign * p.second[start.facet], out, pool);
+}
+
+chain_v coeff_flow_embedded_parallel(simplicial_complex& s_comp, chain_v p,
+                                     thread_pool& pool) {
+    chain_v c_chain;
+    coeff_flow_embedded_parallel(s_comp, p, c_chain, pool);
+    return c_chain;
+}
+namespace flow_detail {
+
+const size_t no_cell = size_t(-1);
+
+/*
+ * the non zero coefficients of a bounding chain of p, by flooding around
+ * its support only, into ws.settled_cells (sorted). each piece of the
+ * support is flooded from one of its facets twice in lockstep, once for
+ * each of its two cofaces being the zero one, and the first flood to
+ * finish without a contradiction is kept, unless it makes zero_cell non
+ * zero: the other one is then finished instead. a kept flood bounds the
+ * part of p on the facets of the cells it reached, those facets are then
+ * taken as zero by the floods after it (a piece nested in another is
+ * flooded again by the outer one, on top of its own chain) and the chains
+ * of the floods are summed. false (nothing settled) when a flood grows
+ * past max_cells.
+ */
+bool flood_support(simplicial_complex& s_comp, const chain_t& p,
+                   size_t zero_cell, size_t max_cells, workspace& ws) {
+    int d = s_comp.dimension();
+    if (p.first != d - 1) throw out_of_context();
+    size_t num_sigmas = s_comp.get_level_size(d);
+    size_t num_taus = s_comp.get_level_size(d - 1);
+    simplicial_complex::incidence_view faces = s_comp.faces_view(d);
+    simplicial_complex::incidence_view cofaces = s_comp.cofaces_view(d - 1);
+
+    ws.on_cycle.reset(num_taus);
+    if (ws.cycle_value.size() < num_taus) ws.cycle_value.resize(num_taus);
+    for (vector_t::InnerIterator it(p.second); it; ++it) {
+        if (it.value() == 0) continue;
+        ws.on_cycle.set(it.index());
+        ws.cycle_value[it.index()] = it.value();
+    }
+    // facets bounded by an earlier flood
+    ws.bounded.reset(num_taus);
+    auto cycle_at = [&](size_t tau) {
+        return ws.on_cycle.test(tau) && !ws.bounded.test(tau)
+                   ? ws.cycle_value[tau]
+                   : 0.0;
+    };
+    ws.settled_cells.clear();
+
+    // expands the next cell of a side
+    auto expand = [&](flood_side& side) {
+        size_t sigma = side.queue.front();
+        side.queue.pop();
+        double c = side.value[sigma];
+        for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k) {
+            size_t tau = faces.cells[k];
+            double p_tau = cycle_at(tau);
+            // zero stays zero away from the cycle
+            if (c == 0 && p_tau == 0) continue;
+            size_t first = cofaces.begin(tau);
+            size_t num_cofaces = cofaces.end(tau) - first;
+            if (num_cofaces > 2) throw out_of_context();
+            if (num_cofaces == 1) {
+                // sigma is the only coface of tau
+                if (faces.signs[k] * c == p_tau) continue;
+                side.failed = true;
+                return;
+            }
+            size_t j = cofaces.cells[first] == sigma ? first + 1 : first;
+            size_t sigma_p = cofaces.cells[j];
+            double c_p = cofaces.signs[j] * (p_tau - faces.signs[k] * c);
+            if (!side.seen.test(sigma_p)) {
+                side.visit(sigma_p, c_p);
+            } else if (side.value[sigma_p] != c_p) {
+                // found local incoherence
+                side.failed = true;
+                return;
+            }
+        }
+    };
+    auto zero_at = [&](const flood_side& side) {
+        return zero_cell == no_cell || !side.seen.test(zero_cell) ||
+               side.value[zero_cell] == 0;
+    };
+
+    for (vector_t::InnerIterator it(p.second); it; ++it) {
+        size_t tau = it.index();
+        if (it.value() == 0) continue;
+        size_t first = cofaces.begin(tau);
+        size_t num_cofaces = cofaces.end(tau) - first;
+        if (num_cofaces > 2) throw out_of_context();
+        // a facet without cofaces (a tombstone) bounds nothing
+        if (num_cofaces == 0) throw no_bounding_chain();
+        if (ws.bounded.test(tau)) continue;
+
+        flood_side* sides = ws.sides;
+        sides[0].reset(num_sigmas);
+        sides[1].reset(num_sigmas);
+        size_t a = cofaces.cells[first];
+        double c_a = cofaces.signs[first] * it.value();
+        if (num_cofaces == 1) {
+            sides[0].visit(a, c_a);
+            sides[1].failed = true;
+        } else {
+            size_t b = cofaces.cells[first + 1];
+            double c_b = cofaces.signs[first + 1] * it.value();
+            sides[0].visit(a, 0);
+            sides[0].visit(b, c_b);
+            sides[1].visit(b, 0);
+            sides[1].visit(a, c_a);
+        }
+
+        int kept = -1;
+        while (kept < 0) {
+            if (sides[0].failed && sides[1].failed) throw no_bounding_chain();
+            for (int side = 0; side < 2 && kept < 0; ++side) {
+                if (sides[side].failed) continue;
+                if (sides[side].queue.empty())
+                    kept = side;
+                else
+                    expand(sides[side]);
+                if (sides[side].cells.size() > max_cells) return false;
+            }
         }
+        if (!zero_at(sides[kept])) {
+            flood_side& other = sides[1 - kept];
+            while (!other.failed && !other.queue.empty()) {
+                expand(other);
+                if (other.cells.size() > max_cells) return false;
+            }
+            if (other.failed || !zero_at(other)) throw no_bounding_chain();
+            kept = 1 - kept;
+        }
+        for (size_t cell : sides[kept].cells) {
+            for (size_t k = faces.begin(cell); k < faces.end(cell); ++k)
+                if (ws.on_cycle.test(faces.cells[k]))
+                    ws.bounded.set(faces.cells[k]);
+            double c = sides[kept].value[cell];
+            if (c != 0) ws.settled_cells.emplace_back(cell, c);
+        }
+    }
+
+    // the cells of nested floods, summed
+    auto& cells = ws.settled_cells;
+    sort(cells.begin(), cells.end());
+    size_t num_cells = 0;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (num_cells > 0 && cells[num_cells - 1].first == cells[i].first)
+            cells[num_cells - 1].second += cells[i].second;
+        else
+            cells[num_cells++] = cells[i];
+        if (cells[num_cells - 1].second == 0) num_cells--;
+    }
+    cells.resize(num_cells);
+    return true;
+}
+
+};  // namespace flow_detail
+
+/*
+ * bounding chain of a cycle p that only walks where it may be non zero,
+ * the cells away from the support of p are taken to be zero (see
+ * flow_detail::flood_support): the cost is about twice the size of the
+ * region the cycle encloses, whatever the size of the complex. on closed
+ * complexes both floods give bounding chains and the smaller one is kept
+ * (they differ by a multiple of the fundamental cycle). throws
+ * no_bounding_chain when both fail and out_of_context on a facet with more
+ * than two cofaces.
+ */
+void coeff_flow_local(simplicial_complex& s_comp,  //
+                      const chain_t& p,            //
+                      chain_t& out,                //
+                      workspace& ws = thread_workspace()) {
+    GSIMP_PHASE("coeff_flow_local");
+    flow_detail::flood_support(s_comp, p, flow_detail::no_cell, size_t(-1),
+                               ws);
+    int d = s_comp.dimension();
+    out.first = d;
+    out.second = vector_t(s_comp.get_level_size(d));
+    out.second.reserve(ws.settled_cells.size());
+    for (auto& cell : ws.settled_cells)
+        out.second.insertBack(cell.first) = cell.second;
+    GSIMP_COUNT("coeff_flow_local.cells", ws.settled_cells.size());
+}
+
+/*
+ * coefficient flow from a top cell known to have coefficient zero, that
+ * only walks into the cells whose coefficient may not be, into a sparse
+ * list of (index, coefficient) pairs sorted by index. small cycles on large
+ * complexes cost about the size of what they enclose. the zero cell picks
+ * the side of each piece of the cycle on closed complexes, so on a
+ * connected complex the result is that of coeff_flow(s_comp, p, zero_cell,
+ * 0). once a flood grows past a quarter of the top cells it falls back to
+ * that dense flow.
+ */
+void coeff_flow_sparse(simplicial_complex& s_comp,  //
+                       const chain_t& p,            //
+                       size_t zero_cell,            //
+                       vector<pair<size_t, double>>& out,
+                       workspace& ws = thread_workspace()) {
+    GSIMP_PHASE("coeff_flow_sparse");
+    int d = s_comp.dimension();
+    size_t num_sigmas = s_comp.get_level_size(d);
+    if (flow_detail::flood_support(s_comp, p, zero_cell, num_sigmas / 4,
+                                   ws)) {
+        out.assign(ws.settled_cells.begin(), ws.settled_cells.end());
+        GSIMP_COUNT("coeff_flow_sparse.cells", out.size());
+        return;
     }
-    throw out_of_context();
+
+    GSIMP_COUNT("coeff_flow_sparse.dense_fallbacks", 1);
+    chain_v dense_p = s_comp.new_v_chain(d - 1);
+    for (vector_t::InnerIterator it(p.second); it; ++it)
+        dense_p.second[it.index()] = it.value();
+    chain_v dense_c;
+    coeff_flow(s_comp, dense_p, zero_cell, 0, dense_c, ws);
+    out.clear();
+    for (size_t i = 0; i < num_sigmas; ++i)
+        if (dense_c.second[i] != 0) out.emplace_back(i, dense_c.second[i]);
+}
+
+/*
+ * adds to the bounding chain of a cycle the bounding chain of a change of
+ * the cycle (coeff_flow_local), for as long as the cycle stays a boundary
+ */
+void update_bounding_chain(simplicial_complex& s_comp,  //
+                           chain_v& bounding,           //
+                           const chain_t& delta,        //
+                           workspace& ws = thread_workspace()) {
+    chain_t change;
+    coeff_flow_local(s_comp, delta, change, ws);
+    for (vector_t::InnerIterator it(change.second); it; ++it)
+        bounding.second[it.index()] += it.value();
 }
 };  // namespace gsimp
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <scomplex/simplicial_complex.hpp>
+#include <scomplex/types.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gsimp {
+
+/*
+ * rings of coefficients for chains, the boundary operator and the
+ * coefficient flow
+ *
+ * a ring gives its value type, an incidence sign acting on a coefficient,
+ * the sum and difference of coefficients and the conversions from and to
+ * double. the integer rings are exact: a result out of the range of the
+ * type throws std::overflow_error instead of wrapping around. in z2_ring
+ * signs drop out, a chain is its support and is stored as a bitset.
+ */
+struct real_ring {
+    typedef double value_type;
+
+    static value_type act(int sign, value_type c) { return sign * c; }
+    static value_type plus(value_type a, value_type b) { return a + b; }
+    static value_type minus(value_type a, value_type b) { return a - b; }
+    static value_type from_double(double x) { return x; }
+    static double to_double(value_type c) { return c; }
+};
+
+template <typename T>
+struct integer_ring {
+    typedef T value_type;
+
+    static value_type narrow(int64_t x) {
+        if (x < std::numeric_limits<T>::min() ||
+            x > std::numeric_limits<T>::max())
+            throw std::overflow_error(
+                "coefficient out of the range of the ring\n");
+        return value_type(x);
+    }
+    static value_type act(int sign, value_type c) {
+        return sign < 0 ? narrow(-int64_t(c)) : c;
+    }
+    static value_type plus(value_type a, value_type b) {
+        return narrow(int64_t(a) + int64_t(b));
+    }
+    static value_type minus(value_type a, value_type b) {
+        return narrow(int64_t(a) - int64_t(b));
+    }
+    static value_type from_double(double x) {
+        if (std::round(x) != x)
+            throw std::runtime_error("coefficient " + std::to_string(x) +
+                                     " is not an integer\n");
+        if (x < std::numeric_limits<T>::min() ||
+            x > std::numeric_limits<T>::max())
+            throw std::overflow_error(
+                "coefficient out of the range of the ring\n");
+        return value_type(x);
+    }
+    static double to_double(value_type c) { return c; }
+};
+
+typedef integer_ring<int32_t> int32_ring;
+typedef integer_ring<int8_t> int8_ring;
+
+struct z2_ring {
+    typedef bool value_type;
+
+    static value_type act(int, value_type c) { return c; }
+    static value_type plus(value_type a, value_type b) { return a != b; }
+    static value_type minus(value_type a, value_type b) { return a != b; }
+    static value_type from_double(double x) {
+        if (std::round(x) != x)
+            throw std::runtime_error("coefficient " + std::to_string(x) +
+                                     " is not an integer\n");
+        return std::fmod(x, 2) != 0;
+    }
+    static double to_double(value_type c) { return c; }
+};
+
+/*
+ * chain of dimension dimension() over the ring R, one coefficient per cell
+ * of its level (dense, like chain_v)
+ */
+template <typename R>
+class ring_chain {
+   public:
+    typedef typename R::value_type value_type;
+
+   private:
+    int d = 0;
+    std::vector<value_type> values;
+
+   public:
+    ring_chain() {}
+    ring_chain(int dim, size_t n) : d(dim), values(n, value_type(0)) {}
+
+    int dimension() const { return d; }
+    size_t size() const { return values.size(); }
+    // the zero chain of n cells of dimension dim, reusing the storage
+    void assign(int dim, size_t n) {
+        d = dim;
+        values.assign(n, value_type(0));
+    }
+
+    value_type get(size_t i) const { return values[i]; }
+    void set(size_t i, value_type c) { values[i] = c; }
+    void add(size_t i, value_type c) { values[i] = R::plus(values[i], c); }
+
+    ring_chain& operator+=(const ring_chain& other) {
+        if (d != other.d || size() != other.size())
+            throw std::runtime_error("chains must match to be added\n");
+        for (size_t i = 0; i < values.size(); ++i)
+            values[i] = R::plus(values[i], other.values[i]);
+        return *this;
+    }
+    bool operator==(const ring_chain& other) const {
+        return d == other.d && values == other.values;
+    }
+    bool operator!=(const ring_chain& other) const {
+        return !(*this == other);
+    }
+    bool is_zero() const {
+        for (auto c : values)
+            if (c != value_type(0)) return false;
+        return true;
+    }
+
+    size_t bytes() const { return values.capacity() * sizeof(value_type); }
+};
+
+// bitset of the support, sums are word-wise exclusive ors
+template <>
+class ring_chain<z2_ring> {
+   public:
+    typedef bool value_type;
+
+   private:
+    int d = 0;
+    size_t n = 0;
+    std::vector<uint64_t> words;
+
+   public:
+    ring_chain() {}
+    ring_chain(int dim, size_t size)
+        : d(dim), n(size), words((size + 63) / 64, 0) {}
+
+    int dimension() const { return d; }
+    size_t size() const { return n; }
+    void assign(int dim, size_t size) {
+        d = dim;
+        n = size;
+        words.assign((size + 63) / 64, 0);
+    }
+
+    value_type get(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(size_t i, value_type c) {
+        uint64_t bit = uint64_t(1) << (i & 63);
+        if (c)
+            words[i >> 6] |= bit;
+        else
+            words[i >> 6] &= ~bit;
+    }
+    void flip(size_t i) { words[i >> 6] ^= uint64_t(1) << (i & 63); }
+    void add(size_t i, value_type c) {
+        if (c) flip(i);
+    }
+
+    ring_chain& operator+=(const ring_chain& other) {
+        if (d != other.d || n != other.n)
+            throw std::runtime_error("chains must match to be added\n");
+        for (size_t w = 0; w < words.size(); ++w) words[w] ^= other.words[w];
+        return *this;
+    }
+    bool operator==(const ring_chain& other) const {
+        return d == other.d && n == other.n && words == other.words;
+    }
+    bool operator!=(const ring_chain& other) const {
+        return !(*this == other);
+    }
+    bool is_zero() const {
+        for (auto w : words)
+            if (w) return false;
+        return true;
+    }
+
+    // the words themselves, bit i & 63 of word i >> 6 is cell i
+    const std::vector<uint64_t>& bits() const { return words; }
+
+    size_t bytes() const { return words.capacity() * sizeof(uint64_t); }
+};
+
+typedef ring_chain<real_ring> real_chain;
+typedef ring_chain<int32_ring> int32_chain;
+typedef ring_chain<int8_ring> int8_chain;
+typedef ring_chain<z2_ring> z2_chain;
+
+// the chain over R with the coefficients of c, throws when one of them is
+// not in R
+template <typename R>
+ring_chain<R> to_ring_chain(const chain_v& c) {
+    ring_chain<R> out(c.first, c.second.size());
+    for (size_t i = 0; i < c.second.size(); ++i)
+        if (c.second[i] != 0) out.set(i, R::from_double(c.second[i]));
+    return out;
+}
+
+template <typename R>
+chain_v to_chain_v(const ring_chain<R>& c) {
+    chain_v out(c.dimension(), std::vector<double>(c.size(), 0));
+    for (size_t i = 0; i < c.size(); ++i)
+        out.second[i] = R::to_double(c.get(i));
+    return out;
+}
+
+/*
+ * boundary of c into out, over the flat incidence arrays of the complex
+ * (built with the Hasse diagram). over z2_ring only the set bits are
+ * visited, a word at a time.
+ */
+template <typename R>
+void boundary(simplicial_complex& s_comp, const ring_chain<R>& c,
+              ring_chain<R>& out) {
+    int d = c.dimension();
+    if (d < 1 || d > s_comp.dimension()) throw No_Boundary();
+    simplicial_complex::incidence_view faces = s_comp.faces_view(d);
+    out.assign(d - 1, s_comp.get_level_size(d - 1));
+    for (size_t sigma = 0; sigma < c.size(); ++sigma) {
+        typename R::value_type coef = c.get(sigma);
+        if (coef == typename R::value_type(0)) continue;
+        for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k)
+            out.add(faces.cells[k], R::act(faces.signs[k], coef));
+    }
+}
+
+template <>
+inline void boundary(simplicial_complex& s_comp, const z2_chain& c,
+                     z2_chain& out) {
+    int d = c.dimension();
+    if (d < 1 || d > s_comp.dimension()) throw No_Boundary();
+    simplicial_complex::incidence_view faces = s_comp.faces_view(d);
+    out.assign(d - 1, s_comp.get_level_size(d - 1));
+    const std::vector<uint64_t>& words = c.bits();
+    for (size_t w = 0; w < words.size(); ++w) {
+        for (uint64_t word = words[w]; word; word &= word - 1) {
+            size_t sigma = w * 64 + size_t(__builtin_ctzll(word));
+            for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k)
+                out.flip(faces.cells[k]);
+        }
+    }
+}
+
+template <typename R>
+ring_chain<R> boundary(simplicial_complex& s_comp, const ring_chain<R>& c) {
+    ring_chain<R> out;
+    boundary(s_comp, c, out);
+    return out;
+}
+
+};  // namespace gsimp
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <scomplex/coeff_flow.hpp>
+#include <scomplex/memory.hpp>
+#include <scomplex/simplicial_complex.hpp>
+#include <scomplex/types.hpp>
+#include <scomplex/workspace.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief cocycles of degree d - 1 (d the dimension of the complex), one
+ * per class of H_{d-1}, to tell boundaries from other cycles
+ *
+ * z is the boundary of some c when c solves s c_sigma + s' c_sigma' =
+ * z_tau on every facet tau between two cofaces, and s c_sigma = z_tau on
+ * the boundary. these are the edges of the dual graph (top cells and the
+ * outside, at zero), the ones of a spanning forest of it can always be
+ * solved and z is a boundary exactly when every other facet closes its
+ * fundamental cycle. for the facets that span the columns of the boundary
+ * matrix of level d - 1 (restricted to those other facets) that already
+ * follows from z being a cycle, the rest give the cocycles. they are kept
+ * as a table of values per facet, pairing a chain with all of them takes
+ * time proportional to its support.
+ *
+ * the first cell of a closed component is left free: on an orientable one
+ * the conditions do not depend on it, on a non-orientable one (where no
+ * top chain has a zero boundary) one cocycle fixes it and is taken out of
+ * the others of the component.
+ *
+ * built once: a traversal of the dual graph, then union find (surfaces) or
+ * an elimination modulo a prime (above) to pick the facets. needs at most
+ * two cofaces per facet. queries only read, they can run concurrently.
+ */
+class cohomology_basis {
+    std::shared_ptr<simplicial_complex> s_comp;
+    // the facet each cocycle comes from
+    std::vector<size_t> generators;
+    // (cocycle, value) for the cocycles not zero on facet tau:
+    // entries[offsets[tau]] .. entries[offsets[tau + 1] - 1]
+    std::vector<size_t> offsets;
+    std::vector<std::pair<size_t, double>> entries;
+
+    void build();
+    std::vector<size_t> independent_facets(const std::vector<size_t>&);
+
+    template <typename F>
+    static void for_each_term(const chain_t& p, F f) {
+        for (vector_t::InnerIterator it(p.second); it; ++it)
+            f(size_t(it.index()), it.value());
+    }
+    template <typename F>
+    static void for_each_term(const chain_v& p, F f) {
+        for (size_t i = 0; i < p.second.size(); ++i)
+            if (p.second[i] != 0) f(i, p.second[i]);
+    }
+
+    template <typename Chain>
+    bool cycle_test(const Chain& p, workspace& ws);
+    template <typename Chain>
+    void pair_with(const Chain& p, std::vector<double>& out);
+
+   public:
+    explicit cohomology_basis(std::shared_ptr<simplicial_complex> sc)
+        : s_comp(sc) {
+        build();
+    }
+
+    // number of cocycles, the Betti number of degree d - 1
+    size_t rank() const { return generators.size(); }
+    const std::vector<size_t>& generator_facets() const {
+        return generators;
+    }
+
+    // boundary of p is zero, in time proportional to its support
+    bool is_cycle(const chain_t& p, workspace& ws = thread_workspace()) {
+        return cycle_test(p, ws);
+    }
+    bool is_cycle(const chain_v& p, workspace& ws = thread_workspace()) {
+        return cycle_test(p, ws);
+    }
+
+    // the pairing of the cycle p with each cocycle, zero for boundaries
+    void homology_class(const chain_t& p, std::vector<double>& out) {
+        pair_with(p, out);
+    }
+    void homology_class(const chain_v& p, std::vector<double>& out) {
+        pair_with(p, out);
+    }
+    std::vector<double> homology_class(const chain_t& p) {
+        std::vector<double> out;
+        pair_with(p, out);
+        return out;
+    }
+
+    bool is_boundary(const chain_t& p, workspace& ws = thread_workspace()) {
+        if (!cycle_test(p, ws)) return false;
+        pair_with(p, ws.pairings);
+        for (double c : ws.pairings)
+            if (c != 0) return false;
+        return true;
+    }
+    bool is_boundary(const chain_v& p, workspace& ws = thread_workspace()) {
+        if (!cycle_test(p, ws)) return false;
+        pair_with(p, ws.pairings);
+        for (double c : ws.pairings)
+            if (c != 0) return false;
+        return true;
+    }
+
+    memory_report get_memory_report() {
+        memory_report report;
+        report.add("generators", memory::vector_bytes(generators));
+        report.add("table", memory::vector_bytes(offsets) +
+                                memory::vector_bytes(entries));
+        return report;
+    }
+};
+
+//---------------------------------------
+// implementation
+
+template <typename Chain>
+bool cohomology_basis::cycle_test(const Chain& p, workspace& ws) {
+    int d = p.first;
+    if (d < 0 || d >= s_comp->dimension()) throw out_of_context();
+    if (d == 0) return true;
+    simplicial_complex::incidence_view faces = s_comp->faces_view(d);
+    size_t num_faces = s_comp->get_level_size(d - 1);
+    ws.in_boundary.reset(num_faces);
+    if (ws.boundary_value.size() < num_faces)
+        ws.boundary_value.resize(num_faces);
+    ws.boundary_cells.clear();
+    for_each_term(p, [&](size_t sigma, double c) {
+        for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k) {
+            size_t rho = faces.cells[k];
+            if (!ws.in_boundary.test(rho)) {
+                ws.in_boundary.set(rho);
+                ws.boundary_value[rho] = 0;
+                ws.boundary_cells.push_back(rho);
+            }
+            ws.boundary_value[rho] += faces.signs[k] * c;
+        }
+    });
+    for (size_t rho : ws.boundary_cells)
+        if (ws.boundary_value[rho] != 0) return false;
+    return true;
+}
+
+template <typename Chain>
+void cohomology_basis::pair_with(const Chain& p, std::vector<double>& out) {
+    if (p.first != s_comp->dimension() - 1) throw out_of_context();
+    out.assign(rank(), 0);
+    for_each_term(p, [&](size_t tau, double c) {
+        for (size_t k = offsets[tau]; k < offsets[tau + 1]; ++k)
+            out[entries[k].first] += entries[k].second * c;
+    });
+}
+
+void cohomology_basis::build() {
+    int d = s_comp->dimension();
+    if (d < 1) return;
+    size_t num_cells = s_comp->get_level_size(d);
+    size_t num_facets = s_comp->get_level_size(d - 1);
+    simplicial_complex::incidence_view faces = s_comp->faces_view(d);
+    simplicial_complex::incidence_view cofaces = s_comp->cofaces_view(d - 1);
+    for (size_t tau = 0; tau < num_facets; ++tau)
+        if (cofaces.end(tau) - cofaces.begin(tau) > 2)
+            throw std::runtime_error(
+                "a cohomology basis needs at most two cofaces per facet\n");
+
+    // spanning forest of the dual graph: each cell hangs from the facet it
+    // was reached through, the cells of the boundary from the outside and
+    // the first cell of a closed component from nothing. the cells of a
+    // closed component keep that root and their orientation relative to it
+    // (the sign the value of the root takes in theirs)
+    const size_t no_parent = size_t(-1);
+    std::vector<size_t> parent(num_cells, no_parent);
+    std::vector<size_t> root(num_cells, no_parent);
+    std::vector<int8_t> orientation(num_cells, 0);
+    std::vector<bool> reached(num_cells, false), in_tree(num_facets, false);
+    std::vector<size_t> queue;
+    queue.reserve(num_cells);
+    // tombstones (see simplicial_complex::update_cells) are left out
+    const std::vector<uint8_t>& removed_cells = s_comp->tombstones(d);
+    const std::vector<uint8_t>& removed_facets = s_comp->tombstones(d - 1);
+    for (size_t sigma = 0; sigma < removed_cells.size(); ++sigma)
+        if (removed_cells[sigma]) reached[sigma] = true;
+    for (auto& f : s_comp->boundary_facets()) {
+        if (reached[f.coface]) continue;
+        reached[f.coface] = true;
+        parent[f.coface] = f.facet;
+        in_tree[f.facet] = true;
+        queue.push_back(f.coface);
+    }
+    size_t head = 0, next_root = 0;
+    while (true) {
+        while (head < queue.size()) {
+            size_t sigma = queue[head++];
+            for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k) {
+                size_t tau = faces.cells[k];
+                for (size_t j = cofaces.begin(tau); j < cofaces.end(tau);
+                     ++j) {
+                    size_t sigma_p = cofaces.cells[j];
+                    if (reached[sigma_p]) continue;
+                    reached[sigma_p] = true;
+                    parent[sigma_p] = tau;
+                    // s c_sigma + s_p c_sigma_p = z_tau
+                    root[sigma_p] = root[sigma];
+                    orientation[sigma_p] =
+                        int8_t(-faces.signs[k] * cofaces.signs[j] *
+                               orientation[sigma]);
+                    in_tree[tau] = true;
+                    queue.push_back(sigma_p);
+                }
+            }
+        }
+        while (next_root < num_cells && reached[next_root]) ++next_root;
+        if (next_root == num_cells) break;
+        reached[next_root] = true;
+        root[next_root] = next_root;
+        orientation[next_root] = 1;
+        queue.push_back(next_root);
+    }
+
+    std::vector<size_t> others;
+    for (size_t tau = 0; tau < num_facets; ++tau)
+        if (!in_tree[tau] && (removed_facets.empty() || !removed_facets[tau]))
+            others.push_back(tau);
+    std::vector<size_t> candidates = independent_facets(others);
+
+    // the cocycle of facet e: z_e - s c_sigma - s' c_sigma' over its
+    // cofaces, with the coefficient of a cell expanded along its path to
+    // the root, c_sigma = s_tau (z_tau - s_p c_parent) for its parent facet.
+    // the root of a closed component adds -(s o_sigma + s' o_sigma') times
+    // its value, nonzero only where the orientations disagree
+    std::vector<std::vector<std::pair<size_t, double>>> cocycles(
+        candidates.size());
+    std::vector<double> root_coef(candidates.size(), 0);
+    for (size_t g = 0; g < candidates.size(); ++g) {
+        size_t e = candidates[g];
+        std::vector<std::pair<size_t, double>>& terms = cocycles[g];
+        terms.assign(1, {e, 1.0});
+        for (size_t j = cofaces.begin(e); j < cofaces.end(e); ++j)
+            root_coef[g] -= cofaces.signs[j] * orientation[cofaces.cells[j]];
+        for (size_t j = cofaces.begin(e); j < cofaces.end(e); ++j) {
+            size_t sigma = cofaces.cells[j];
+            int m = -cofaces.signs[j];
+            while (parent[sigma] != no_parent) {
+                size_t tau = parent[sigma];
+                int s = 0, s_p = 0;
+                size_t sigma_p = no_parent;
+                for (size_t i = cofaces.begin(tau); i < cofaces.end(tau);
+                     ++i) {
+                    if (cofaces.cells[i] == sigma) {
+                        s = cofaces.signs[i];
+                    } else {
+                        sigma_p = cofaces.cells[i];
+                        s_p = cofaces.signs[i];
+                    }
+                }
+                terms.push_back({tau, double(m * s)});
+                // hangs from the outside
+                if (sigma_p == no_parent) break;
+                m = -m * s * s_p;
+                sigma = sigma_p;
+            }
+        }
+    }
+
+    // on a non-orientable closed component the first cocycle depending on
+    // the root gives its value, which the other ones take in: z_e - a_e
+    // c_root and z_p - a_p c_root become z_e - (a_e / a_p) z_p
+    std::vector<size_t> pivot(num_cells, no_parent);
+    std::vector<bool> kept(candidates.size(), true);
+    for (size_t g = 0; g < candidates.size(); ++g) {
+        if (root_coef[g] == 0) continue;
+        size_t r = root[cofaces.cells[cofaces.begin(candidates[g])]];
+        if (pivot[r] == no_parent) {
+            pivot[r] = g;
+            kept[g] = false;
+            continue;
+        }
+        double ratio = root_coef[g] / root_coef[pivot[r]];
+        for (auto& term : cocycles[pivot[r]])
+            cocycles[g].push_back({term.first, -ratio * term.second});
+    }
+
+    std::vector<std::pair<size_t, std::pair<size_t, double>>> triplets;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (!kept[i]) continue;
+        size_t g = generators.size();
+        generators.push_back(candidates[i]);
+        std::vector<std::pair<size_t, double>>& terms = cocycles[i];
+        std::sort(terms.begin(), terms.end());
+        for (size_t k = 0; k < terms.size();) {
+            size_t tau = terms[k].first;
+            double value = 0;
+            for (; k < terms.size() && terms[k].first == tau; ++k)
+                value += terms[k].second;
+            if (value != 0) triplets.push_back({tau, {g, value}});
+        }
+    }
+
+    offsets.assign(num_facets + 1, 0);
+    for (auto& t : triplets) offsets[t.first + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    entries.resize(triplets.size());
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (auto& t : triplets) entries[next[t.first]++] = t.second;
+}
+
+/*
+ * the facets (of the given ones) outside a basis of the columns of the
+ * boundary matrix of level d - 1 restricted to them: their conditions do
+ * not follow from the others and the cycle condition
+ */
+std::vector<size_t> cohomology_basis::independent_facets(
+    const std::vector<size_t>& facets) {
+    int d = s_comp->dimension();
+    std::vector<size_t> kept;
+    if (d == 1) return facets;
+    simplicial_complex::incidence_view faces = s_comp->faces_view(d - 1);
+    size_t num_rows = s_comp->get_level_size(d - 2);
+
+    if (d == 2) {
+        // edges between vertices: a spanning forest of the graph
+        std::vector<size_t> root(num_rows);
+        std::iota(root.begin(), root.end(), 0);
+        auto find = [&](size_t v) {
+            while (root[v] != v) v = root[v] = root[root[v]];
+            return v;
+        };
+        for (size_t tau : facets) {
+            size_t a = find(faces.cells[faces.begin(tau)]);
+            size_t b = find(faces.cells[faces.begin(tau) + 1]);
+            if (a == b)
+                kept.push_back(tau);
+            else
+                root[std::max(a, b)] = std::min(a, b);
+        }
+        return kept;
+    }
+
+    // column reduction modulo a prime, pivots stored with a unit lowest
+    // entry, by their lowest row
+    typedef std::vector<std::pair<size_t, int64_t>> column;
+    const int64_t prime = 2147483647;
+    auto inverse = [&](int64_t a) {
+        int64_t result = 1, e = prime - 2;
+        for (a %= prime; e; e >>= 1, a = a * a % prime)
+            if (e & 1) result = result * a % prime;
+        return result;
+    };
+    std::vector<column> pivots(num_rows);
+    column col, merged;
+    for (size_t tau : facets) {
+        col.clear();
+        for (size_t k = faces.begin(tau); k < faces.end(tau); ++k)
+            col.push_back({faces.cells[k], (faces.signs[k] + prime) % prime});
+        while (!col.empty() && !pivots[col.back().first].empty()) {
+            const column& pivot = pivots[col.back().first];
+            int64_t factor = col.back().second;
+            merged.clear();
+            size_t i = 0, j = 0;
+            while (i < col.size() || j < pivot.size()) {
+                if (j == pivot.size() ||
+                    (i < col.size() && col[i].first < pivot[j].first)) {
+                    merged.push_back(col[i++]);
+                } else if (i == col.size() || pivot[j].first < col[i].first) {
+                    merged.push_back(
+                        {pivot[j].first,
+                         (prime - factor * pivot[j].second % prime) % prime});
+                    ++j;
+                } else {
+                    int64_t value =
+                        (col[i].second + prime -
+                         factor * pivot[j].second % prime) % prime;
+                    if (value != 0) merged.push_back({col[i].first, value});
+                    ++i;
+                    ++j;
+                }
+            }
+            std::swap(col, merged);
+        }
+        if (col.empty()) {
+            kept.push_back(tau);
+            continue;
+        }
+        int64_t unit = inverse(col.back().second);
+        for (auto& entry : col) entry.second = entry.second * unit % prime;
+        pivots[col.back().first] = col;
+    }
+    return kept;
+}
+
+};  // namespace gsimp
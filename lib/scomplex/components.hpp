@@ -0,0 +1,235 @@
+#pragma once
+
+#include <scomplex/coeff_flow.hpp>
+#include <scomplex/memory.hpp>
+#include <scomplex/simplicial_complex.hpp>
+#include <scomplex/thread_pool.hpp>
+#include <scomplex/types.hpp>
+#include <scomplex/union_find.hpp>
+#include <scomplex/workspace.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief the connected components of the top cells of a complex, two cells
+ * being connected when they share a facet
+ *
+ * a coefficient flow only reaches the component it starts in, this gives
+ * every component its own start: the coface of its first boundary facet,
+ * or its first cell on a closed component. components are numbered in
+ * order of their first (lowest) cell, facets take the component of their
+ * cofaces and facets without cofaces are in none.
+ *
+ * built once, by a union find shared by the threads of a pool (roots are
+ * always the lowest cell of their set, so the labels do not depend on the
+ * schedule). queries only read, they can run concurrently.
+ */
+class complex_components {
+    std::shared_ptr<simplicial_complex> s_comp;
+    std::vector<uint32_t> cell_label;
+    std::vector<uint32_t> facet_label;
+    // the top cells of component c, by index:
+    // cell_list[offsets[c]] .. cell_list[offsets[c + 1] - 1]
+    std::vector<size_t> offsets;
+    std::vector<size_t> cell_list;
+    // the first boundary facet of each component, facet no_cell when closed
+    std::vector<simplicial_complex::boundary_facet> starts;
+
+    void build(thread_pool& pool);
+
+   public:
+    static constexpr uint32_t no_component = uint32_t(-1);
+    static constexpr size_t no_cell = size_t(-1);
+
+    complex_components(std::shared_ptr<simplicial_complex> sc,
+                       thread_pool& pool)
+        : s_comp(sc) {
+        build(pool);
+    }
+
+    size_t size() const { return starts.size(); }
+    uint32_t of_cell(size_t sigma) const { return cell_label[sigma]; }
+    uint32_t of_facet(size_t tau) const { return facet_label[tau]; }
+
+    // the top cells of c are cells()[begin(c)] .. cells()[end(c) - 1]
+    size_t begin(size_t c) const { return offsets[c]; }
+    size_t end(size_t c) const { return offsets[c + 1]; }
+    const std::vector<size_t>& cells() const { return cell_list; }
+
+    // no facet of c is on the boundary of the complex
+    bool is_closed(size_t c) const { return starts[c].facet == no_cell; }
+    const simplicial_complex::boundary_facet& start(size_t c) const {
+        return starts[c];
+    }
+
+    memory_report get_memory_report() {
+        memory_report report;
+        report.add("labels", memory::vector_bytes(cell_label) +
+                                 memory::vector_bytes(facet_label));
+        report.add("cells", memory::vector_bytes(offsets) +
+                                memory::vector_bytes(cell_list) +
+                                memory::vector_bytes(starts));
+        return report;
+    }
+};
+
+// a component the chain has support on, and whether its part of the chain
+// is a boundary there
+struct component_flow {
+    size_t component;
+    bool bounding;
+};
+
+/*
+ * coefficient flow on every component of the complex that p has support
+ * on, each one on a thread of the pool and from the start of its component
+ * (see complex_components), into the same chain out. a component whose
+ * part of p has no bounding chain is reported as not bounding and left at
+ * zero instead of failing the whole flow, as are the components p does not
+ * touch (their part of p is zero, so is their bounding chain). report
+ * lists the touched components in order. throws no_bounding_chain when p
+ * is not zero on a facet without cofaces.
+ */
+void coeff_flow_components(simplicial_complex& s_comp,
+                           const complex_components& components,
+                           const chain_v& p, chain_v& out,
+                           std::vector<component_flow>& report,
+                           thread_pool& pool) {
+    GSIMP_PHASE("coeff_flow_components");
+    int d = s_comp.dimension();
+    if (p.first != d - 1) throw out_of_context();
+    size_t num_sigmas = s_comp.get_level_size(d);
+    const vector<double>& p_vec = p.second;
+    out.first = d;
+    out.second.assign(num_sigmas, 0);
+
+    std::vector<bool> touched(components.size(), false);
+    for (size_t tau = 0; tau < p_vec.size(); ++tau) {
+        if (p_vec[tau] == 0) continue;
+        uint32_t c = components.of_facet(tau);
+        if (c == complex_components::no_component) throw no_bounding_chain();
+        touched[c] = true;
+    }
+    report.clear();
+    for (size_t c = 0; c < components.size(); ++c)
+        if (touched[c]) report.push_back({c, true});
+
+    simplicial_complex::incidence_view faces = s_comp.faces_view(d);
+    simplicial_complex::incidence_view cofaces = s_comp.cofaces_view(d - 1);
+    // components share no cells, each flow writes its own part of out
+    parallel_for(pool, report.size(), [&](size_t i) {
+        size_t c = report[i].component;
+        size_t sigma_0 = components.cells()[components.begin(c)];
+        double c_0 = 0;
+        if (!components.is_closed(c)) {
+            const simplicial_complex::boundary_facet& f = components.start(c);
+            sigma_0 = f.coface;
+            c_0 = f.sign * p_vec[f.facet];
+        }
+        try {
+            flow_detail::flow_from(faces, cofaces, p_vec, sigma_0, c_0,
+                                   out.second, thread_workspace());
+        } catch (const no_bounding_chain&) {
+            report[i].bounding = false;
+            for (size_t k = components.begin(c); k < components.end(c); ++k)
+                out.second[components.cells()[k]] = 0;
+        }
+    });
+    GSIMP_COUNT("coeff_flow_components.components", report.size());
+}
+
+chain_v coeff_flow_components(simplicial_complex& s_comp,
+                              const complex_components& components,
+                              const chain_v& p,
+                              std::vector<component_flow>& report,
+                              thread_pool& pool) {
+    chain_v c_chain;
+    coeff_flow_components(s_comp, components, p, c_chain, report, pool);
+    return c_chain;
+}
+
+//---------------------------------------
+// implementation
+
+void complex_components::build(thread_pool& pool) {
+    int d = s_comp->dimension();
+    size_t num_cells = s_comp->get_level_size(d);
+    size_t num_facets = d > 0 ? s_comp->get_level_size(d - 1) : 0;
+    size_t num_parts = std::max<size_t>(1, pool.size());
+
+    // union find over the top cells, roots are the lowest cell of their set
+    concurrent_union_find sets(num_cells, pool);
+    auto range = [&](size_t part, size_t n) {
+        size_t part_size = (n + num_parts - 1) / num_parts;
+        return std::make_pair(std::min(n, part * part_size),
+                              std::min(n, (part + 1) * part_size));
+    };
+
+    if (d > 0) {
+        simplicial_complex::incidence_view cofaces =
+            s_comp->cofaces_view(d - 1);
+        parallel_for(pool, num_parts, [&](size_t part) {
+            auto r = range(part, num_facets);
+            for (size_t tau = r.first; tau < r.second; ++tau)
+                for (size_t k = cofaces.begin(tau) + 1; k < cofaces.end(tau);
+                     ++k)
+                    sets.unite(cofaces.cells[cofaces.begin(tau)],
+                               cofaces.cells[k]);
+        });
+    }
+
+    // roots are the first cells of their components, numbered in order.
+    // tombstones (see simplicial_complex::update_cells) are in none
+    const std::vector<uint8_t>& removed = s_comp->tombstones(d);
+    auto is_removed = [&](size_t sigma) {
+        return !removed.empty() && removed[sigma];
+    };
+    cell_label.assign(num_cells, no_component);
+    uint32_t num_components = 0;
+    for (size_t sigma = 0; sigma < num_cells; ++sigma)
+        if (sets.find(sigma) == sigma && !is_removed(sigma))
+            cell_label[sigma] = num_components++;
+    // the other cells read the label of their root, roots are not written
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, num_cells);
+        for (size_t sigma = r.first; sigma < r.second; ++sigma) {
+            size_t root = sets.find(sigma);
+            if (root != sigma) cell_label[sigma] = cell_label[root];
+        }
+    });
+
+    offsets.assign(num_components + 1, 0);
+    for (uint32_t c : cell_label)
+        if (c != no_component) offsets[c + 1]++;
+    for (size_t c = 0; c < num_components; ++c) offsets[c + 1] += offsets[c];
+    cell_list.resize(offsets[num_components]);
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t sigma = 0; sigma < num_cells; ++sigma)
+        if (cell_label[sigma] != no_component)
+            cell_list[next[cell_label[sigma]]++] = sigma;
+
+    facet_label.assign(num_facets, no_component);
+    starts.assign(num_components,
+                  simplicial_complex::boundary_facet{no_cell, no_cell, 0});
+    if (d == 0) return;
+    simplicial_complex::incidence_view cofaces = s_comp->cofaces_view(d - 1);
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, num_facets);
+        for (size_t tau = r.first; tau < r.second; ++tau)
+            if (cofaces.begin(tau) < cofaces.end(tau))
+                facet_label[tau] =
+                    cell_label[cofaces.cells[cofaces.begin(tau)]];
+    });
+    for (auto& f : s_comp->boundary_facets()) {
+        simplicial_complex::boundary_facet& start =
+            starts[cell_label[f.coface]];
+        if (start.facet == no_cell) start = f;
+    }
+}
+
+};  // namespace gsimp
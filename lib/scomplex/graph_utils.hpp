@@ -4,6 +4,12 @@
 #include <vector>
 #include <scomplex/types.hpp>
 #include <scomplex/simplicial_complex.hpp>
+#include <scomplex/workspace.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
 
 // graph libraries
 #include "boost/config.hpp"
@@ -24,6 +30,7 @@ functions:
     calculate_one_skelleton_graph(simplicial_complex& s_comp )
     complete_path(const graph_t& g, std::vector<vertex_t> vec)
     shortest_path(const graph_t& g, vertex_t s, vertex_t t)
+    (both also with a workspace and an output vector, allocation free)
 */
 
 typedef adjacency_list<               //
@@ -38,6 +45,18 @@ typedef typename graph_traits<graph_t>::vertex_descriptor vertex_t;
 typedef typename graph_traits<graph_t>::edge_descriptor edge_t;
 typedef std::pair<size_t, size_t> Edge;
 
+// euclidean length of the edge between the points a and b
+double edge_length(simplicial_complex& s_comp, size_t a, size_t b) {
+    point_t src_point = s_comp.get_point(a);
+    point_t trg_point = s_comp.get_point(b);
+    double norm = 0;
+    for (size_t i = 0; i < src_point.size(); ++i)
+        norm += pow(src_point[i] - trg_point[i], 2);
+    return sqrt(norm);
+}
+
+// the edges left by simplicial_complex::update_cells (tombstones) are not
+// in the graph
 graph_t calculate_one_skelleton_graph(simplicial_complex& s_comp  //
                                       ) {
     size_t num_points(s_comp.get_level_size(0));
@@ -47,25 +66,18 @@ graph_t calculate_one_skelleton_graph(simplicial_complex& s_comp  //
     std::vector<double> weights(num_edges);
 
     auto edges = s_comp.get_level(1);
+    const std::vector<uint8_t>& removed = s_comp.tombstones(1);
 
     graph_t one_skelleton(num_points);
 
     for (size_t ind = 0; ind < edges.size(); ++ind) {
+        if (!removed.empty() && removed[ind]) continue;
         size_t src_index = edges.at(ind).at(0);
         size_t trg_index = edges.at(ind).at(1);
 
-        point_t src_point = s_comp.get_point(src_index);
-        point_t trg_point = s_comp.get_point(trg_index);
-
         g_edges.push_back(std::make_pair(src_index, trg_index));
 
-        double norm = 0;
-        for (int i = 0; i < src_point.size(); ++i) { 
-            double sq_d = src_point.at(i) - trg_point.at(i);
-            sq_d = pow(sq_d,2);
-            norm += sq_d;
-        }
-        norm = sqrt(norm); //
+        double norm = edge_length(s_comp, src_index, trg_index);
         // (not really) TODO (but we want to check this)
         // penalize the use of lots of edges
         boost::add_edge(src_index,trg_index,norm,one_skelleton);
@@ -82,50 +94,90 @@ graph_t calculate_one_skelleton_graph(simplicial_complex& s_comp  //
 }
 
 /**
-* @brief  find the shortest path between two vertices in a graph.
+* @brief  append a shortest path between two vertices of a graph to out.
 *
 * @param g: graph (passed by ref)
 * @param s: source vertex (type: decltype(g)::vertex_descriptor)
-* @param t: source vertex (type: decltype(g)::vertex_descriptor)
+* @param t: target vertex (type: decltype(g)::vertex_descriptor)
+* @param ws: scratch space (distances, predecessors and heap), reused
+* @param out: the vertices after s up to t are appended to it
+*
+* dijkstra stopping at t, it does not allocate once ws and out are large
+* enough. throws if t cannot be reached from s.
+*/
+void shortest_path(graph_t& g, vertex_t s, vertex_t t, workspace& ws,
+                   std::vector<vertex_t>& out) {
+    if (s == t) return;
+    size_t n = num_vertices(g);
+    ws.reached.reset(n);
+    if (ws.distance.size() < n) {
+        ws.distance.resize(n);
+        ws.predecessor.resize(n);
+    }
+    auto& heap = ws.heap;  // (distance, vertex), closest on top
+    auto closer = std::greater<std::pair<double, size_t>>();
+    heap.clear();
+
+    auto weights = get(edge_weight, g);
+    ws.reached.set(s);
+    ws.distance[s] = 0;
+    heap.emplace_back(0.0, s);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), closer);
+        std::pair<double, size_t> top = heap.back();
+        heap.pop_back();
+        vertex_t v = top.second;
+        if (top.first > ws.distance[v]) continue;  // already settled closer
+        if (v == t) break;
+        for (auto es = out_edges(v, g); es.first != es.second; ++es.first) {
+            vertex_t w = target(*es.first, g);
+            double dist = top.first + weights[*es.first];
+            if (ws.reached.test(w) && ws.distance[w] <= dist) continue;
+            ws.reached.set(w);
+            ws.distance[w] = dist;
+            ws.predecessor[w] = v;
+            heap.emplace_back(dist, w);
+            std::push_heap(heap.begin(), heap.end(), closer);
+        }
+    }
+    if (!ws.reached.test(t))
+        throw std::runtime_error("no path between the vertices " +
+                                 std::to_string(s) + " and " +
+                                 std::to_string(t) + "\n");
+
+    // construct the path (going backwards from the target to the source)
+    size_t start = out.size();
+    for (vertex_t it = t; it != s; it = ws.predecessor[it]) out.push_back(it);
+    std::reverse(out.begin() + start, out.end());
+}
+
+/**
+* @brief  find the shortest path between two vertices in a graph.
 *
-* @returns: a vector of vertices
+* @returns: the vertices after s up to t
 *            (type: std::vector<decltype(g)::vertex_descriptor>)
 */
 std::vector<vertex_t> shortest_path(graph_t& g, vertex_t s, vertex_t t) {
-    // make a predecessor map
-    // property_map<graph_t, edge_weight_t>::type weight_map = get(edge_weight, g);
-    std::vector<vertex_t> predecessors(num_vertices(g));
-    std::vector<double> distances(num_vertices(g));
-    dijkstra_shortest_paths(g, s, predecessor_map(&predecessors[0]).distance_map(&distances[0]));
-    // construct the path (going backwards from the target to the source)
-    vertex_t it = t;
     std::vector<vertex_t> s_t_path{};
-    do {
-        s_t_path.push_back(it);
-        it = predecessors[it];
-    } while (it != s);
-    std::reverse(s_t_path.begin(), s_t_path.end());
+    shortest_path(g, s, t, thread_workspace(), s_t_path);
     return s_t_path;
 }
 
+// the way points joined by shortest paths, into out
+void complete_path(graph_t& g, const std::vector<vertex_t>& vec,
+                   std::vector<vertex_t>& out,
+                   workspace& ws = thread_workspace()) {
+    out.clear();
+    if (vec.empty()) return;
+    out.push_back(vec.front());
+    for (size_t i = 1; i < vec.size(); ++i)
+        shortest_path(g, vec[i - 1], vec[i], ws, out);
+}
+
 std::vector<vertex_t> complete_path(graph_t& g,
                                     std::vector<vertex_t> vec) {
-    std::vector<vertex_t>::iterator s = vec.begin();
-    std::vector<vertex_t>::iterator t = std::next(s);
-
-    // start calculatinng the full path
     std::vector<vertex_t> full_path;
-    full_path.push_back(*s);
-    while (t != vec.end()) {
-        // get the next vertex calculate and add the path between s and t
-        // (contains vertices other than s) to the full path
-        std::vector<vertex_t> path_portion{shortest_path(g, *s, *t)};
-        // quick vector merging
-        full_path.insert(full_path.end(), path_portion.begin(),
-                         path_portion.end());
-        std::advance(s, 1);
-        std::advance(t, 1);
-    }
+    complete_path(g, vec, full_path);
     return full_path;
 }
 };
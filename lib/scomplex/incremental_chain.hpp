@@ -0,0 +1,72 @@
+#pragma once
+
+#include <scomplex/coeff_flow.hpp>
+#include <scomplex/path_snapper.hpp>
+#include <scomplex/simplicial_complex.hpp>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief a cycle drawn as a path on a surface and its bounding chain, kept
+ * up to date while the path is edited
+ *
+ * set_path snaps the whole path and runs coeff_flow over the complex.
+ * edit_path only re-routes the legs of the snapped path whose way points
+ * moved, and adds the bounding chain of the change of the cycle found by
+ * coeff_flow_local, so an edit costs about the size of the region it
+ * sweeps. an edit that leaves no bounding chain throws no_bounding_chain
+ * and keeps the previous state. on closed complexes the chain of an edit is
+ * the one of smaller support, so the cell fixed at zero by set_path may not
+ * stay so.
+ */
+class incremental_chain {
+    std::shared_ptr<path_snapper> snapper;
+    std::shared_ptr<simplicial_complex> s_comp;
+    path_snapper::snapped_path path;
+    chain_v cycle, bounding;
+
+   public:
+    explicit incremental_chain(std::shared_ptr<path_snapper> snapper)
+        : snapper(snapper), s_comp(snapper->get_underlying_complex()) {}
+
+    // null_cell is the top cell at zero on closed complexes
+    void set_path(const std::vector<point_t>& waypoints,
+                  size_t null_cell = 0) {
+        path_snapper::snapped_path snapped;
+        snapper->snap_path_legs(waypoints, snapped);
+        std::vector<size_t> vertices;
+        snapped.indices(vertices);
+        chain_v new_cycle, new_bounding;
+        snapper->index_sequence_to_v_chain(vertices, new_cycle);
+        try {
+            coeff_flow_embedded(*s_comp, new_cycle, new_bounding);
+        } catch (const out_of_context&) {
+            // no boundary facet to start from
+            coeff_flow(*s_comp, new_cycle, null_cell, 0, new_bounding);
+        }
+        std::swap(path, snapped);
+        std::swap(cycle, new_cycle);
+        std::swap(bounding, new_bounding);
+    }
+
+    void edit_path(const std::vector<point_t>& waypoints) {
+        path_snapper::snapped_path snapped(path);
+        chain_t delta = s_comp->new_chain(1);
+        snapper->resnap_path_legs(waypoints, snapped, delta);
+        // leaves bounding as it was when it throws
+        update_bounding_chain(*s_comp, bounding, delta);
+        for (vector_t::InnerIterator it(delta.second); it; ++it)
+            cycle.second[it.index()] += it.value();
+        std::swap(path, snapped);
+    }
+
+    const path_snapper::snapped_path& get_path() const { return path; }
+    const chain_v& get_cycle() const { return cycle; }
+    const chain_v& get_bounding_chain() const { return bounding; }
+};
+
+};  // namespace gsimp
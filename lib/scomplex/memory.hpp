@@ -0,0 +1,204 @@
+#pragma once
+
+#include <scomplex/types.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+namespace gsimp {
+
+/**
+ * @brief bytes held by the parts of a data structure
+ *
+ * entry names are "structure" or "structure[level]". sizes of containers
+ * are computed from their capacities, node based structures (simplex tree,
+ * Hasse diagram, KD-tree, graph) are estimated from their node layouts.
+ */
+struct memory_report {
+    std::vector<std::pair<std::string, size_t>> entries;
+
+    void add(const std::string& name, size_t bytes) {
+        entries.emplace_back(name, bytes);
+    }
+
+    void add(const std::string& prefix, const memory_report& other) {
+        for (auto& entry : other.entries)
+            entries.emplace_back(prefix + "." + entry.first, entry.second);
+    }
+
+    size_t total() const {
+        size_t sum = 0;
+        for (auto& entry : entries) sum += entry.second;
+        return sum;
+    }
+
+    // bytes of the entries whose names start with prefix
+    size_t bytes(const std::string& prefix) const {
+        size_t sum = 0;
+        for (auto& entry : entries)
+            if (entry.first.compare(0, prefix.size(), prefix) == 0)
+                sum += entry.second;
+        return sum;
+    }
+
+    void write(std::ostream& out) const {
+        for (auto& entry : entries)
+            out << entry.first << ": " << entry.second << " bytes\n";
+        out << "total: " << total() << " bytes\n";
+    }
+
+    void write_json(std::ostream& out) const {
+        out << "{";
+        for (size_t i = 0; i < entries.size(); ++i)
+            out << (i ? ", " : "") << "\"" << entries[i].first
+                << "\": " << entries[i].second;
+        out << "}";
+    }
+};
+
+namespace memory {
+
+template <typename T>
+size_t vector_bytes(const std::vector<T>& vec) {
+    return vec.capacity() * sizeof(T);
+}
+
+inline size_t vector_bytes(const std::vector<bool>& vec) {
+    return vec.capacity() / 8;
+}
+
+inline size_t matrix_bytes(const matrix_t& mat) {
+    size_t bytes = mat.data().allocatedSize() *
+                   (sizeof(double) + sizeof(matrix_t::StorageIndex));
+    bytes += (mat.outerSize() + 1) * sizeof(matrix_t::StorageIndex);
+    if (!mat.isCompressed())
+        bytes += mat.outerSize() * sizeof(matrix_t::StorageIndex);
+    return bytes;
+}
+
+inline size_t points_bytes(const std::vector<point_t>& points) {
+    size_t bytes = vector_bytes(points);
+    for (auto& pt : points) bytes += vector_bytes(pt);
+    return bytes;
+}
+
+/*
+ * allocation counters
+ *
+ * they only move in programs that replace the global operator new with
+ * GSIMP_COUNT_ALLOCATIONS() (in exactly one of their translation units),
+ * then every allocation of the process is counted, library ones included.
+ * Eigen's dense storage is the exception, aligned_malloc calls malloc
+ * directly.
+ */
+
+struct allocation_stats {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+inline std::atomic<uint64_t>& allocation_counter() {
+    static std::atomic<uint64_t> count(0);
+    return count;
+}
+
+inline std::atomic<uint64_t>& allocated_bytes_counter() {
+    static std::atomic<uint64_t> bytes(0);
+    return bytes;
+}
+
+inline allocation_stats allocations() {
+    return {allocation_counter().load(std::memory_order_relaxed),
+            allocated_bytes_counter().load(std::memory_order_relaxed)};
+}
+
+// allocations made (by any thread) since construction
+class allocation_scope {
+    allocation_stats start;
+
+   public:
+    allocation_scope() : start(allocations()) {}
+
+    allocation_stats delta() const {
+        allocation_stats now = allocations();
+        return {now.allocations - start.allocations, now.bytes - start.bytes};
+    }
+};
+
+/*
+ * resident set size of the process
+ */
+
+// reads a "Key:   1234 kB" line of /proc/self/status, 0 if unavailable
+inline size_t proc_status_bytes(const char* key) {
+    std::ifstream status("/proc/self/status");
+    std::string line, prefix = std::string(key) + ":";
+    while (std::getline(status, line)) {
+        if (line.compare(0, prefix.size(), prefix) == 0)
+            return std::strtoull(line.c_str() + prefix.size(), nullptr, 10) *
+                   1024;
+    }
+    return 0;
+}
+
+inline size_t current_rss() { return proc_status_bytes("VmRSS"); }
+
+// high water mark of the resident set, since start or the last reset
+inline size_t peak_rss() {
+    size_t peak = proc_status_bytes("VmHWM");
+    if (peak != 0) return peak;
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024;
+#endif
+}
+
+// lowers the high water mark to the current rss (linux only), false if the
+// kernel does not allow it, peak_rss then keeps reporting the process peak
+inline bool reset_peak_rss() {
+    FILE* clear_refs = std::fopen("/proc/self/clear_refs", "w");
+    if (!clear_refs) return false;
+    bool reset = std::fputs("5", clear_refs) >= 0;
+    return std::fclose(clear_refs) == 0 && reset;
+}
+
+};  // namespace memory
+};  // namespace gsimp
+
+// gcc takes the malloc/free pairs below for mismatched new/delete
+#if defined(__GNUC__) && !defined(__clang__)
+#define GSIMP_ALLOCATIONS_PRAGMA \
+    _Pragma("GCC diagnostic ignored \"-Wmismatched-new-delete\"")
+#else
+#define GSIMP_ALLOCATIONS_PRAGMA
+#endif
+
+// replacement global allocation functions counting every allocation
+#define GSIMP_COUNT_ALLOCATIONS()                                           \
+    GSIMP_ALLOCATIONS_PRAGMA                                                \
+    void* operator new(std::size_t size) {                                  \
+        gsimp::memory::allocation_counter().fetch_add(                      \
+            1, std::memory_order_relaxed);                                  \
+        gsimp::memory::allocated_bytes_counter().fetch_add(                 \
+            size, std::memory_order_relaxed);                               \
+        if (void* p = std::malloc(size ? size : 1)) return p;               \
+        throw std::bad_alloc();                                             \
+    }                                                                       \
+    void* operator new[](std::size_t size) { return operator new(size); }   \
+    void operator delete(void* p) noexcept { std::free(p); }                \
+    void operator delete[](void* p) noexcept { std::free(p); }              \
+    void operator delete(void* p, std::size_t) noexcept { std::free(p); }   \
+    void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,595 @@
+#pragma once
+
+#include <scomplex/simplicial_complex.hpp>
+#include <scomplex/thread_pool.hpp>
+#include <scomplex/types.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gsimp {
+
+/*
+ * synthetic meshes for benchmarks and stress tests
+ *
+ * every generator computes any point or cell from its index alone, so meshes
+ * are produced in parallel, straight into flat buffers, and can be streamed
+ * block by block when they do not fit in memory. cells come consistently
+ * oriented, and each mesh knows a region of top cells (a bounding chain)
+ * together with a cell outside of it, which gives a cycle/boundary pair with
+ * a known answer (see known_pair).
+ *
+ * meshes:
+ *   grid_mesh    triangulated rectangle, optionally jittered with Delaunay
+ *                diagonals                                  (2d, embedded)
+ *   sphere_mesh  uv sphere                                  (2d, closed)
+ *   torus_mesh   torus, optionally with square holes        (2d)
+ *   block_mesh   cube of tetrahedra (6 per cube)            (3d, embedded)
+ */
+
+namespace mesh_gen {
+
+// counter based random numbers, the same index always gives the same value
+inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// uniform in [-1, 1)
+inline double noise(uint64_t seed, uint64_t index, uint64_t stream) {
+    uint64_t h = splitmix64(seed ^ splitmix64(index * 4 + stream));
+    return double(h >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+// sign of the permutation that sorts the vertices of a cell
+inline int orientation(const size_t* cell, size_t size) {
+    int sign = 1;
+    for (size_t i = 0; i < size; ++i)
+        for (size_t j = i + 1; j < size; ++j)
+            if (cell[i] > cell[j]) sign = -sign;
+    return sign;
+}
+
+const double pi = 3.14159265358979323846;
+
+};  // namespace mesh_gen
+
+class mesh_generator {
+   public:
+    virtual ~mesh_generator() {}
+
+    virtual std::string name() const = 0;
+    // dimension of the top cells, points always have 3 coordinates
+    virtual int dimension() const = 0;
+    virtual size_t num_points() const = 0;
+    virtual size_t num_cells() const = 0;
+    virtual void point(size_t i, double* xyz) const = 0;
+    // vertices of cell i, all cells are oriented consistently
+    virtual void cell(size_t i, size_t* vertices) const = 0;
+
+    // top cells of the known bounding chain (coefficient 1 in the orientation
+    // of the generated cells)
+    virtual bool in_region(size_t i) const = 0;
+    // a cell outside the region, a valid null face for coeff_flow
+    virtual size_t zero_cell() const = 0;
+    // no boundary, coeff_flow needs the zero cell (coeff_flow_embedded does
+    // not apply)
+    virtual bool closed() const { return false; }
+    // vertex loops (closed, first vertex repeated) whose sum is the boundary
+    // of the region, empty when the region boundary is not a set of loops
+    virtual std::vector< std::vector< size_t > > boundary_loops() const {
+        return {};
+    }
+
+    size_t cell_size() const { return dimension() + 1; }
+};
+
+//
+// mesh generators
+//
+
+class grid_mesh : public mesh_generator {
+    size_t nx, ny;
+    double jitter;
+    bool delaunay;
+    uint64_t seed;
+    double step;
+    size_t i0, i1, j0, j1;  // region (in quads)
+
+    size_t vertex(size_t i, size_t j) const { return i * (ny + 1) + j; }
+
+    void raw_point(size_t i, size_t j, double* xy) const {
+        xy[0] = -0.5 + i * step;
+        xy[1] = -0.5 + j * step;
+        if (jitter > 0 && i > 0 && j > 0 && i < nx && j < ny) {
+            xy[0] += jitter * step * mesh_gen::noise(seed, vertex(i, j), 0);
+            xy[1] += jitter * step * mesh_gen::noise(seed, vertex(i, j), 1);
+        }
+    }
+
+    // true when the quad is split along (i, j + 1) -- (i + 1, j)
+    bool flipped(size_t i, size_t j) const {
+        if (!delaunay) return false;
+        double a[2], b[2], c[2], d[2];
+        raw_point(i, j, a);
+        raw_point(i + 1, j, b);
+        raw_point(i + 1, j + 1, c);
+        raw_point(i, j + 1, d);
+        // d strictly inside the circumcircle of (a, b, c): flip the diagonal
+        double adx = a[0] - d[0], ady = a[1] - d[1];
+        double bdx = b[0] - d[0], bdy = b[1] - d[1];
+        double cdx = c[0] - d[0], cdy = c[1] - d[1];
+        double det = (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) -
+                     (bdx * bdx + bdy * bdy) * (adx * cdy - cdx * ady) +
+                     (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+        return det > 0;
+    }
+
+   public:
+    /**
+     * @param _nx, _ny: number of quads along each side (at least 3)
+     * @param _jitter: displacement of interior vertices, relative to the step
+     *                 (below .5 keeps the triangles valid)
+     * @param _delaunay: pick the Delaunay diagonal of each quad
+     */
+    grid_mesh(size_t _nx, size_t _ny, double _jitter = 0,
+              bool _delaunay = false, uint64_t _seed = 1)
+        : nx(_nx), ny(_ny), jitter(_jitter), delaunay(_delaunay), seed(_seed) {
+        if (nx < 3 || ny < 3)
+            throw std::invalid_argument("grid_mesh needs at least 3x3 quads");
+        step = 1.0 / std::max(nx, ny);
+        i0 = std::max< size_t >(1, nx / 4);
+        i1 = std::max(i0 + 1, 3 * nx / 4);
+        j0 = std::max< size_t >(1, ny / 4);
+        j1 = std::max(j0 + 1, 3 * ny / 4);
+    }
+
+    std::string name() const {
+        return std::string(jitter > 0 ? "perturbed_grid" : "grid") +
+               std::to_string(num_cells());
+    }
+    int dimension() const { return 2; }
+    size_t num_points() const { return (nx + 1) * (ny + 1); }
+    size_t num_cells() const { return 2 * nx * ny; }
+
+    void point(size_t v, double* xyz) const {
+        raw_point(v / (ny + 1), v % (ny + 1), xyz);
+        xyz[2] = 0;
+    }
+
+    void cell(size_t c, size_t* vs) const {
+        size_t q = c / 2, i = q / ny, j = q % ny;
+        size_t v00 = vertex(i, j), v10 = vertex(i + 1, j);
+        size_t v11 = vertex(i + 1, j + 1), v01 = vertex(i, j + 1);
+        // counter clockwise triangles
+        if (!flipped(i, j)) {
+            if (c % 2 == 0) { vs[0] = v00; vs[1] = v10; vs[2] = v11; }
+            else            { vs[0] = v00; vs[1] = v11; vs[2] = v01; }
+        } else {
+            if (c % 2 == 0) { vs[0] = v00; vs[1] = v10; vs[2] = v01; }
+            else            { vs[0] = v10; vs[1] = v11; vs[2] = v01; }
+        }
+    }
+
+    bool in_region(size_t c) const {
+        size_t q = c / 2, i = q / ny, j = q % ny;
+        return i0 <= i && i < i1 && j0 <= j && j < j1;
+    }
+
+    size_t zero_cell() const { return 0; }
+
+    std::vector< std::vector< size_t > > boundary_loops() const {
+        std::vector< size_t > loop;
+        for (size_t i = i0; i < i1; ++i) loop.push_back(vertex(i, j0));
+        for (size_t j = j0; j < j1; ++j) loop.push_back(vertex(i1, j));
+        for (size_t i = i1; i > i0; --i) loop.push_back(vertex(i, j1));
+        for (size_t j = j1; j > j0; --j) loop.push_back(vertex(i0, j));
+        loop.push_back(loop.front());
+        return {loop};
+    }
+};
+
+class sphere_mesh : public mesh_generator {
+    size_t n_lat, n_lon;
+    double jitter;
+    uint64_t seed;
+
+    size_t south() const { return 1 + (n_lat - 1) * n_lon; }
+    size_t ring(size_t r, size_t k) const {
+        return 1 + (r - 1) * n_lon + (k % n_lon);
+    }
+
+   public:
+    /**
+     * @param _n_lat: number of bands between the poles (at least 3)
+     * @param _n_lon: number of meridians (at least 3)
+     * @param _jitter: angular displacement of the vertices, relative to the
+     *                 spacing of the rings
+     */
+    sphere_mesh(size_t _n_lat, size_t _n_lon, double _jitter = 0,
+                uint64_t _seed = 1)
+        : n_lat(_n_lat), n_lon(_n_lon), jitter(_jitter), seed(_seed) {
+        if (n_lat < 3 || n_lon < 3)
+            throw std::invalid_argument("sphere_mesh needs 3 bands and rings");
+    }
+
+    std::string name() const { return "sphere" + std::to_string(num_cells()); }
+    int dimension() const { return 2; }
+    size_t num_points() const { return 2 + (n_lat - 1) * n_lon; }
+    size_t num_cells() const { return 2 * n_lon * (n_lat - 1); }
+
+    void point(size_t v, double* xyz) const {
+        if (v == 0 || v == south()) {
+            xyz[0] = xyz[1] = 0;
+            xyz[2] = v == 0 ? 1 : -1;
+            return;
+        }
+        size_t r = 1 + (v - 1) / n_lon, k = (v - 1) % n_lon;
+        double theta = mesh_gen::pi * (r + 0.25 * jitter *
+                                               mesh_gen::noise(seed, v, 0)) /
+                       n_lat;
+        double phi = 2 * mesh_gen::pi *
+                     (k + 0.25 * jitter * mesh_gen::noise(seed, v, 1)) / n_lon;
+        xyz[0] = std::sin(theta) * std::cos(phi);
+        xyz[1] = std::sin(theta) * std::sin(phi);
+        xyz[2] = std::cos(theta);
+    }
+
+    void cell(size_t c, size_t* vs) const {
+        // outward normals: north cap, bands of two triangles, south cap
+        if (c < n_lon) {
+            vs[0] = 0; vs[1] = ring(1, c); vs[2] = ring(1, c + 1);
+        } else if (c >= num_cells() - n_lon) {
+            size_t k = c - (num_cells() - n_lon);
+            vs[0] = south(); vs[1] = ring(n_lat - 1, k + 1);
+            vs[2] = ring(n_lat - 1, k);
+        } else {
+            size_t q = (c - n_lon) / 2, r = 1 + q / n_lon, k = q % n_lon;
+            size_t a = ring(r, k), b = ring(r, k + 1);
+            size_t d = ring(r + 1, k), e = ring(r + 1, k + 1);
+            if (c % 2 == 0) { vs[0] = a; vs[1] = d; vs[2] = e; }
+            else            { vs[0] = a; vs[1] = e; vs[2] = b; }
+        }
+    }
+
+    // the northern cap, down to ring n_lat / 2
+    bool in_region(size_t c) const {
+        return c < n_lon + 2 * n_lon * (n_lat / 2 - 1);
+    }
+
+    size_t zero_cell() const { return num_cells() - 1; }
+    bool closed() const { return true; }
+
+    std::vector< std::vector< size_t > > boundary_loops() const {
+        std::vector< size_t > loop;
+        for (size_t k = 0; k <= n_lon; ++k) loop.push_back(ring(n_lat / 2, k));
+        return {loop};
+    }
+};
+
+class torus_mesh : public mesh_generator {
+    size_t n_u, n_v, holes;
+    double jitter;
+    uint64_t seed;
+    size_t hole_size;
+    // first cell of each column of quads (columns with a hole are shorter)
+    std::vector< size_t > column_start;
+    size_t band0, band1;  // region: columns [band0, band1)
+
+    size_t vertex(size_t i, size_t j) const {
+        return (i % n_u) * n_v + (j % n_v);
+    }
+
+    // holes are hole_size x hole_size blocks of quads in the second half
+    bool hole_column(size_t i, size_t& h) const {
+        if (holes == 0 || i < n_u / 2) return false;
+        size_t span = (n_u - n_u / 2) / holes;
+        h = (i - n_u / 2) / span;
+        return h < holes && (i - n_u / 2) % span < hole_size;
+    }
+    size_t hole_row() const { return n_v / 2 - hole_size / 2; }
+
+   public:
+    /**
+     * @param _n_u: quads around the big circle (at least 8)
+     * @param _n_v: quads around the tube (at least 3)
+     * @param _holes: number of square holes cut out of the surface
+     */
+    torus_mesh(size_t _n_u, size_t _n_v, size_t _holes = 0,
+               double _jitter = 0, uint64_t _seed = 1)
+        : n_u(_n_u), n_v(_n_v), holes(_holes), jitter(_jitter), seed(_seed) {
+        if (n_u < 8 || n_v < 3)
+            throw std::invalid_argument("torus_mesh needs 8x3 quads");
+        if (holes > 0 && (n_u - n_u / 2) / holes < 2)
+            throw std::invalid_argument("too many holes for the torus");
+        hole_size = holes == 0 ? 0
+                               : std::max< size_t >(
+                                     1, std::min((n_u - n_u / 2) / holes / 2,
+                                                 n_v / 3));
+        column_start.resize(n_u + 1, 0);
+        for (size_t i = 0; i < n_u; ++i) {
+            size_t h;
+            size_t quads = hole_column(i, h) ? n_v - hole_size : n_v;
+            column_start[i + 1] = column_start[i] + 2 * quads;
+        }
+        band0 = n_u / 8;
+        band1 = std::max(band0 + 1, n_u / 4);
+    }
+
+    std::string name() const {
+        return "torus" + std::to_string(num_cells()) + "_" +
+               std::to_string(holes) + "holes";
+    }
+    int dimension() const { return 2; }
+    size_t num_points() const { return n_u * n_v; }
+    size_t num_cells() const { return column_start[n_u]; }
+
+    void point(size_t v, double* xyz) const {
+        const double R = 1, r = 0.35;
+        double u = 2 * mesh_gen::pi *
+                   (v / n_v + 0.25 * jitter * mesh_gen::noise(seed, v, 0)) /
+                   n_u;
+        double w = 2 * mesh_gen::pi *
+                   (v % n_v + 0.25 * jitter * mesh_gen::noise(seed, v, 1)) /
+                   n_v;
+        xyz[0] = (R + r * std::cos(w)) * std::cos(u);
+        xyz[1] = (R + r * std::cos(w)) * std::sin(u);
+        xyz[2] = r * std::sin(w);
+    }
+
+    void cell(size_t c, size_t* vs) const {
+        size_t i = std::upper_bound(column_start.begin(), column_start.end(),
+                                    c) -
+                   column_start.begin() - 1;
+        size_t j = (c - column_start[i]) / 2, h;
+        if (hole_column(i, h) && j >= hole_row()) j += hole_size;
+        size_t v00 = vertex(i, j), v10 = vertex(i + 1, j);
+        size_t v11 = vertex(i + 1, j + 1), v01 = vertex(i, j + 1);
+        if (c % 2 == 0) { vs[0] = v00; vs[1] = v10; vs[2] = v11; }
+        else            { vs[0] = v00; vs[1] = v11; vs[2] = v01; }
+    }
+
+    // a band of columns around the tube, away from the holes
+    bool in_region(size_t c) const {
+        return column_start[band0] <= c && c < column_start[band1];
+    }
+
+    size_t zero_cell() const { return column_start[band1]; }
+    bool closed() const { return holes == 0; }
+
+    std::vector< std::vector< size_t > > boundary_loops() const {
+        std::vector< size_t > right, left;
+        for (size_t j = 0; j <= n_v; ++j) right.push_back(vertex(band1, j));
+        for (size_t j = n_v + 1; j > 0; --j) left.push_back(vertex(band0, j - 1));
+        return {right, left};
+    }
+};
+
+class block_mesh : public mesh_generator {
+    size_t nx, ny, nz;
+    double jitter;
+    uint64_t seed;
+    double step;
+
+    size_t vertex(size_t i, size_t j, size_t k) const {
+        return (i * (ny + 1) + j) * (nz + 1) + k;
+    }
+
+   public:
+    /**
+     * @param _nx, _ny, _nz: number of cubes along each side (at least 3),
+     *                       each cube is split into 6 tetrahedra around its
+     *                       main diagonal
+     */
+    block_mesh(size_t _nx, size_t _ny, size_t _nz, double _jitter = 0,
+               uint64_t _seed = 1)
+        : nx(_nx), ny(_ny), nz(_nz), jitter(_jitter), seed(_seed) {
+        if (nx < 3 || ny < 3 || nz < 3)
+            throw std::invalid_argument("block_mesh needs 3x3x3 cubes");
+        step = 1.0 / std::max(nx, std::max(ny, nz));
+    }
+
+    std::string name() const { return "block" + std::to_string(num_cells()); }
+    int dimension() const { return 3; }
+    size_t num_points() const { return (nx + 1) * (ny + 1) * (nz + 1); }
+    size_t num_cells() const { return 6 * nx * ny * nz; }
+
+    void point(size_t v, double* xyz) const {
+        size_t k = v % (nz + 1), j = (v / (nz + 1)) % (ny + 1),
+               i = v / ((nz + 1) * (ny + 1));
+        size_t idx[3] = {i, j, k}, n[3] = {nx, ny, nz};
+        bool interior = true;
+        for (int a = 0; a < 3; ++a) interior &= idx[a] > 0 && idx[a] < n[a];
+        for (int a = 0; a < 3; ++a) {
+            xyz[a] = -0.5 + idx[a] * step;
+            if (interior && jitter > 0)
+                xyz[a] += jitter * step * mesh_gen::noise(seed, v, a);
+        }
+    }
+
+    void cell(size_t c, size_t* vs) const {
+        // permutations of the axes, the odd ones get two vertices swapped so
+        // that every tetrahedron is positively oriented
+        static const int perms[6][3] = {{0, 1, 2}, {1, 2, 0}, {2, 0, 1},
+                                        {0, 2, 1}, {2, 1, 0}, {1, 0, 2}};
+        size_t cube = c / 6, t = c % 6;
+        size_t pos[3] = {cube / (ny * nz), (cube / nz) % ny, cube % nz};
+        size_t path[4];
+        path[0] = vertex(pos[0], pos[1], pos[2]);
+        for (int s = 0; s < 3; ++s) {
+            ++pos[perms[t][s]];
+            path[s + 1] = vertex(pos[0], pos[1], pos[2]);
+        }
+        vs[0] = path[0];
+        vs[1] = path[1];
+        vs[2] = t < 3 ? path[2] : path[3];
+        vs[3] = t < 3 ? path[3] : path[2];
+    }
+
+    bool in_region(size_t c) const {
+        size_t cube = c / 6;
+        size_t pos[3] = {cube / (ny * nz), (cube / nz) % ny, cube % nz};
+        size_t n[3] = {nx, ny, nz};
+        for (int a = 0; a < 3; ++a) {
+            size_t lo = std::max< size_t >(1, n[a] / 4);
+            size_t hi = std::max(lo + 1, 3 * n[a] / 4);
+            if (pos[a] < lo || pos[a] >= hi) return false;
+        }
+        return true;
+    }
+
+    size_t zero_cell() const { return 0; }
+};
+
+//
+// producing meshes
+//
+
+// mesh in flat buffers, 3 coordinates per point
+struct flat_mesh {
+    size_t cell_size{0};
+    std::vector< double > coordinates;
+    std::vector< size_t > cells;
+
+    size_t num_points() const { return coordinates.size() / 3; }
+    size_t num_cells() const { return cell_size ? cells.size() / cell_size : 0; }
+};
+
+// coordinates of points [begin, end) into out (3 doubles per point)
+inline void generate_points(const mesh_generator& gen, size_t begin,
+                            size_t end, double* out, thread_pool& pool) {
+    const size_t block = 1 << 16;
+    parallel_for(pool, (end - begin + block - 1) / block, [&](size_t b) {
+        size_t last = std::min(end, begin + (b + 1) * block);
+        for (size_t i = begin + b * block; i < last; ++i)
+            gen.point(i, out + 3 * (i - begin));
+    });
+}
+
+// vertices of cells [begin, end) into out (cell_size indices per cell)
+inline void generate_cells(const mesh_generator& gen, size_t begin,
+                           size_t end, size_t* out, thread_pool& pool) {
+    const size_t block = 1 << 16, k = gen.cell_size();
+    parallel_for(pool, (end - begin + block - 1) / block, [&](size_t b) {
+        size_t last = std::min(end, begin + (b + 1) * block);
+        for (size_t i = begin + b * block; i < last; ++i)
+            gen.cell(i, out + k * (i - begin));
+    });
+}
+
+inline flat_mesh generate_mesh(const mesh_generator& gen, thread_pool& pool) {
+    flat_mesh mesh;
+    mesh.cell_size = gen.cell_size();
+    mesh.coordinates.resize(3 * gen.num_points());
+    mesh.cells.resize(mesh.cell_size * gen.num_cells());
+    generate_points(gen, 0, gen.num_points(), mesh.coordinates.data(), pool);
+    generate_cells(gen, 0, gen.num_cells(), mesh.cells.data(), pool);
+    return mesh;
+}
+
+inline flat_mesh generate_mesh(const mesh_generator& gen) {
+    thread_pool pool;
+    return generate_mesh(gen, pool);
+}
+
+/**
+ * @brief generate the cells block by block, calling
+ * sink(first_cell, const size_t* vertices, num_cells) for each block in
+ * order. only one block is held in memory at a time.
+ */
+template < typename Sink >
+void stream_cells(const mesh_generator& gen, thread_pool& pool,
+                  size_t block_cells, Sink sink) {
+    std::vector< size_t > buffer(block_cells * gen.cell_size());
+    for (size_t first = 0; first < gen.num_cells(); first += block_cells) {
+        size_t last = std::min(gen.num_cells(), first + block_cells);
+        generate_cells(gen, first, last, buffer.data(), pool);
+        sink(first, static_cast< const size_t* >(buffer.data()), last - first);
+    }
+}
+
+// the point and cell vectors the simplicial_complex constructor takes
+inline std::pair< std::vector< point_t >, std::vector< cell_t > >
+complex_input(const flat_mesh& mesh) {
+    std::vector< point_t > points(mesh.num_points());
+    for (size_t i = 0; i < points.size(); ++i)
+        points[i].assign(mesh.coordinates.begin() + 3 * i,
+                         mesh.coordinates.begin() + 3 * (i + 1));
+    std::vector< cell_t > cells(mesh.num_cells());
+    for (size_t i = 0; i < cells.size(); ++i)
+        cells[i].assign(mesh.cells.begin() + mesh.cell_size * i,
+                        mesh.cells.begin() + mesh.cell_size * (i + 1));
+    return std::make_pair(points, cells);
+}
+
+/**
+ * @brief the known (cycle, bounding chain) pair of a generated mesh, in the
+ * indexing and orientation of s_comp (which has to be built from the mesh)
+ *
+ * the bounding chain is the region of the generator, the cycle is its
+ * boundary. coeff_flow(s_comp, cycle, zero cell, 0) gives back the bounding
+ * chain. both are in the order of s_comp, reordered or not (the zero cell
+ * then goes through s_comp.reordered_cell).
+ */
+inline std::pair< chain_v, chain_v > known_pair(simplicial_complex& s_comp,
+                                                const mesh_generator& gen) {
+    const int d = gen.dimension();
+    chain_v bounding = s_comp.new_v_chain(d);
+    chain_v cycle = s_comp.new_v_chain(d - 1);
+    cell_t cell(gen.cell_size());
+    for (size_t c = 0; c < gen.num_cells(); ++c) {
+        if (!gen.in_region(c)) continue;
+        gen.cell(c, cell.data());
+        cell = s_comp.reordered_cell(cell);
+        int coef = mesh_gen::orientation(cell.data(), cell.size());
+        size_t index = s_comp.cell_to_index(cell);
+        chain_val(bounding, index) = coef;
+        for (auto face : s_comp.get_bdry_and_ind_index(d, index))
+            chain_val(cycle, face.second) += face.first * coef;
+    }
+    return std::make_pair(cycle, bounding);
+}
+
+// the zero cell of the generator, as a cell of s_comp
+inline cell_t null_cell(const mesh_generator& gen) {
+    cell_t cell(gen.cell_size());
+    gen.cell(gen.zero_cell(), cell.data());
+    return cell;
+}
+
+/**
+ * @brief generator of a kind of mesh with about num_cells top cells
+ *
+ * kinds: grid, perturbed (jittered grid with Delaunay diagonals), sphere,
+ * torus (with two holes) and block
+ */
+inline std::unique_ptr< mesh_generator > make_mesh_generator(
+    const std::string& kind, size_t num_cells, unsigned seed = 1) {
+    typedef std::unique_ptr< mesh_generator > gen_ptr;
+    size_t side =
+        std::max< size_t >(3, std::lround(std::sqrt(num_cells / 2.)));
+    if (kind == "grid") return gen_ptr(new grid_mesh(side, side));
+    if (kind == "perturbed")
+        return gen_ptr(new grid_mesh(side, side, 0.4, true, seed));
+    if (kind == "sphere") return gen_ptr(new sphere_mesh(side, side, 0.2, seed));
+    if (kind == "torus")
+        return gen_ptr(new torus_mesh(std::max< size_t >(8, 2 * side),
+                                      std::max< size_t >(3, side / 2), 2, 0.2,
+                                      seed));
+    if (kind == "block") {
+        size_t cube =
+            std::max< size_t >(3, std::lround(std::cbrt(num_cells / 6.)));
+        return gen_ptr(new block_mesh(cube, cube, cube, 0.2, seed));
+    }
+    throw std::invalid_argument("unknown mesh kind " + kind);
+}
+
+};  // namespace gsimp
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <scomplex/memory.hpp>
+
+/*
+ * lightweight instrumentation: scoped phase timers, counters and histograms
+ *
+ *   GSIMP_PHASE("hasse");                   // times the enclosing scope
+ *   GSIMP_COUNT("coeff_flow.seen_taus", n); // adds n to a counter
+ *   GSIMP_HISTOGRAM("snapping.path", len);  // records a value (log2 buckets)
+ *
+ * the macros only do something when the library is compiled with
+ * GSIMP_METRICS defined (cmake -DGSIMP_ENABLE_METRICS=ON), otherwise they
+ * expand to nothing. names are looked up once per call site; after that a
+ * counter or histogram update is a relaxed atomic add and a phase costs two
+ * clock reads plus one short critical section for its trace event.
+ *
+ * phases also add up the allocations made while they run (by any thread), in
+ * programs that count them with GSIMP_COUNT_ALLOCATIONS (scomplex/memory.hpp).
+ *
+ * the collected data is exported with gsimp::metrics::write_json (totals)
+ * and gsimp::metrics::write_chrome_trace (one event per phase, loadable in
+ * chrome://tracing or perfetto).
+ */
+
+namespace gsimp {
+namespace metrics {
+
+typedef std::chrono::steady_clock metrics_clock;
+
+struct counter {
+    std::atomic<int64_t> value{0};
+    void add(int64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+};
+
+// buckets[b] counts the values v with bit width b (0, 1, 2-3, 4-7, ...)
+struct histogram {
+    static const int num_buckets = 65;
+    std::array<std::atomic<uint64_t>, num_buckets> buckets;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+    histogram() {
+        for (auto& b : buckets) b = 0;
+    }
+
+    void record(uint64_t v) {
+        int width = 0;
+        while (width < 64 && (v >> width) != 0) ++width;
+        buckets[width].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t old = max.load(std::memory_order_relaxed);
+        while (v > old &&
+               !max.compare_exchange_weak(old, v, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+struct phase {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> allocations{0};
+};
+
+struct trace_event {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint32_t thread;
+};
+
+class registry {
+    std::mutex mtx;
+    // node based maps: references handed out stay valid
+    std::map<std::string, std::unique_ptr<counter>> counters;
+    std::map<std::string, std::unique_ptr<histogram>> histograms;
+    std::map<std::string, std::unique_ptr<phase>> phases;
+    std::vector<trace_event> events;
+    std::map<std::thread::id, uint32_t> threads;
+    metrics_clock::time_point origin{metrics_clock::now()};
+
+    template <typename T>
+    T& lookup(std::map<std::string, std::unique_ptr<T>>& table,
+              const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto& slot = table[name];
+        if (!slot) slot.reset(new T());
+        return *slot;
+    }
+
+   public:
+    // events kept for the trace, later ones are only added to the totals
+    size_t max_events = 1 << 20;
+
+    static registry& get() {
+        static registry instance;
+        return instance;
+    }
+
+    counter& get_counter(const std::string& name) {
+        return lookup(counters, name);
+    }
+    histogram& get_histogram(const std::string& name) {
+        return lookup(histograms, name);
+    }
+    phase& get_phase(const std::string& name) { return lookup(phases, name); }
+
+    uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   metrics_clock::now() - origin)
+            .count();
+    }
+
+    void add_event(const char* name, uint64_t start_ns, uint64_t duration_ns) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (events.size() >= max_events) return;
+        auto id = threads.emplace(std::this_thread::get_id(), threads.size());
+        events.push_back({name, start_ns, duration_ns, id.first->second});
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& c : counters) c.second->value = 0;
+        for (auto& h : histograms) {
+            for (auto& b : h.second->buckets) b = 0;
+            h.second->count = h.second->sum = h.second->max = 0;
+        }
+        for (auto& p : phases)
+            p.second->calls = p.second->total_ns = p.second->max_ns =
+                p.second->allocations = 0;
+        events.clear();
+    }
+
+    void write_json(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        out << "{\n  \"phases\": {";
+        const char* sep = "\n";
+        for (auto& p : phases) {
+            out << sep << "    \"" << p.first
+                << "\": {\"calls\": " << p.second->calls
+                << ", \"total_s\": " << p.second->total_ns * 1e-9
+                << ", \"max_s\": " << p.second->max_ns * 1e-9
+                << ", \"allocations\": " << p.second->allocations << "}";
+            sep = ",\n";
+        }
+        out << "\n  },\n  \"counters\": {";
+        sep = "\n";
+        for (auto& c : counters) {
+            out << sep << "    \"" << c.first << "\": " << c.second->value;
+            sep = ",\n";
+        }
+        out << "\n  },\n  \"histograms\": {";
+        sep = "\n";
+        for (auto& h : histograms) {
+            out << sep << "    \"" << h.first
+                << "\": {\"count\": " << h.second->count
+                << ", \"sum\": " << h.second->sum
+                << ", \"max\": " << h.second->max << ", \"log2_buckets\": [";
+            // trailing empty buckets are left out
+            int last = histogram::num_buckets - 1;
+            while (last > 0 && h.second->buckets[last] == 0) --last;
+            for (int b = 0; b <= last; ++b)
+                out << (b ? ", " : "") << h.second->buckets[b];
+            out << "]}";
+            sep = ",\n";
+        }
+        out << "\n  }\n}\n";
+    }
+
+    void write_chrome_trace(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        out << "{\"traceEvents\": [";
+        const char* sep = "\n";
+        for (auto& e : events) {
+            out << sep << "{\"name\": \"" << e.name
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+                << ", \"ts\": " << e.start_ns / 1000.0
+                << ", \"dur\": " << e.duration_ns / 1000.0 << "}";
+            sep = ",\n";
+        }
+        // counters as a final sample
+        double end_us = now_ns() / 1000.0;
+        for (auto& c : counters) {
+            out << sep << "{\"name\": \"" << c.first
+                << "\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << end_us
+                << ", \"args\": {\"value\": " << c.second->value << "}}";
+            sep = ",\n";
+        }
+        out << "\n]}\n";
+    }
+};
+
+// times its scope into a phase (and a trace event)
+class scoped_phase {
+    const char* name;
+    phase& stats;
+    memory::allocation_scope allocs;
+    uint64_t start;
+
+   public:
+    scoped_phase(const char* _name, phase& _stats)
+        : name(_name), stats(_stats), start(registry::get().now_ns()) {}
+
+    ~scoped_phase() {
+        registry& reg = registry::get();
+        uint64_t duration = reg.now_ns() - start;
+        stats.calls.fetch_add(1, std::memory_order_relaxed);
+        stats.total_ns.fetch_add(duration, std::memory_order_relaxed);
+        stats.allocations.fetch_add(allocs.delta().allocations,
+                                    std::memory_order_relaxed);
+        uint64_t old = stats.max_ns.load(std::memory_order_relaxed);
+        while (duration > old &&
+               !stats.max_ns.compare_exchange_weak(old, duration,
+                                                   std::memory_order_relaxed)) {
+        }
+        reg.add_event(name, start, duration);
+    }
+};
+
+inline bool enabled() {
+#ifdef GSIMP_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline void write_json(std::ostream& out) { registry::get().write_json(out); }
+inline void write_chrome_trace(std::ostream& out) {
+    registry::get().write_chrome_trace(out);
+}
+inline void reset() { registry::get().reset(); }
+
+};  // namespace metrics
+};  // namespace gsimp
+
+#define GSIMP_METRICS_CAT2(a, b) a##b
+#define GSIMP_METRICS_CAT(a, b) GSIMP_METRICS_CAT2(a, b)
+
+#ifdef GSIMP_METRICS
+
+#define GSIMP_PHASE(name)                                                   \
+    static gsimp::metrics::phase& GSIMP_METRICS_CAT(gsimp_phase_, __LINE__) = \
+        gsimp::metrics::registry::get().get_phase(name);                    \
+    gsimp::metrics::scoped_phase GSIMP_METRICS_CAT(gsimp_scope_, __LINE__)( \
+        name, GSIMP_METRICS_CAT(gsimp_phase_, __LINE__))
+
+#define GSIMP_COUNT(name, n)                                           \
+    do {                                                               \
+        static gsimp::metrics::counter& gsimp_counter =                \
+            gsimp::metrics::registry::get().get_counter(name);         \
+        gsimp_counter.add(n);                                          \
+    } while (0)
+
+#define GSIMP_HISTOGRAM(name, v)                                       \
+    do {                                                               \
+        static gsimp::metrics::histogram& gsimp_histogram =            \
+            gsimp::metrics::registry::get().get_histogram(name);       \
+        gsimp_histogram.record(v);                                     \
+    } while (0)
+
+#else
+
+#define GSIMP_PHASE(name) \
+    do {                  \
+    } while (0)
+#define GSIMP_COUNT(name, n) \
+    do {                     \
+    } while (0)
+#define GSIMP_HISTOGRAM(name, v) \
+    do {                         \
+    } while (0)
+
+#endif
@@ -3,9 +3,12 @@
 #include <Eigen/Sparse>
 
 #include "scomplex/graph_utils.hpp"
+#include "scomplex/memory.hpp"
+#include "scomplex/metrics.hpp"
 #include "scomplex/path_snapper.hpp"
 #include "scomplex/simplicial_complex.hpp"
 #include "scomplex/types.hpp"
+#include "scomplex/workspace.hpp"
 
 #include "KDTree.hpp"
 
@@ -16,47 +19,212 @@ struct path_snapper::impl {
 
     KDTree point_tree;
     graph_t vertex_graph;  // defined in graph_utils.hpp
+    // index of the vertex of each point (points in no cell have none)
+    std::vector< size_t > vertex_key;
     std::shared_ptr< simplicial_complex > s_comp;
+    // the points past tree_size were added by update, they are searched
+    // one by one until there are enough of them to build the tree again
+    size_t tree_size = 0;
+    std::vector< point_t > new_points;
 
     impl(std::shared_ptr< simplicial_complex > p_sc) {
         s_comp = p_sc;
         auto points = s_comp->get_points();
-        point_tree = KDTree(points);
-        vertex_graph = calculate_one_skelleton_graph(*s_comp);
+        build_search(points);
     };
 
     impl(simplicial_complex& sc) {
         s_comp = std::make_shared< simplicial_complex >(sc);
         auto points = s_comp->get_points();
-        point_tree = KDTree(points);
-        vertex_graph = calculate_one_skelleton_graph(*s_comp);
+        build_search(points);
     }
 
     impl(std::vector< point_t >& pts, std::vector< cell_t >& cells) {
         s_comp = std::make_shared< simplicial_complex >(pts, cells);
-        point_tree = KDTree(pts);
+        build_search(pts);
+    }
+
+    void build_search(std::vector< point_t >& points) {
+        GSIMP_PHASE("snapper");
+        point_tree = KDTree(points);
+        tree_size = points.size();
         vertex_graph = calculate_one_skelleton_graph(*s_comp);
+        const std::vector< uint8_t >& removed = s_comp->tombstones(0);
+        vertex_key.assign(points.size(), no_vertex);
+        for (size_t k = 0; k < (size_t)s_comp->get_level_size(0); ++k)
+            if (removed.empty() || !removed[k])
+                vertex_key[s_comp->index_to_cell(0, k)[0]] = k;
     }
 
+    static double squared_distance(const point_t& a, const point_t& b) {
+        double dist = 0;
+        for (size_t k = 0; k < a.size(); ++k)
+            dist += (a[k] - b[k]) * (a[k] - b[k]);
+        return dist;
+    }
+
+    // the point of a vertex nearest to pt, in the tree and among the points
+    // added since it was built. when the nearest point in the tree lost its
+    // vertex to an update (a tombstone) the tree is searched again in balls
+    // of growing radius.
+    size_t nearest_vertex(const point_t& pt) {
+        size_t best = point_tree.nearest_index(pt);
+        bool live = vertex_key[best] != no_vertex;
+        // without updates this is all (and it does not allocate)
+        if (new_points.empty() && (live || s_comp->num_tombstones(0) == 0))
+            return best;
+        double best_dist = squared_distance(pt, s_comp->get_point(best));
+        double radius = std::max(std::sqrt(best_dist), 1e-12);
+        for (size_t found = 0; !live && s_comp->num_tombstones(0) > 0 &&
+                               found < tree_size;
+             radius *= 2) {
+            std::vector< size_t > near =
+                point_tree.neighborhood_indices(pt, radius);
+            found = near.size();
+            for (size_t i : near) {
+                double dist = squared_distance(pt, s_comp->get_point(i));
+                if (vertex_key[i] != no_vertex && (!live || dist < best_dist)) {
+                    best = i;
+                    best_dist = dist;
+                    live = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < new_points.size(); ++i) {
+            double dist = squared_distance(pt, new_points[i]);
+            if (vertex_key[tree_size + i] != no_vertex &&
+                (!live || dist < best_dist)) {
+                best = tree_size + i;
+                best_dist = dist;
+                live = true;
+            }
+        }
+        return best;
+    }
+
+    // the vertex graph and keys after simplicial_complex::update_cells
+    void update(const simplicial_complex::update_report& report) {
+        GSIMP_PHASE("snapper_update");
+        // new points only matter once they are vertices
+        size_t num_points = vertex_key.size();
+        for (size_t k : report.added.at(0))
+            num_points =
+                std::max(num_points, s_comp->index_to_cell(0, k)[0] + 1);
+        for (size_t v = tree_size + new_points.size(); v < num_points; ++v)
+            new_points.push_back(s_comp->get_point(v));
+        if (new_points.size() > std::max< size_t >(64, tree_size / 16)) {
+            std::vector< point_t > points = s_comp->get_points();
+            point_tree = KDTree(points);
+            tree_size = points.size();
+            new_points.clear();
+        }
+        vertex_key.resize(std::max(num_points, tree_size), no_vertex);
+        while (num_vertices(vertex_graph) < vertex_key.size())
+            add_vertex(vertex_graph);
+
+        for (size_t e : report.removed.at(1)) {
+            cell_t edge = s_comp->index_to_cell(1, e);
+            remove_edge(edge[0], edge[1], vertex_graph);
+        }
+        for (size_t e : report.added.at(1)) {
+            cell_t edge = s_comp->index_to_cell(1, e);
+            add_edge(edge[0], edge[1], edge_length(*s_comp, edge[0], edge[1]),
+                     vertex_graph);
+        }
+        for (size_t k : report.removed.at(0))
+            vertex_key[s_comp->index_to_cell(0, k)[0]] = no_vertex;
+        for (size_t k : report.added.at(0))
+            vertex_key[s_comp->index_to_cell(0, k)[0]] = k;
+    }
+
+    // the vertex keys after simplicial_complex::compact
+    void remap(const std::vector< std::vector< size_t > >& remap) {
+        for (size_t& k : vertex_key)
+            if (k != no_vertex) k = remap.at(0)[k];
+    }
+
+    static constexpr size_t no_vertex = size_t(-1);
+
     ~impl(){};
 
+    memory_report get_memory_report() {
+        memory_report report;
+        // the KD-tree keeps one node per point: a copy of its coordinates,
+        // its index and two child pointers, allocated by make_shared
+        size_t num_points = s_comp->get_level_size(0);
+        size_t dim = num_points ? s_comp->get_point(0).size() : 0;
+        report.add("kd_tree",
+                   num_points * (sizeof(point_t) + dim * sizeof(double) +
+                                 sizeof(size_t) +
+                                 2 * sizeof(std::shared_ptr< void >) +
+                                 2 * sizeof(long)));
+        // vertices with their out edge lists, edges in a std::list with
+        // one out edge entry at each end
+        typedef std::pair< size_t, graph_t::EdgeContainer::iterator >
+            out_edge_entry;
+        report.add("vertex_graph",
+                   num_vertices(vertex_graph) * sizeof(graph_t::stored_vertex) +
+                       num_edges(vertex_graph) *
+                           (sizeof(graph_t::EdgeContainer::value_type) +
+                            2 * sizeof(void*) + 2 * sizeof(out_edge_entry)));
+        report.add("vertex_keys", memory::vector_bytes(vertex_key));
+        if (!new_points.empty())
+            report.add("new_points", memory::points_bytes(new_points));
+        return report;
+    }
+
+    // way points joined by shortest paths, into out
+    void snap_path(const std::vector< point_t >& path,
+                   std::vector< size_t >& out, workspace& ws) {
+        GSIMP_PHASE("snapping");
+        ws.waypoints.clear();
+        for (const point_t& pt : path)
+            ws.waypoints.push_back(nearest_vertex(pt));
+        complete_path(vertex_graph, ws.waypoints, out, ws);
+        GSIMP_COUNT("snapping.waypoints", ws.waypoints.size());
+        GSIMP_HISTOGRAM("snapping.path_length", out.size());
+    }
+
     std::vector< size_t > snap_path(std::vector< point_t > path) {
-        std::vector< size_t > way_points;
-        for (point_t pt : path) {
-            size_t pti = point_tree.nearest_index(pt);
-            way_points.push_back(pti);
+        std::vector< size_t > snapped_path;
+        snap_path(path, snapped_path, thread_workspace());
+        return snapped_path;
+    }
+
+    // index of the edge between the points a and b, found among the
+    // cofaces of the vertex of a
+    size_t edge_index(size_t a, size_t b) {
+        auto cofaces = s_comp->cofaces_view(0);
+        auto faces = s_comp->faces_view(1);
+        size_t ka = a < vertex_key.size() ? vertex_key[a] : no_vertex;
+        size_t kb = b < vertex_key.size() ? vertex_key[b] : no_vertex;
+        if (ka != no_vertex && kb != no_vertex) {
+            for (size_t k = cofaces.begin(ka); k < cofaces.end(ka); ++k) {
+                size_t edge = cofaces.cells[k];
+                size_t first = faces.begin(edge);
+                if (faces.cells[first] == kb || faces.cells[first + 1] == kb)
+                    return edge;
+            }
         }
+        throw std::runtime_error("no edge between the vertices " +
+                                 std::to_string(a) + " and " +
+                                 std::to_string(b) + "\n");
+    }
 
-        // std::cout << "processed path: \n";
-        // for (size_t i = 0 ; i < way_points.size() ; ++i ) {
-        //     for (auto c : path[i] ) std::cout << c << " ";
-        //     auto pt = s_comp->get_point( way_points[i] );
-        //     std::cout << " -> ";
-        //     for (auto c : pt ) std::cout << c << " ";
-        //     std::cout << "\n";
-        // }
-        auto snapped_path = complete_path(vertex_graph, way_points);
-        return snapped_path;
+    void route_leg(size_t src, size_t trg, std::vector< size_t >& leg) {
+        leg.clear();
+        shortest_path(vertex_graph, src, trg, thread_workspace(), leg);
+    }
+
+    // adds coef times the 1-chain of the leg from src to delta
+    void add_leg(size_t src, const std::vector< size_t >& leg, double coef,
+                 chain_t& delta) {
+        for (size_t trg : leg) {
+            if (src != trg)
+                chain_val(delta, edge_index(src, trg)) +=
+                    src < trg ? coef : -coef;
+            src = trg;
+        }
     }
 
     std::vector< std::pair< cell_t, int > > index_pairs(
@@ -109,7 +277,7 @@ std::vector< point_t > path_snapper::snap_path_to_points(
     auto index_path = p_impl->snap_path(path);
     std::vector< point_t > point_path;
     for (size_t p : index_path)
-        point_path.push_back(p_impl->s_comp->get_points().at(p));
+        point_path.push_back(p_impl->s_comp->get_point(p));
     return point_path;
 }
 
@@ -147,7 +315,7 @@ std::vector< point_t > path_snapper::index_sequence_to_point(
     std::vector< size_t > ind_path) {
     std::vector< point_t > pt_path;
     for (size_t ind : ind_path)
-        pt_path.push_back(p_impl->s_comp->get_points().at(ind));
+        pt_path.push_back(p_impl->s_comp->get_point(ind));
     return pt_path;
 }
 
@@ -155,7 +323,7 @@ std::vector< size_t > path_snapper::point_sequence_to_index(
     std::vector< point_t > pt_path) {
     std::vector< size_t > ind_path;
     for (point_t pt : pt_path) {
-        ind_path.push_back(p_impl->point_tree.nearest_index(pt));
+        ind_path.push_back(p_impl->nearest_vertex(pt));
     }
     return ind_path;
 }
@@ -181,10 +349,106 @@ chain_t path_snapper::index_sequence_to_chain(std::vector< size_t > ind_path) {
     return chain;
 }
 
+void path_snapper::snap_path_to_indices(const std::vector< point_t >& path,
+                                        std::vector< size_t >& out) {
+    p_impl->snap_path(path, out, thread_workspace());
+}
+
+void path_snapper::index_sequence_to_v_chain(
+    const std::vector< size_t >& ind_path, chain_v& out) {
+    out.first = 1;
+    out.second.assign(p_impl->s_comp->get_level_size(1), 0);
+    for (size_t i = 0; i + 1 < ind_path.size(); ++i) {
+        size_t src = ind_path[i], trg = ind_path[i + 1];
+        if (src == trg) continue;
+        out.second[p_impl->edge_index(src, trg)] += src < trg ? 1 : -1;
+    }
+}
+
 chain_t path_snapper::point_sequence_to_chain(std::vector< point_t > pt_path) {
     return index_sequence_to_chain(point_sequence_to_index(pt_path));
 }
 
+void path_snapper::snapped_path::indices(std::vector< size_t >& out) const {
+    out.clear();
+    if (vertices.empty()) return;
+    out.push_back(vertices.front());
+    for (auto& leg : legs) out.insert(out.end(), leg.begin(), leg.end());
+}
+
+void path_snapper::snap_path_legs(const std::vector< point_t >& path,
+                                  snapped_path& out) {
+    GSIMP_PHASE("snapping");
+    out.waypoints = path;
+    out.vertices.resize(path.size());
+    for (size_t i = 0; i < path.size(); ++i)
+        out.vertices[i] = p_impl->nearest_vertex(path[i]);
+    out.legs.resize(path.empty() ? 0 : path.size() - 1);
+    for (size_t i = 0; i < out.legs.size(); ++i)
+        p_impl->route_leg(out.vertices[i], out.vertices[i + 1], out.legs[i]);
+}
+
+void path_snapper::resnap_path_legs(const std::vector< point_t >& path,
+                                    snapped_path& io, chain_t& delta) {
+    GSIMP_PHASE("resnapping");
+    snapped_path old;
+    std::swap(old, io);
+    size_t n_old = old.waypoints.size(), n_new = path.size();
+
+    // way points unchanged at the start and at the end of the path
+    size_t pre = 0, suf = 0;
+    while (pre < std::min(n_old, n_new) && old.waypoints[pre] == path[pre])
+        ++pre;
+    while (pre + suf < std::min(n_old, n_new) &&
+           old.waypoints[n_old - 1 - suf] == path[n_new - 1 - suf])
+        ++suf;
+    // the old way point a new one stands for, if any
+    const size_t none = size_t(-1);
+    auto old_of = [&](size_t i) {
+        if (i < pre) return i;
+        if (i + suf >= n_new) return i + n_old - n_new;
+        return n_old == n_new ? i : none;
+    };
+
+    io.waypoints = path;
+    io.vertices.resize(n_new);
+    for (size_t i = 0; i < n_new; ++i) {
+        bool kept = i < pre || i + suf >= n_new;
+        io.vertices[i] = kept ? old.vertices[old_of(i)]
+                              : p_impl->nearest_vertex(path[i]);
+    }
+
+    std::vector< bool > reused(old.legs.size(), false);
+    io.legs.resize(n_new ? n_new - 1 : 0);
+    for (size_t i = 0; i + 1 < n_new; ++i) {
+        size_t j = old_of(i);
+        if (j != none && j + 1 == old_of(i + 1) &&
+            old.vertices[j] == io.vertices[i] &&
+            old.vertices[j + 1] == io.vertices[i + 1]) {
+            io.legs[i].swap(old.legs[j]);
+            reused[j] = true;
+            continue;
+        }
+        p_impl->route_leg(io.vertices[i], io.vertices[i + 1], io.legs[i]);
+        p_impl->add_leg(io.vertices[i], io.legs[i], 1, delta);
+    }
+    for (size_t j = 0; j < old.legs.size(); ++j)
+        if (!reused[j])
+            p_impl->add_leg(old.vertices[j], old.legs[j], -1, delta);
+}
+
+void path_snapper::update(const simplicial_complex::update_report& report) {
+    p_impl->update(report);
+}
+
+void path_snapper::remap(const std::vector< std::vector< size_t > >& remap) {
+    p_impl->remap(remap);
+}
+
+memory_report path_snapper::get_memory_report() {
+    return p_impl->get_memory_report();
+}
+
 std::shared_ptr< simplicial_complex > path_snapper::get_underlying_complex() {
     return p_impl->s_comp;
 }
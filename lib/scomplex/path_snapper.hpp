@@ -29,7 +29,40 @@ class path_snapper {
     chain_t index_sequence_to_chain(std::vector< size_t >);
     chain_v index_sequence_to_v_chain(std::vector< size_t >);
     chain_t point_sequence_to_chain(std::vector< point_t >);
+    // the same into reused outputs, without allocating once they (and the
+    // thread's workspace) are large enough. the chain is built from the
+    // incidence arrays of the complex (its Hasse diagram).
+    void snap_path_to_indices(const std::vector< point_t >&,
+                              std::vector< size_t >&);
+    void index_sequence_to_v_chain(const std::vector< size_t >&, chain_v&);
+    // a path snapped leg by leg (a leg is the shortest path between the
+    // vertices of two consecutive way points, without its first vertex), so
+    // that an edit only re-routes the legs whose ends moved
+    struct snapped_path {
+        std::vector< point_t > waypoints;
+        std::vector< size_t > vertices;  // nearest vertex of each way point
+        std::vector< std::vector< size_t > > legs;
+        // the whole vertex sequence
+        void indices(std::vector< size_t >&) const;
+    };
+    void snap_path_legs(const std::vector< point_t >&, snapped_path&);
+    // snaps the edited way points, re-using the legs whose ends are the same
+    // vertices as before (matched through the way points that did not
+    // change at both ends of the path), and adds the change of the 1-chain
+    // of the path to the last argument
+    void resnap_path_legs(const std::vector< point_t >&, snapped_path&,
+                          chain_t&);
+    // keeps up with simplicial_complex::update_cells on the underlying
+    // complex (given its report): the edges and vertices of the changed
+    // cells, and the new points, searched one by one until there are enough
+    // of them to build the search tree again. way points snap to the
+    // nearest point that is still a vertex. needs exclusive access.
+    void update(const simplicial_complex::update_report&);
+    // the same after simplicial_complex::compact, given what it returned
+    void remap(const std::vector< std::vector< size_t > >&);
     std::shared_ptr< simplicial_complex > get_underlying_complex();
+    // search structures only, the (shared) complex reports its own
+    memory_report get_memory_report();
 };  // class path_snapper
 
 };  // namespace gsimp
@@ -3,6 +3,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <type_traits>
+
 using std::vector;
 using std::to_string;
 
@@ -113,3 +120,163 @@ void make_ply(std::ofstream& outfile,               //
         outfile << "\n";
     }
 }
+
+//
+// binary little endian writer
+//
+
+/**
+ * @brief output buffer for binary ply files, values are stored little endian
+ * and handed to the stream in large blocks
+ */
+class ply_buffer {
+    std::ostream& out;
+    std::vector<char> buffer;
+    size_t used{0};
+
+   public:
+    static constexpr size_t block_size = 1 << 20;
+
+    explicit ply_buffer(std::ostream& _out) : out(_out), buffer(block_size) {}
+    ~ply_buffer() { flush(); }
+
+    template <typename T>
+    void put(T val) {
+        static_assert(std::is_arithmetic<T>::value, "numbers only");
+        if (used + sizeof(T) > buffer.size()) flush();
+        char* dst = buffer.data() + used;
+        std::memcpy(dst, &val, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        std::reverse(dst, dst + sizeof(T));
+#endif
+        used += sizeof(T);
+    }
+
+    void put_rgb(const uint8_t* rgb) {
+        put(rgb[0]);
+        put(rgb[1]);
+        put(rgb[2]);
+    }
+
+    void flush() {
+        out.write(buffer.data(), used);
+        used = 0;
+    }
+};
+
+/**
+ * @brief write a triangle mesh as binary little endian ply
+ *
+ * @param coordinates: flat point coordinates, dimension per point (missing
+ *                     coordinates up to 3 are written as 0)
+ * @param faces: flat triangles, 3 vertex indices per face
+ * @param face_color: callable (size_t face, uint8_t* rgb) filling in the
+ *                    color of each face while it is written
+ * @param edges: flat edges, 2 vertex indices per edge, drawn with edge_color
+ *               (their vertices get that color too, the rest are grey)
+ */
+template <typename face_color_fn>
+void make_binary_ply(std::ostream& outfile,                 //
+                     const vector<double>& coordinates,     //
+                     size_t dimension,                      //
+                     const vector<size_t>& faces,           //
+                     face_color_fn face_color,              //
+                     const vector<size_t>& edges = {},      //
+                     const uint8_t edge_color[3] = nullptr  //
+                     ) {
+    const size_t num_points = coordinates.size() / dimension;
+    const size_t num_faces = faces.size() / 3;
+    const size_t num_edges = edges.size() / 2;
+    const uint8_t grey[3] = {150, 150, 150};
+    const uint8_t blue[3] = {0, 0, 255};
+    if (edge_color == nullptr) edge_color = blue;
+
+    // make the header
+    outfile << "ply\n";
+    outfile << "format binary_little_endian 1.0\n";
+    outfile << "comment author: automatically generated by make_binary_ply\n";
+
+    outfile << "element vertex " << num_points << "\n";
+    outfile << "property float x\n";
+    outfile << "property float y\n";
+    outfile << "property float z\n";
+    outfile << "property uchar red\n";
+    outfile << "property uchar green\n";
+    outfile << "property uchar blue\n";
+
+    outfile << "element face " << num_faces << "\n";
+    outfile << "property list uchar int vertex_indices\n";
+    outfile << "property uchar red\n";
+    outfile << "property uchar green\n";
+    outfile << "property uchar blue\n";
+
+    outfile << "element edge " << num_edges << "\n";
+    outfile << "property int vertex1\n";
+    outfile << "property int vertex2\n";
+    outfile << "property uchar red\n";
+    outfile << "property uchar green\n";
+    outfile << "property uchar blue\n";
+
+    outfile << "end_header\n";
+
+    vector<bool> on_edge(num_points, false);
+    for (size_t v : edges) on_edge[v] = true;
+
+    ply_buffer buffer(outfile);
+    // insert point list
+    for (size_t i = 0; i < num_points; ++i) {
+        const double* pt = coordinates.data() + i * dimension;
+        for (size_t c = 0; c < 3; ++c)
+            buffer.put(float(c < dimension ? pt[c] : 0.0));
+        buffer.put_rgb(on_edge[i] ? edge_color : grey);
+    }
+    // insert face list
+    uint8_t rgb[3];
+    for (size_t i = 0; i < num_faces; ++i) {
+        buffer.put(uint8_t(3));
+        for (size_t j = 3 * i; j < 3 * i + 3; ++j)
+            buffer.put(int32_t(faces[j]));
+        face_color(i, rgb);
+        buffer.put_rgb(rgb);
+    }
+    // insert edge list
+    for (size_t i = 0; i < num_edges; ++i) {
+        buffer.put(int32_t(edges[2 * i]));
+        buffer.put(int32_t(edges[2 * i + 1]));
+        buffer.put_rgb(edge_color);
+    }
+    buffer.flush();
+}
+
+// plain mesh, all faces white
+void make_binary_ply(std::ostream& outfile,              //
+                     const vector<double>& coordinates,  //
+                     size_t dimension,                   //
+                     const vector<size_t>& faces         //
+                     ) {
+    make_binary_ply(outfile, coordinates, dimension, faces,
+                    [](size_t, uint8_t* rgb) { rgb[0] = rgb[1] = rgb[2] = 255; });
+}
+
+/**
+ * @brief write a mesh colored by a chain on its faces, faces whose
+ * coefficient (coefficient(i) for face i) exceeds threshold in absolute value
+ * are red, the others white. the colors are computed while writing.
+ */
+template <typename coefficient_fn>
+void make_chain_ply(std::ostream& outfile,              //
+                    const vector<double>& coordinates,  //
+                    size_t dimension,                   //
+                    const vector<size_t>& faces,        //
+                    coefficient_fn coefficient,         //
+                    const vector<size_t>& edges,        //
+                    double threshold = 10e-3            //
+                    ) {
+    make_binary_ply(outfile, coordinates, dimension, faces,
+                    [&](size_t i, uint8_t* rgb) {
+                        bool in_chain = std::abs(coefficient(i)) > threshold;
+                        rgb[0] = 255;
+                        rgb[1] = rgb[2] = in_chain ? 0 : 255;
+                    },
+                    edges);
+}
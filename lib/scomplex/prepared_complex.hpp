@@ -0,0 +1,78 @@
+#pragma once
+
+#include <scomplex/chain_calc.hpp>
+#include <scomplex/path_snapper.hpp>
+#include <scomplex/simplicial_complex.hpp>
+
+#include <future>
+#include <memory>
+
+namespace gsimp {
+
+// derived structures, for prepare_async
+enum {
+    async_hasse = 1,
+    async_matrices = 2,
+    async_snapper = 4,
+    async_solver = 8,
+    async_all = 15
+};
+
+/**
+ * @brief the derived structures of a complex, each one built on its own
+ * thread
+ *
+ * a query only needs to wait (get()) for what it uses: snapping for the
+ * snapper, coeff_flow for the Hasse diagram and the boundary matrices, the
+ * least squares solver for itself. futures of structures that were not
+ * requested are not valid(). exceptions thrown while building come out of
+ * get(). all futures are shared, any number of threads can wait on them.
+ */
+struct prepared_complex {
+    std::shared_ptr<simplicial_complex> s_comp;
+    std::shared_future<void> hasse;
+    std::shared_future<void> matrices;
+    std::shared_future<std::shared_ptr<path_snapper>> snapper;
+    std::shared_future<std::shared_ptr<bounding_chain>> solver;
+
+    // until everything requested is built
+    void wait() const {
+        if (hasse.valid()) hasse.get();
+        if (matrices.valid()) matrices.get();
+        if (snapper.valid()) snapper.get();
+        if (solver.valid()) solver.get();
+    }
+};
+
+/*
+ * starts building the requested structures and returns right away. they
+ * only read the simplex tree, the Hasse diagram and the matrices are built
+ * exactly once even if a query asks for them before their future is ready
+ * (the query then waits for the same construction).
+ */
+inline prepared_complex prepare_async(std::shared_ptr<simplicial_complex> sc,
+                                      int structures = async_all) {
+    prepared_complex prepared;
+    prepared.s_comp = sc;
+    if (structures & async_hasse)
+        prepared.hasse = std::async(std::launch::async, [sc] {
+                             sc->prepare(simplicial_complex::prepare_hasse);
+                         }).share();
+    if (structures & async_matrices)
+        prepared.matrices =
+            std::async(std::launch::async, [sc] {
+                sc->prepare(simplicial_complex::prepare_matrices);
+            }).share();
+    if (structures & async_snapper)
+        prepared.snapper = std::async(std::launch::async, [sc] {
+                               return std::make_shared<path_snapper>(sc);
+                           }).share();
+    // copies the boundary matrices, so it waits for them in call_once
+    if (structures & async_solver)
+        prepared.solver = std::async(std::launch::async, [sc] {
+                              return std::make_shared<bounding_chain>(sc);
+                          }).share();
+    return prepared;
+}
+
+};  // namespace gsimp
@@ -11,6 +11,15 @@
 #include <vector>
 #include <tuple>
 
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/wait.h>
+
 typedef std::vector<double> point_t;
 typedef std::vector<size_t> cell_t;
 
@@ -32,55 +41,287 @@ void cout_iterator(Iterator first, Iterator last) {
     std::cout << '\n';
 }
 
-std::pair<std::vector<point_t>, std::vector<cell_t>> parse_qhull_file(
-    std::string filename) {
-    std::ifstream file_stream(filename);
-    if (!file_stream.is_open()) {
-        throw std::runtime_error("failed to open \"" + filename + "\"\n");
+/**
+ * @brief mesh read from qhull output, stored in flat arrays
+ *
+ * point i has coordinates coordinates[i * dimension .. (i + 1) * dimension)
+ * cell j has vertices cells[j * cell_size .. (j + 1) * cell_size)
+ */
+struct qhull_mesh {
+    size_t dimension{0};
+    size_t cell_size{0};
+    std::vector<double> coordinates;
+    std::vector<size_t> cells;
+
+    size_t num_points() const {
+        return dimension == 0 ? 0 : coordinates.size() / dimension;
     }
+    size_t num_cells() const {
+        return cell_size == 0 ? 0 : cells.size() / cell_size;
+    }
+};
+
+/**
+ * @brief buffered, line aware tokenizer for (rbox +) qhull output
+ *
+ * reads the stream in large blocks and parses numbers in place with
+ * std::from_chars, no per-line strings or streams are created.
+ */
+class qhull_reader {
+    std::FILE* stream;
+    std::vector<char> buffer;
+    size_t pos{0};
+    size_t end{0};
+    bool at_eof{false};
 
-    std::string line;
+    static bool is_blank(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
 
-    int dimensionality, total_points{0}, total_cells{0};
+    // read more data, keeping the unparsed part [pos, end)
+    bool refill() {
+        if (at_eof) return false;
+        if (pos > 0) {
+            std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+            end -= pos;
+            pos = 0;
+        }
+        if (end == buffer.size()) buffer.resize(2 * buffer.size());
+        size_t n = std::fread(buffer.data() + end, 1, buffer.size() - end,
+                              stream);
+        if (n == 0) at_eof = true;
+        end += n;
+        return n > 0;
+    }
 
-    std::vector<point_t> points;
-    std::vector<cell_t> cells;
+    // skip blanks on the current line, false if the line (or input) ended
+    bool skip_blanks() {
+        for (;;) {
+            while (pos < end && is_blank(buffer[pos])) ++pos;
+            if (pos < end) return buffer[pos] != '\n';
+            if (!refill()) return false;
+        }
+    }
 
-    for (int line_number = 0; line_number < total_cells + total_points + 3;
-         ++line_number) {
-        std::getline(file_stream, line);
-        // case of the first line of the file (get dimensions)
-        if (line_number == 0) {
-            auto tokens = tokenize<size_t>(line);
-            dimensionality = tokens.at(0);
+    // make sure the token starting at pos is entirely in the buffer
+    size_t token_end() {
+        size_t scan = pos;
+        for (;;) {
+            while (scan < end && !is_blank(buffer[scan]) &&
+                   buffer[scan] != '\n')
+                ++scan;
+            if (scan < end || at_eof) return scan;
+            size_t offset = scan - pos;
+            refill();
+            scan = pos + offset;
         }
-        // second line of the file (get number of points)
-        if (line_number == 1) {
-            auto tokens = tokenize<size_t>(line);
-            total_points = tokens.at(0);
+    }
+
+    // the whole token has to be the number ("1.5abc" is not)
+    static void parse(const char* first, const char* last, size_t& val,
+                      std::errc& ec) {
+        auto res = std::from_chars(first, last, val);
+        ec = res.ec;
+        if (ec == std::errc() && res.ptr != last)
+            ec = std::errc::invalid_argument;
+    }
+
+    static void parse(const char* first, const char* last, double& val,
+                      std::errc& ec) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        auto res = std::from_chars(first, last, val);
+        ec = res.ec;
+        if (ec == std::errc() && res.ptr != last)
+            ec = std::errc::invalid_argument;
+#else
+        // no floating point from_chars in this standard library
+        char token[64];
+        if (size_t(last - first) >= sizeof(token)) {
+            ec = std::errc::invalid_argument;
+            return;
         }
-        // lines pertaining to points
-        if (line_number > 1 && line_number < total_points + 2) {
-            auto point = tokenize<double>(line);
-            while (dimensionality < point.size()) {
-                // in case qhull decides te hove put an extra coordinate for
-                // whatever reason it decides to do that from time to time
-                point.pop_back();
+        size_t len = last - first;
+        std::memcpy(token, first, len);
+        token[len] = '\0';
+        char* stop;
+        val = std::strtod(token, &stop);
+        ec = (len > 0 && stop == token + len) ? std::errc()
+                                              : std::errc::invalid_argument;
+#endif
+    }
+
+   public:
+    static constexpr size_t block_size = 1 << 20;
+
+    explicit qhull_reader(std::FILE* _stream)
+        : stream(_stream), buffer(block_size) {}
+
+    /**
+     * @brief parse the next number on the current line
+     *
+     * @returns false when the current line has no more numbers, the
+     * newline itself is not consumed (see next_line). throws
+     * std::runtime_error on a token that is not a number.
+     */
+    template <typename data_t>
+    bool next_value(data_t& val) {
+        if (!skip_blanks()) return false;
+        size_t last = token_end();
+        std::errc ec;
+        parse(buffer.data() + pos, buffer.data() + last, val, ec);
+        if (ec != std::errc())
+            throw std::runtime_error(
+                "malformed qhull output: \"" +
+                std::string(buffer.data() + pos, buffer.data() + last) +
+                "\" is not a number\n");
+        pos = last;
+        return true;
+    }
+
+    // discard whatever is left on the current line
+    bool next_line() {
+        for (;;) {
+            const char* nl = static_cast<const char*>(
+                std::memchr(buffer.data() + pos, '\n', end - pos));
+            if (nl != nullptr) {
+                pos = nl - buffer.data() + 1;
+                return true;
             }
-            points.push_back(point);
+            pos = end;
+            if (!refill()) return false;
+        }
+    }
+
+    // first number on a line, the rest of the line is ignored (rbox comments)
+    template <typename data_t>
+    data_t header_value(const char* what) {
+        data_t val;
+        if (!next_value(val))
+            throw std::runtime_error(std::string("malformed qhull output: ") +
+                                     "expected " + what + "\n");
+        next_line();
+        return val;
+    }
+};
+
+/**
+ * @brief parse rbox points followed by "qhull i" facets into flat arrays
+ *
+ * the format is:
+ *   dimension [comment]
+ *   number of points
+ *   one point per line (extra coordinates are dropped)
+ *   number of cells
+ *   one cell per line, all cells must have the same number of vertices
+ */
+qhull_mesh parse_qhull_stream(std::FILE* stream) {
+    qhull_reader reader(stream);
+    qhull_mesh mesh;
+
+    mesh.dimension = reader.header_value<size_t>("dimension");
+    size_t total_points = reader.header_value<size_t>("number of points");
+
+    mesh.coordinates.resize(total_points * mesh.dimension);
+    double* coord = mesh.coordinates.data();
+    for (size_t p = 0; p < total_points; ++p) {
+        for (size_t i = 0; i < mesh.dimension; ++i) {
+            if (!reader.next_value(*coord++))
+                throw std::runtime_error(
+                    "malformed qhull output: short point " +
+                    std::to_string(p) + "\n");
         }
-        // first line after points (get number of cells)
-        if (line_number == total_points + 2) {
-            auto tokens = tokenize<size_t>(line);
-            total_cells = tokens.at(0);
+        // qhull sometimes puts an extra coordinate, skip it
+        reader.next_line();
+    }
+
+    size_t total_cells = reader.header_value<size_t>("number of cells");
+    size_t vertex;
+    for (size_t c = 0; c < total_cells; ++c) {
+        size_t cell_size = 0;
+        while (reader.next_value(vertex)) {
+            mesh.cells.push_back(vertex);
+            ++cell_size;
         }
-        // lines pertaining to cells
-        if (line_number > total_points + 2 &&
-            line_number < total_points + total_cells + 3) {
-            auto cell = tokenize<size_t>(line);
-            cells.push_back(cell);
+        reader.next_line();
+        if (c == 0) {
+            mesh.cell_size = cell_size;
+            mesh.cells.reserve(total_cells * cell_size);
+        } else if (cell_size != mesh.cell_size) {
+            throw std::runtime_error(
+                "malformed qhull output: cell " + std::to_string(c) +
+                " has " + std::to_string(cell_size) + " vertices, expected " +
+                std::to_string(mesh.cell_size) + "\n");
         }
     }
-    file_stream.close();
+    return mesh;
+}
+
+qhull_mesh parse_qhull_flat(std::string filename) {
+    std::FILE* stream = std::fopen(filename.c_str(), "rb");
+    if (stream == nullptr) {
+        throw std::runtime_error("failed to open \"" + filename + "\"\n");
+    }
+    try {
+        qhull_mesh mesh = parse_qhull_stream(stream);
+        std::fclose(stream);
+        return mesh;
+    } catch (...) {
+        std::fclose(stream);
+        throw;
+    }
+}
+
+/**
+ * @brief run a shell command (e.g. "rbox D2 1000 | qhull d i") and parse its
+ * output directly from the pipe, no intermediate file is written
+ *
+ * throws std::runtime_error when the command does not exit with status 0,
+ * also when its output parsed (it may have been cut short)
+ */
+qhull_mesh parse_qhull_command(std::string command) {
+    std::FILE* pipe = popen(command.c_str(), "r");
+    if (pipe == nullptr) {
+        throw std::runtime_error("failed to run \"" + command + "\"\n");
+    }
+    auto failed = [&](int status) {
+        std::string how = WIFEXITED(status)
+                              ? "exited with status " +
+                                    std::to_string(WEXITSTATUS(status))
+                              : std::string("was killed");
+        return std::runtime_error("\"" + command + "\" " + how + "\n");
+    };
+    qhull_mesh mesh;
+    try {
+        mesh = parse_qhull_stream(pipe);
+    } catch (...) {
+        // a command that failed explains its output better than the parse,
+        // one killed by the pipe closing early does not
+        int status = pclose(pipe);
+        if (status != -1 && WIFEXITED(status) && WEXITSTATUS(status) != 0)
+            throw failed(status);
+        throw;
+    }
+    int status = pclose(pipe);
+    if (status == -1)
+        throw std::runtime_error("failed to run \"" + command + "\"\n");
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) throw failed(status);
+    return mesh;
+}
+
+std::pair<std::vector<point_t>, std::vector<cell_t>> parse_qhull_file(
+    std::string filename) {
+    qhull_mesh mesh = parse_qhull_flat(filename);
+
+    std::vector<point_t> points(mesh.num_points());
+    for (size_t i = 0; i < points.size(); ++i)
+        points[i].assign(
+            mesh.coordinates.begin() + i * mesh.dimension,
+            mesh.coordinates.begin() + (i + 1) * mesh.dimension);
+
+    std::vector<cell_t> cells(mesh.num_cells());
+    for (size_t i = 0; i < cells.size(); ++i)
+        cells[i].assign(mesh.cells.begin() + i * mesh.cell_size,
+                        mesh.cells.begin() + (i + 1) * mesh.cell_size);
+
     return std::make_pair(points, cells);
 }
@@ -1,3 +1,5 @@
+#include <scomplex/memory.hpp>
+#include <scomplex/metrics.hpp>
 #include <scomplex/simplicial_complex.hpp>
 #include <scomplex/types.hpp>
 
@@ -8,84 +10,164 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <memory>  // smart pointers
+#include <mutex>
 #include <tuple>
 
 #include <iostream>
 namespace gsimp {
 
-// hasse diagram structures
-struct hasse_node {
-    std::pair< int, size_t > handle;
-    std::vector< std::shared_ptr< hasse_node > > cofaces;
+// hasse diagram: faces and cofaces of every cell, one flat block per level
+// and direction (no per cell allocations)
+struct hasse_diag {
+    // facets of the cells of level d > 0, d + 1 per cell in increasing index
+    // order, with the signs of their incidences
+    std::vector< std::vector< size_t > > faces;
+    std::vector< std::vector< int8_t > > face_signs;
+    // cofaces of cell i of level d are cofaces[d][coface_offsets[d][i]] up
+    // to (excluding) cofaces[d][coface_offsets[d][i + 1]]
+    std::vector< std::vector< size_t > > coface_offsets;
+    std::vector< std::vector< size_t > > cofaces;
+    std::vector< std::vector< int8_t > > coface_signs;
+    // facets of the top cells with a single coface
+    std::vector< simplicial_complex::boundary_facet > boundary;
+    // once updated (not packed) the cofaces of cell i start at
+    // coface_offsets[d][i] and end at coface_ends[d][i], with room up to
+    // coface_limits[d][i]. a cell that outgrows its room moves to the end.
+    bool packed = true;
+    std::vector< std::vector< size_t > > coface_ends, coface_limits;
 
-    hasse_node(std::pair< int, size_t > _handle) { handle = _handle; }
+    void resize(int dim) {
+        faces.resize(dim + 1);
+        face_signs.resize(dim + 1);
+        coface_offsets.resize(dim + 1);
+        cofaces.resize(dim + 1);
+        coface_signs.resize(dim + 1);
+        coface_ends.resize(dim + 1);
+        coface_limits.resize(dim + 1);
+    }
 
-    void add_coface(std::shared_ptr< hasse_node >& node) {
-        cofaces.push_back(node);
+    // the cofaces of the num_cells cells of level d by counting them among
+    // the facets of level d + 1
+    void pack_cofaces(int d, size_t num_cells) {
+        auto& offsets = coface_offsets[d];
+        offsets.assign(num_cells + 1, 0);
+        if (d + 1 == int(faces.size())) return;
+        const auto& up = faces[d + 1];
+        for (size_t f : up) offsets[f + 1]++;
+        for (size_t i = 1; i < offsets.size(); ++i)
+            offsets[i] += offsets[i - 1];
+        cofaces[d].resize(up.size());
+        coface_signs[d].resize(up.size());
+        std::vector< size_t > next(offsets.begin(), offsets.end() - 1);
+        for (size_t k = 0; k < up.size(); ++k) {
+            size_t pos = next[up[k]]++;
+            cofaces[d][pos] = k / (d + 2);
+            coface_signs[d][pos] = face_signs[d + 1][k];
+        }
     }
-};
 
-struct hasse_diag {
-    std::vector< std::vector< std::shared_ptr< hasse_node > > > cells;
-    std::vector< std::vector< bool > > cells_c;
-
-    hasse_diag(){};
-
-    hasse_diag(simplicial_complex& s_comp) {
-        // vector of dimension d
-        for (int d = 0; d <= s_comp.dimension(); d++) {
-            size_t lv_s = s_comp.get_level_size(d);
-            std::vector< std::shared_ptr< hasse_node > > lv(lv_s);
-            cells.push_back(lv);
-
-            std::vector< bool > c(lv_s, false);
-            cells_c.push_back(c);
-        }
-
-        for (int d = s_comp.dimension(); d > 0; d--) {
-            for (size_t face_i = 0; face_i < s_comp.get_level_size(d);
-                 face_i++) {
-                std::shared_ptr< hasse_node > face_ptr =
-                    get_face(d, face_i, true);
-
-                std::vector< std::pair< int, size_t > > faces =
-                    s_comp.get_bdry_and_ind_index(d, face_i);
-                for (auto b_face_i : faces) {
-                    size_t b_face = std::get< 1 >(b_face_i);
-                    std::shared_ptr< hasse_node > b_face_ptr =
-                        get_face(d - 1, b_face, true);
-                    b_face_ptr->add_coface(face_ptr);
-                }
-            }
+    size_t coface_begin(int d, size_t i) const {
+        return coface_offsets[d][i];
+    }
+    size_t coface_end(int d, size_t i) const {
+        return packed ? coface_offsets[d][i + 1] : coface_ends[d][i];
+    }
+
+    void find_boundary() {
+        boundary.clear();
+        int dim = int(faces.size()) - 1;
+        if (dim < 1) return;
+        for (size_t i = 0; i + 1 < coface_offsets[dim - 1].size(); ++i)
+            add_if_boundary(i);
+    }
+
+    void add_if_boundary(size_t tau) {
+        int d = int(faces.size()) - 2;
+        size_t first = coface_begin(d, tau);
+        if (coface_end(d, tau) - first == 1)
+            boundary.push_back(
+                {tau, cofaces[d][first], coface_signs[d][first]});
+    }
+
+    // every cell its own room, for update_cells
+    void unpack() {
+        if (!packed) return;
+        for (size_t d = 0; d < coface_offsets.size(); ++d) {
+            coface_ends[d].assign(coface_offsets[d].begin() + 1,
+                                  coface_offsets[d].end());
+            coface_limits[d] = coface_ends[d];
         }
-        // no further need, free up the space
-        cells_c.clear();
+        packed = false;
     }
 
-    std::shared_ptr< hasse_node > get_face(int d, size_t face_i,
-                                           bool building = false) {
-        std::shared_ptr< hasse_node > face;
-        if (building && cells_c[d][face_i])
-            face = cells[d][face_i];
-        else {
-            if (building) cells_c[d][face_i] = true;
+    // room for the cofaces of one more cell of level d
+    void new_slot(int d) {
+        size_t start = cofaces[d].size();
+        coface_offsets[d].back() = start;
+        coface_offsets[d].push_back(start);
+        coface_ends[d].push_back(start);
+        coface_limits[d].push_back(start);
+    }
 
-            cells[d][face_i] = std::make_shared< hasse_node >(
-                std::pair< int, size_t >(d, face_i));
-            face = cells[d][face_i];
+    // sigma (with its sign) among the cofaces of cell i of level d, in
+    // increasing index order
+    void add_coface(int d, size_t i, size_t sigma, int8_t sign) {
+        auto& cells = cofaces[d];
+        auto& signs = coface_signs[d];
+        size_t begin = coface_offsets[d][i], end = coface_ends[d][i];
+        if (end == coface_limits[d][i]) {
+            size_t n = end - begin, start = cells.size();
+            size_t room = std::max< size_t >(2, 2 * n);
+            cells.resize(start + room);
+            signs.resize(start + room);
+            std::copy(cells.begin() + begin, cells.begin() + end,
+                      cells.begin() + start);
+            std::copy(signs.begin() + begin, signs.begin() + end,
+                      signs.begin() + start);
+            begin = coface_offsets[d][i] = start;
+            end = start + n;
+            coface_limits[d][i] = start + room;
         }
-        return face;
+        size_t k = end;
+        for (; k > begin && cells[k - 1] > sigma; --k) {
+            cells[k] = cells[k - 1];
+            signs[k] = signs[k - 1];
+        }
+        cells[k] = sigma;
+        signs[k] = sign;
+        coface_ends[d][i] = end + 1;
     }
 
-    std::vector< size_t > get_coface_i(int d, size_t face_i) {
-        auto node = cells[d][face_i];
-        std::vector< size_t > cofaces;
-        for (auto v : node->cofaces)
-            cofaces.push_back(std::get< 1 >(v->handle));
-        return cofaces;
+    // takes sigma out of the cofaces of cell i, the number left
+    size_t remove_coface(int d, size_t i, size_t sigma) {
+        auto& cells = cofaces[d];
+        auto& signs = coface_signs[d];
+        size_t begin = coface_offsets[d][i], end = coface_ends[d][i];
+        size_t k = std::find(cells.begin() + begin, cells.begin() + end,
+                             sigma) -
+                   cells.begin();
+        for (; k + 1 < end; ++k) {
+            cells[k] = cells[k + 1];
+            signs[k] = signs[k + 1];
+        }
+        coface_ends[d][i] = end - 1;
+        return end - 1 - begin;
+    }
+
+    size_t level_bytes(int d) const {
+        return memory::vector_bytes(faces[d]) +
+               memory::vector_bytes(face_signs[d]) +
+               memory::vector_bytes(coface_offsets[d]) +
+               memory::vector_bytes(cofaces[d]) +
+               memory::vector_bytes(coface_signs[d]) +
+               memory::vector_bytes(coface_ends[d]) +
+               memory::vector_bytes(coface_limits[d]);
     }
 };
 
@@ -97,8 +179,8 @@ struct simplicial_complex::impl {
 
     typedef Gudhi::Simplex_tree< SimpleOptions > simp_tree;
     typedef Gudhi::Simplex_tree< SimpleOptions >::Simplex_handle simp_handle;
-    typedef std::vector< simp_handle* > level_t;
-    typedef std::vector< std::unique_ptr< level_t > > levels_t;
+    typedef std::vector< simp_handle > level_t;
+    typedef std::vector< level_t > levels_t;
 
     // member variables
     std::vector< point_t > points;
@@ -106,41 +188,254 @@ struct simplicial_complex::impl {
     std::vector< matrix_t > boundary_matrices;
     levels_t levels;
 
-    bool has_hasse;
+    // the derived structures are built at most once, by the first caller
+    // (concurrent callers wait for it)
+    std::once_flag hasse_built;
+    std::once_flag matrices_built;
     hasse_diag incidence;
 
-    impl(std::vector< point_t >& arg_points, std::vector< cell_t >& arg_tris)
+    // reordering (empty without): point index of each vertex label and
+    // back, per level the index and the orientation (relative to the
+    // complex built without reordering) of each cell, and back
+    std::vector< size_t > original_label, reordered_label;
+    std::vector< std::vector< size_t > > original_key, reordered_key;
+    std::vector< std::vector< int8_t > > original_sign;
+
+    // tombstones left by update_cells, per level (empty while it has
+    // none), and their number
+    std::vector< std::vector< uint8_t > > removed;
+    std::vector< size_t > num_removed;
+    bool matrices_ready = false;
+
+    impl(std::vector< point_t >& arg_points, std::vector< cell_t >& arg_tris,
+         int reordering = 0)
         : points(arg_points) {
-        // create the simplex tree
-        for (auto tri : arg_tris) {
+        GSIMP_PHASE("construction");
+        if ((reordering & reorder_vertices) && !points.empty()) {
+            relabel_vertices();
+            std::vector< cell_t > cells(arg_tris);
+            for (auto& cell : cells)
+                for (auto& v : cell) v = reordered_label.at(v);
+            insert_cells(cells);
+        } else {
+            insert_cells(arg_tris);
+        }
+
+        // assign a key to each simplex in each level
+        levels.resize(simplices.dimension() + 1);
+        for (auto s : simplices.complex_simplex_range()) {
+            int d = simplices.dimension(s);
+            simplices.assign_key(s, levels[d].size());
+            levels[d].push_back(s);
+        }
+        if (reordering & reorder_cells) reorder_levels();
+        if (reordering) record_original_order();
+        removed.resize(levels.size());
+        num_removed.assign(levels.size(), 0);
+        GSIMP_COUNT("construction.top_cells", arg_tris.size());
+        GSIMP_COUNT("construction.simplices", simplices.num_simplices());
+    }
+
+    // create the simplex tree
+    void insert_cells(const std::vector< cell_t >& cells) {
+        for (const auto& tri : cells) {
             // removed deduping to try to make this a bit faster
             // ... it did cut time down about 10%, so ...
+            // (gsimp::weld_mesh drops duplicate cells before construction)
             simplices.insert_simplex_and_subfaces(tri);
             int d = tri.size() - 1;
             if (simplices.dimension() < d) simplices.set_dimension(d);
         }
+    }
 
-        // assign a key to each simplex in each level
-        std::vector< size_t > count(simplices.dimension() + 1, 0);
-        for (int i = 0; i < simplices.dimension() + 1; ++i) {
-            level_t* level = new level_t();
-            levels.push_back(std::unique_ptr< level_t >(level));
+    // vertices (and points) sorted by the Morton code of their coordinates,
+    // quantized in the bounding box
+    void relabel_vertices() {
+        size_t n = points.size(), dim = points[0].size();
+        point_t lower(points[0]), upper(points[0]);
+        for (auto& pt : points)
+            for (size_t k = 0; k < dim; ++k) {
+                lower[k] = std::min(lower[k], pt[k]);
+                upper[k] = std::max(upper[k], pt[k]);
+            }
+        const int bits = std::max< int >(1, std::min< int >(21, 63 / dim));
+        const double cells = double(uint64_t(1) << bits);
+        std::vector< uint64_t > codes(n, 0);
+        std::vector< uint64_t > q(dim);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t k = 0; k < dim; ++k) {
+                double extent = upper[k] - lower[k];
+                double t = extent > 0 ? (points[i][k] - lower[k]) / extent : 0;
+                q[k] = std::min(cells - 1, std::floor(t * cells));
+            }
+            for (int b = bits - 1; b >= 0; --b)
+                for (size_t k = 0; k < dim; ++k)
+                    codes[i] = (codes[i] << 1) | ((q[k] >> b) & 1);
         }
 
-        auto simplex_range = simplices.complex_simplex_range();
-        for (auto s : simplex_range) {
-            int d = simplices.dimension(s);
-            simplices.assign_key(s, count[d]++);
-            levels[d]->push_back(new simp_handle(s));
+        original_label.resize(n);
+        for (size_t i = 0; i < n; ++i) original_label[i] = i;
+        std::stable_sort(
+            original_label.begin(), original_label.end(),
+            [&](size_t a, size_t b) { return codes[a] < codes[b]; });
+        reordered_label.resize(n);
+        std::vector< point_t > permuted(n);
+        for (size_t i = 0; i < n; ++i) {
+            reordered_label[original_label[i]] = i;
+            permuted[i].swap(points[original_label[i]]);
         }
+        points.swap(permuted);
     }
 
-    ~impl() {
-        // get rid of the levels so they won't dangle
-        for (int i = levels.size(); i <= 0; --i) levels[i].reset();
-    };
+    // reverse Cuthill-McKee over the top cells (adjacent through facets),
+    // then each lower level (but the vertices) in order of first use
+    void reorder_levels() {
+        int dim = simplices.dimension();
+        if (dim < 1) return;
+        size_t n = levels[dim].size(), num_facets = levels[dim - 1].size();
+
+        std::vector< size_t > facets(n * (dim + 1));
+        for (size_t i = 0; i < n; ++i) {
+            size_t k = i * (dim + 1);
+            for (auto bs : simplices.boundary_simplex_range(levels[dim][i]))
+                facets[k++] = simplices.key(bs);
+        }
+        std::vector< size_t > offsets(num_facets + 1, 0);
+        for (size_t f : facets) offsets[f + 1]++;
+        for (size_t f = 1; f <= num_facets; ++f) offsets[f] += offsets[f - 1];
+        std::vector< size_t > cofaces(facets.size());
+        std::vector< size_t > next(offsets.begin(), offsets.end() - 1);
+        for (size_t k = 0; k < facets.size(); ++k)
+            cofaces[next[facets[k]]++] = k / (dim + 1);
 
-    size_t get_level_size(int level) { return levels[level]->size(); }
+        // degree: number of top cells sharing a facet with the cell
+        std::vector< size_t > degree(n, 0);
+        for (size_t f = 0; f < num_facets; ++f)
+            for (size_t k = offsets[f]; k < offsets[f + 1]; ++k)
+                degree[cofaces[k]] += offsets[f + 1] - offsets[f] - 1;
+        auto by_degree = [&](size_t a, size_t b) {
+            return degree[a] < degree[b];
+        };
+
+        std::vector< size_t > starts(n);
+        for (size_t i = 0; i < n; ++i) starts[i] = i;
+        std::stable_sort(starts.begin(), starts.end(), by_degree);
+        std::vector< size_t > order;
+        order.reserve(n);
+        std::vector< bool > visited(n, false);
+        std::vector< size_t > neighbours;
+        for (size_t start : starts) {
+            if (visited[start]) continue;
+            visited[start] = true;
+            order.push_back(start);
+            // breadth first from a cell of least degree, lighter cells first
+            for (size_t head = order.size() - 1; head < order.size(); ++head) {
+                size_t c = order[head];
+                neighbours.clear();
+                for (size_t j = 0; j <= size_t(dim); ++j) {
+                    size_t f = facets[c * (dim + 1) + j];
+                    for (size_t k = offsets[f]; k < offsets[f + 1]; ++k)
+                        if (!visited[cofaces[k]]) {
+                            visited[cofaces[k]] = true;
+                            neighbours.push_back(cofaces[k]);
+                        }
+                }
+                std::stable_sort(neighbours.begin(), neighbours.end(),
+                                 by_degree);
+                order.insert(order.end(), neighbours.begin(), neighbours.end());
+            }
+        }
+        std::reverse(order.begin(), order.end());
+
+        level_t top(n);
+        for (size_t i = 0; i < n; ++i) top[i] = levels[dim][order[i]];
+        rekey_level(dim, top);
+
+        for (int d = dim - 1; d > 0; --d) {
+            level_t level;
+            level.reserve(levels[d].size());
+            std::vector< bool > used(levels[d].size(), false);
+            for (auto cell : levels[d + 1])
+                for (auto bs : simplices.boundary_simplex_range(cell))
+                    if (!used[simplices.key(bs)]) {
+                        used[simplices.key(bs)] = true;
+                        level.push_back(bs);
+                    }
+            // maximal cells below the top dimension keep their order
+            for (size_t i = 0; i < levels[d].size(); ++i)
+                if (!used[i]) level.push_back(levels[d][i]);
+            rekey_level(d, level);
+        }
+    }
+
+    void rekey_level(int d, level_t& level) {
+        for (size_t i = 0; i < level.size(); ++i)
+            simplices.assign_key(level[i], i);
+        levels[d].swap(level);
+    }
+
+    // the keys of the complex built without reordering follow the
+    // lexicographic order of the (sorted) point indices of the cells, the
+    // orientations the parity of sorting them
+    void record_original_order() {
+        original_key.resize(levels.size());
+        reordered_key.resize(levels.size());
+        original_sign.resize(levels.size());
+        for (size_t d = 0; d < levels.size(); ++d) {
+            size_t m = levels[d].size(), stride = d + 1;
+            std::vector< size_t > labels(m * stride);
+            original_sign[d].assign(m, 1);
+            for (size_t i = 0; i < m; ++i) {
+                size_t* cell = &labels[i * stride];
+                size_t k = 0;
+                for (auto v : simplices.simplex_vertex_range(levels[d][i]))
+                    cell[k++] = v;
+                std::sort(cell, cell + stride);
+                if (original_label.empty()) continue;
+                int sign = 1;
+                for (size_t a = 0; a < stride; ++a) {
+                    cell[a] = original_label[cell[a]];
+                    for (size_t b = 0; b < a; ++b)
+                        if (cell[b] > cell[a]) sign = -sign;
+                }
+                std::sort(cell, cell + stride);
+                original_sign[d][i] = sign;
+            }
+
+            std::vector< size_t >& back = reordered_key[d];
+            back.resize(m);
+            for (size_t i = 0; i < m; ++i) back[i] = i;
+            std::sort(back.begin(), back.end(), [&](size_t a, size_t b) {
+                return std::lexicographical_compare(
+                    &labels[a * stride], &labels[(a + 1) * stride],
+                    &labels[b * stride], &labels[(b + 1) * stride]);
+            });
+            original_key[d].resize(m);
+            for (size_t i = 0; i < m; ++i) original_key[d][back[i]] = i;
+        }
+    }
+
+    // parity of sorting the original labels of a cell (in increasing order
+    // of its labels in the complex)
+    int original_orientation(simp_handle s) {
+        std::vector< size_t > cell;
+        for (auto v : simplices.simplex_vertex_range(s)) cell.push_back(v);
+        std::sort(cell.begin(), cell.end());
+        if (original_label.empty()) return 1;
+        int sign = 1;
+        for (size_t a = 0; a < cell.size(); ++a) {
+            cell[a] = original_label[cell[a]];
+            for (size_t b = 0; b < a; ++b)
+                if (cell[b] > cell[a]) sign = -sign;
+        }
+        return sign;
+    }
+
+    size_t get_level_size(int level) { return levels[level].size(); }
+
+    bool is_removed(int d, size_t i) const {
+        return !removed[d].empty() && removed[d][i];
+    }
 
     // calculate the index of s_1 in the boundary of s_2
     int boundary_index(simp_handle s_1, simp_handle s_2) {
@@ -176,27 +471,379 @@ struct simplicial_complex::impl {
         return no_reps_list;
     }
 
+    // entries gathered per level and assembled at once (coeffRef in tree
+    // order inserts all over the columns of reordered complexes)
     void calculate_matrices() {
-        boundary_matrices = std::vector< matrix_t >();
-        for (int k = 0; k < simplices.dimension(); k++) {
-            boundary_matrices.push_back(
-                matrix_t(get_level_size(k), get_level_size(k + 1)));
-        }
+        GSIMP_PHASE("matrices");
+        int dim = simplices.dimension();
+        std::vector< std::vector< Eigen::Triplet< double > > > entries(dim);
+        for (int k = 0; k < dim; k++)
+            entries[k].reserve(levels[k + 1].size() * (k + 2));
         for (auto s : simplices.complex_simplex_range()) {
             int j = simplices.key(s);
+            if (is_removed(simplices.dimension(s), j)) continue;
             for (auto bs : simplices.boundary_simplex_range(s)) {
                 int i = simplices.key(bs);
                 int k = simplices.dimension(bs);
-                boundary_matrices[k].coeffRef(i, j) = boundary_index(bs, s);
+                entries[k].emplace_back(i, j, boundary_index(bs, s));
+            }
+        }
+        boundary_matrices = std::vector< matrix_t >();
+        for (int k = 0; k < dim; k++) {
+            boundary_matrices.push_back(
+                matrix_t(get_level_size(k), get_level_size(k + 1)));
+            boundary_matrices[k].setFromTriplets(entries[k].begin(),
+                                                 entries[k].end());
+        }
+        matrices_ready = true;
+    }
+
+    // facets (with signs) straight from the simplex tree, then the cofaces
+    // by counting them
+    void calculate_hasse() {
+        int dim = simplices.dimension();
+        hasse_diag diag;
+        diag.resize(dim);
+
+        for (int d = 1; d <= dim; ++d) {
+            auto& faces = diag.faces[d];
+            auto& signs = diag.face_signs[d];
+            faces.resize(levels[d].size() * (d + 1));
+            signs.resize(faces.size());
+            for (size_t i = 0; i < levels[d].size(); ++i) {
+                size_t* f = &faces[i * (d + 1)];
+                int8_t* sg = &signs[i * (d + 1)];
+                size_t k = 0;
+                for (auto bs : simplices.boundary_simplex_range(levels[d][i])) {
+                    f[k] = simplices.key(bs);
+                    sg[k++] = boundary_index(bs, levels[d][i]);
+                }
+                for (size_t a = 1; a < k; ++a)
+                    for (size_t b = a; b > 0 && f[b - 1] > f[b]; --b) {
+                        std::swap(f[b - 1], f[b]);
+                        std::swap(sg[b - 1], sg[b]);
+                    }
+            }
+        }
+
+        for (int d = 0; d <= dim; ++d) diag.pack_cofaces(d, levels[d].size());
+        diag.find_boundary();
+        incidence = std::move(diag);
+    }
+
+    // the facets of cell i of level d > 0 at the end of the Hasse diagram,
+    // sorted (cells are appended in index order)
+    void append_faces(int d, size_t i) {
+        auto& faces = incidence.faces[d];
+        auto& signs = incidence.face_signs[d];
+        size_t first = faces.size();
+        for (auto bs : simplices.boundary_simplex_range(levels[d][i])) {
+            faces.push_back(simplices.key(bs));
+            signs.push_back(boundary_index(bs, levels[d][i]));
+        }
+        for (size_t a = first + 1; a < faces.size(); ++a)
+            for (size_t b = a; b > first && faces[b - 1] > faces[b]; --b) {
+                std::swap(faces[b - 1], faces[b]);
+                std::swap(signs[b - 1], signs[b]);
             }
+    }
+
+    // a tombstone for cell i of level d, and for its facets left without
+    // cofaces
+    void remove_cell(int d, size_t i, update_report& report) {
+        if (removed[d].empty()) removed[d].assign(levels[d].size(), 0);
+        removed[d][i] = 1;
+        ++num_removed[d];
+        report.removed[d].push_back(i);
+        if (d == 0) return;
+        // the column goes empty in place, nothing to prune afterwards
+        // (uncompressed, every column keeps its own room)
+        if (matrices_ready) {
+            matrix_t& matrix = boundary_matrices[d - 1];
+            if (matrix.isCompressed()) matrix.uncompress();
+            matrix.innerNonZeroPtr()[i] = 0;
+        }
+        for (size_t k = i * (d + 1); k < (i + 1) * (d + 1); ++k) {
+            size_t tau = incidence.faces[d][k];
+            if (incidence.remove_coface(d - 1, tau, i) == 0)
+                remove_cell(d - 1, tau, report);
         }
     }
 
+    update_report update_cells(const std::vector< point_t >& new_points,
+                               const std::vector< cell_t >& removed_cells,
+                               const std::vector< cell_t >& inserted_cells) {
+        int dim = levels.size() - 1;
+        size_t num_points = points.size() + new_points.size();
+
+        // everything is checked before the complex changes
+        std::vector< size_t > doomed;
+        for (const cell_t& cell : removed_cells) {
+            simp_handle sh = cell.size() == size_t(dim + 1)
+                                 ? simplices.find(cell)
+                                 : simplices.null_simplex();
+            if (sh == simplices.null_simplex() ||
+                is_removed(dim, simplices.key(sh)))
+                throw std::runtime_error(
+                    "a removed cell is not a top cell of the complex\n");
+            doomed.push_back(simplices.key(sh));
+        }
+        std::sort(doomed.begin(), doomed.end());
+        if (std::adjacent_find(doomed.begin(), doomed.end()) != doomed.end())
+            throw std::runtime_error("a cell is removed twice\n");
+        std::vector< cell_t > cells(inserted_cells);
+        for (cell_t& cell : cells) {
+            std::sort(cell.begin(), cell.end());
+            if (cell.size() != size_t(dim + 1) ||
+                std::adjacent_find(cell.begin(), cell.end()) != cell.end() ||
+                cell.back() >= num_points)
+                throw std::runtime_error(
+                    "an inserted cell is not a top cell on the points\n");
+            simp_handle sh = simplices.find(cell);
+            if (sh != simplices.null_simplex() &&
+                !is_removed(dim, simplices.key(sh)) &&
+                !std::binary_search(doomed.begin(), doomed.end(),
+                                    simplices.key(sh)))
+                throw std::runtime_error(
+                    "an inserted cell is already in the complex\n");
+        }
+        std::sort(cells.begin(), cells.end());
+        if (std::adjacent_find(cells.begin(), cells.end()) != cells.end())
+            throw std::runtime_error("a cell is inserted twice\n");
+
+        update_report report;
+        report.first_point = points.size();
+        report.removed.resize(dim + 1);
+        report.added.resize(dim + 1);
+        points.insert(points.end(), new_points.begin(), new_points.end());
+        for (size_t v = report.first_point;
+             !original_label.empty() && v < num_points; ++v) {
+            original_label.push_back(v);
+            reordered_label.push_back(v);
+        }
+        incidence.unpack();
+        for (size_t sigma : doomed) remove_cell(dim, sigma, report);
+
+        // the faces of the inserted cells: tombstones come back, the cells
+        // not in the tree are new
+        std::set< cell_t > fresh;
+        cell_t face;
+        for (const cell_t& cell : cells) {
+            for (size_t mask = 1; mask < (size_t(1) << cell.size()); ++mask) {
+                face.clear();
+                for (size_t k = 0; k < cell.size(); ++k)
+                    if (mask >> k & 1) face.push_back(cell[k]);
+                simp_handle sh = simplices.find(face);
+                if (sh == simplices.null_simplex()) {
+                    fresh.insert(face);
+                    continue;
+                }
+                int d = face.size() - 1;
+                size_t i = simplices.key(sh);
+                if (is_removed(d, i)) {
+                    removed[d][i] = 0;
+                    --num_removed[d];
+                    report.added[d].push_back(i);
+                }
+            }
+        }
+        for (const cell_t& cell : cells)
+            simplices.insert_simplex_and_subfaces(cell);
+
+        if (!fresh.empty()) {
+            std::vector< size_t > old_size(dim + 1);
+            for (int d = 0; d <= dim; ++d) old_size[d] = levels[d].size();
+            // insertions move the nodes of the siblings they went into
+            // (Gudhi keeps siblings in flat maps), the handles of those
+            // siblings are taken again
+            std::vector< simp_tree::Siblings* > moved;
+            for (const cell_t& cell : fresh) {
+                int d = cell.size() - 1;
+                simp_handle sh = simplices.find(cell);
+                simplices.assign_key(sh, levels[d].size());
+                levels[d].push_back(simplices.null_simplex());
+                moved.push_back(simplices.self_siblings(sh));
+            }
+            std::sort(moved.begin(), moved.end());
+            moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+            for (auto* siblings : moved)
+                for (auto sh = siblings->members().begin();
+                     sh != siblings->members().end(); ++sh)
+                    levels[simplices.dimension(sh)][simplices.key(sh)] = sh;
+            for (int d = 0; d <= dim; ++d) {
+                for (size_t i = old_size[d]; i < levels[d].size(); ++i) {
+                    report.added[d].push_back(i);
+                    if (!removed[d].empty()) removed[d].push_back(0);
+                    if (d > 0) append_faces(d, i);
+                    incidence.new_slot(d);
+                    if (original_key.empty()) continue;
+                    original_key[d].push_back(i);
+                    reordered_key[d].push_back(i);
+                    original_sign[d].push_back(
+                        original_orientation(levels[d][i]));
+                }
+            }
+        }
+
+        if (matrices_ready)
+            for (int k = 0; k < dim; ++k)
+                boundary_matrices[k].conservativeResize(levels[k].size(),
+                                                        levels[k + 1].size());
+        // the added cells among the cofaces of their facets
+        for (int d = 1; d <= dim; ++d) {
+            for (size_t i : report.added[d]) {
+                for (size_t k = i * (d + 1); k < (i + 1) * (d + 1); ++k) {
+                    size_t tau = incidence.faces[d][k];
+                    int8_t sign = incidence.face_signs[d][k];
+                    incidence.add_coface(d - 1, tau, i, sign);
+                    if (matrices_ready)
+                        boundary_matrices[d - 1].coeffRef(tau, i) = sign;
+                }
+            }
+        }
+
+        // the boundary facets around the changed top cells
+        if (dim > 0) {
+            std::vector< size_t > touched;
+            for (auto* cells_of : {&report.removed[dim], &report.added[dim]})
+                for (size_t sigma : *cells_of)
+                    for (size_t k = sigma * (dim + 1);
+                         k < (sigma + 1) * (dim + 1); ++k)
+                        touched.push_back(incidence.faces[dim][k]);
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()),
+                          touched.end());
+            // the touched facets go after the list, sorted as well: the
+            // old entries of those facets leave and the two runs merge
+            auto& boundary = incidence.boundary;
+            size_t old_size = boundary.size();
+            for (size_t tau : touched) incidence.add_if_boundary(tau);
+            auto next = touched.begin();
+            auto kept = std::remove_if(
+                boundary.begin(), boundary.begin() + old_size,
+                [&](const simplicial_complex::boundary_facet& f) {
+                    while (next != touched.end() && *next < f.facet) ++next;
+                    return next != touched.end() && *next == f.facet;
+                });
+            size_t num_kept = kept - boundary.begin();
+            boundary.erase(kept, boundary.begin() + old_size);
+            std::inplace_merge(
+                boundary.begin(), boundary.begin() + num_kept, boundary.end(),
+                [](const simplicial_complex::boundary_facet& a,
+                   const simplicial_complex::boundary_facet& b) {
+                    return a.facet < b.facet;
+                });
+        }
+        return report;
+    }
+
+    std::vector< std::vector< size_t > > compact() {
+        // the levels, the tree may lower its dimension once cells are gone
+        int dim = levels.size() - 1;
+        std::vector< std::vector< size_t > > remap(levels.size());
+        size_t total_removed = 0;
+        for (size_t d = 0; d < levels.size(); ++d) {
+            remap[d].resize(levels[d].size());
+            size_t next = 0;
+            for (size_t i = 0; i < levels[d].size(); ++i)
+                remap[d][i] = is_removed(d, i) ? no_index : next++;
+            total_removed += num_removed[d];
+        }
+        if (total_removed == 0) return remap;
+
+        // tombstones leave the tree from the top down, after their cofaces
+        std::vector< cell_t > doomed;
+        for (int d = dim; d >= 0; --d)
+            for (size_t i = 0; i < levels[d].size(); ++i)
+                if (is_removed(d, i))
+                    doomed.push_back(handle_to_cell(levels[d][i]));
+        for (const cell_t& cell : doomed)
+            simplices.remove_maximal_simplex(simplices.find(cell));
+        levels_t kept(levels.size());
+        for (size_t d = 0; d < levels.size(); ++d)
+            kept[d].resize(levels[d].size() - num_removed[d]);
+        for (auto sh : simplices.complex_simplex_range()) {
+            int d = simplices.dimension(sh);
+            size_t i = remap[d][simplices.key(sh)];
+            simplices.assign_key(sh, i);
+            kept[d][i] = sh;
+        }
+
+        // the facets of the cells kept, renumbered (in the same order, so
+        // still sorted), and the cofaces packed again
+        hasse_diag diag;
+        diag.resize(dim);
+        for (int d = 1; d <= dim; ++d) {
+            for (size_t i = 0; i < levels[d].size(); ++i) {
+                if (remap[d][i] == no_index) continue;
+                for (size_t k = i * (d + 1); k < (i + 1) * (d + 1); ++k) {
+                    diag.faces[d].push_back(
+                        remap[d - 1][incidence.faces[d][k]]);
+                    diag.face_signs[d].push_back(incidence.face_signs[d][k]);
+                }
+            }
+        }
+        for (int d = 0; d <= dim; ++d) diag.pack_cofaces(d, kept[d].size());
+        diag.find_boundary();
+        incidence = std::move(diag);
+
+        for (int k = 0; matrices_ready && k < dim; ++k) {
+            std::vector< Eigen::Triplet< double > > entries;
+            for (int j = 0; j < boundary_matrices[k].outerSize(); ++j)
+                for (matrix_t::InnerIterator it(boundary_matrices[k], j); it;
+                     ++it)
+                    entries.emplace_back(remap[k][it.row()],
+                                         remap[k + 1][it.col()], it.value());
+            boundary_matrices[k] =
+                matrix_t(kept[k].size(), kept[k + 1].size());
+            boundary_matrices[k].setFromTriplets(entries.begin(),
+                                                 entries.end());
+        }
+
+        // the original order keeps the relative order of the cells kept
+        for (size_t d = 0; d < original_key.size(); ++d) {
+            size_t m = levels[d].size();
+            std::vector< size_t > rank(m, no_index);
+            for (size_t i = 0; i < m; ++i)
+                if (remap[d][i] != no_index) rank[original_key[d][i]] = 0;
+            for (size_t o = 0, next = 0; o < m; ++o)
+                if (rank[o] != no_index) rank[o] = next++;
+            std::vector< size_t > keys(kept[d].size());
+            std::vector< int8_t > signs(kept[d].size());
+            for (size_t i = 0; i < m; ++i) {
+                if (remap[d][i] == no_index) continue;
+                keys[remap[d][i]] = rank[original_key[d][i]];
+                signs[remap[d][i]] = original_sign[d][i];
+            }
+            reordered_key[d].resize(keys.size());
+            for (size_t i = 0; i < keys.size(); ++i)
+                reordered_key[d][keys[i]] = i;
+            original_key[d].swap(keys);
+            original_sign[d].swap(signs);
+        }
+
+        levels.swap(kept);
+        for (size_t d = 0; d < levels.size(); ++d) {
+            std::vector< uint8_t >().swap(removed[d]);
+            num_removed[d] = 0;
+        }
+        return remap;
+    }
+
+    void build_matrices() {
+        std::call_once(matrices_built, [this] { calculate_matrices(); });
+    }
+
+    const matrix_t& boundary_matrix(int d) {
+        build_matrices();
+        return boundary_matrices.at(d);
+    }
+
     std::vector< cell_t > get_level(int level) {
         std::vector< cell_t > level_cells;
-        for (auto simp : *levels[level]) {
+        for (auto simp : levels[level]) {
             cell_t v_simp;
-            for (auto v : simplices.simplex_vertex_range(*simp)) {
+            for (auto v : simplices.simplex_vertex_range(simp)) {
                 v_simp.push_back(v);
             }
             level_cells.push_back(v_simp);
@@ -205,7 +852,7 @@ struct simplicial_complex::impl {
     }
 
     simp_handle index_to_handle(int d, size_t tau) {
-        return *(*(levels[d]))[tau];
+        return levels[d][tau];
     }
 
     size_t handle_to_index(simp_handle tau) { return simplices.key(tau); }
@@ -221,6 +868,49 @@ struct simplicial_complex::impl {
         return cell;
     }
 
+    // one dictionary entry (vertex, node) per simplex, one set of siblings
+    // per simplex with cofaces plus the root
+    size_t simplex_tree_bytes() {
+        size_t parents = 1;
+        for (auto s : simplices.complex_simplex_range())
+            if (simplices.has_children(s)) ++parents;
+        return simplices.num_simplices() *
+                   sizeof(std::pair< size_t, simp_tree::Node >) +
+               parents * sizeof(simp_tree::Siblings);
+    }
+
+    memory_report get_memory_report() {
+        memory_report report;
+        report.add("points", memory::points_bytes(points));
+        report.add("simplex_tree", simplex_tree_bytes());
+        for (size_t d = 0; d < levels.size(); ++d)
+            report.add("levels[" + std::to_string(d) + "]",
+                       memory::vector_bytes(levels[d]));
+        for (size_t d = 0; d < incidence.faces.size(); ++d)
+            report.add("hasse[" + std::to_string(d) + "]",
+                       incidence.level_bytes(d));
+        if (!incidence.faces.empty())
+            report.add("boundary_facets",
+                       memory::vector_bytes(incidence.boundary));
+        size_t tombstone_bytes = 0;
+        for (auto& flags : removed)
+            tombstone_bytes += memory::vector_bytes(flags);
+        if (tombstone_bytes) report.add("tombstones", tombstone_bytes);
+        for (size_t d = 0; d < boundary_matrices.size(); ++d)
+            report.add("boundary_matrices[" + std::to_string(d) + "]",
+                       memory::matrix_bytes(boundary_matrices[d]));
+        if (!original_key.empty()) {
+            size_t bytes = memory::vector_bytes(original_label) +
+                           memory::vector_bytes(reordered_label);
+            for (size_t d = 0; d < original_key.size(); ++d)
+                bytes += memory::vector_bytes(original_key[d]) +
+                         memory::vector_bytes(reordered_key[d]) +
+                         memory::vector_bytes(original_sign[d]);
+            report.add("reordering", bytes);
+        }
+        return report;
+    }
+
 };  // struct impl
 
 std::vector< std::pair< int, cell_t > > simplicial_complex::get_bdry_and_ind(
@@ -258,6 +948,20 @@ std::vector< size_t > simplicial_complex::cell_boundary_index(int d,
     return s_boundary;
 }
 
+void simplicial_complex::cell_boundary_index(int d, size_t cell,
+                                             std::vector< size_t >& out) {
+    incidence_view faces = faces_view(d);
+    out.assign(faces.cells + faces.begin(cell), faces.cells + faces.end(cell));
+}
+
+void simplicial_complex::get_bdry_and_ind_index(
+    int d, size_t cell, std::vector< std::pair< int, size_t > >& out) {
+    incidence_view faces = faces_view(d);
+    out.clear();
+    for (size_t k = faces.begin(cell); k < faces.end(cell); ++k)
+        out.emplace_back(faces.signs[k], faces.cells[k]);
+}
+
 std::vector< cell_t > simplicial_complex::cell_boundary(cell_t cell) {
     impl::simp_handle simp = p_impl->cell_to_handle(cell);
     auto c_boundary = p_impl->simplices.boundary_simplex_range(simp);
@@ -272,10 +976,8 @@ int simplicial_complex::boundary_inclusion_index(cell_t c1, cell_t c2) {
 };
 int simplicial_complex::boundary_inclusion_index(int d1, size_t s1,    //
                                                  int d2, size_t s2) {  //
-    cell_t c1 = index_to_cell(d1, s1);
-    cell_t c2 = index_to_cell(d2, s2);
-    return p_impl->boundary_index(p_impl->cell_to_handle(c1),
-                                  p_impl->cell_to_handle(c2));
+    return p_impl->boundary_index(p_impl->index_to_handle(d1, s1),
+                                  p_impl->index_to_handle(d2, s2));
 };
 
 std::vector< std::pair< int, cell_t > > simplicial_complex::get_cof_and_ind(
@@ -291,10 +993,7 @@ std::vector< std::pair< int, cell_t > > simplicial_complex::get_cof_and_ind(
 std::vector< std::pair< int, size_t > >
 simplicial_complex::get_cof_and_ind_index(int d, size_t c) {
     std::vector< std::pair< int, size_t > > c_cofaces;
-    for (auto face : get_cofaces_index(d, c))
-        c_cofaces.push_back(                                          //
-            std::make_pair(                                           //
-                boundary_inclusion_index(d, c, d + 1, face), face));  //
+    get_cof_and_ind_index(d, c, c_cofaces);
     return c_cofaces;
 }
 
@@ -312,6 +1011,12 @@ simplicial_complex::simplicial_complex(std::vector< point_t >& arg_points,
     p_impl = std::make_shared< impl >(arg_points, arg_tris);
 }
 
+simplicial_complex::simplicial_complex(std::vector< point_t >& arg_points,
+                                       std::vector< cell_t >& arg_tris,
+                                       int reordering) {
+    p_impl = std::make_shared< impl >(arg_points, arg_tris, reordering);
+}
+
 simplicial_complex::simplicial_complex(const simplicial_complex& other) {
     p_impl = other.p_impl;
 }
@@ -338,7 +1043,7 @@ std::vector< cell_t > simplicial_complex::get_level(int level) {
 
 matrix_t simplicial_complex::get_boundary_matrix(int d) {
     // uninstantiated boundary matrices
-    if (p_impl->boundary_matrices.size() == 0) p_impl->calculate_matrices();
+    p_impl->build_matrices();
 
     // now they have to be instantiated, get them
     if (0 <= d && d < p_impl->boundary_matrices.size())
@@ -350,8 +1055,7 @@ matrix_t simplicial_complex::get_boundary_matrix(int d) {
 int simplicial_complex::dimension() { return p_impl->simplices.dimension(); }
 
 cell_t simplicial_complex::index_to_cell(int d, size_t ind) {
-    auto sh = (*(p_impl->levels[d]))[ind];
-    return p_impl->handle_to_cell(*sh);
+    return p_impl->handle_to_cell(p_impl->levels[d][ind]);
 }
 
 size_t simplicial_complex::cell_to_index(cell_t simp) {
@@ -362,31 +1066,56 @@ size_t simplicial_complex::cell_to_index(cell_t simp) {
 std::vector< size_t > simplicial_complex::get_cofaces_index(int d,
                                                             size_t face) {
     // codimension 1 faces
-    if (!p_impl->has_hasse) {
-        calculate_hasse();
-        p_impl->has_hasse = true;
-    }
-    auto s_cofaces = p_impl->incidence.get_coface_i(d, face);
+    std::vector< size_t > s_cofaces;
+    get_cofaces_index(d, face, s_cofaces);
     return s_cofaces;
 }
 
+void simplicial_complex::get_cofaces_index(int d, size_t face,
+                                           std::vector< size_t >& out) {
+    incidence_view cofaces = cofaces_view(d);
+    out.assign(cofaces.cells + cofaces.begin(face),
+               cofaces.cells + cofaces.end(face));
+}
+
+void simplicial_complex::get_cof_and_ind_index(
+    int d, size_t c, std::vector< std::pair< int, size_t > >& out) {
+    incidence_view cofaces = cofaces_view(d);
+    out.clear();
+    for (size_t k = cofaces.begin(c); k < cofaces.end(c); ++k)
+        out.emplace_back(cofaces.signs[k], cofaces.cells[k]);
+}
+
 std::vector< cell_t > simplicial_complex::get_cofaces(cell_t face) {
-    if (!p_impl->has_hasse) {
-        calculate_hasse();
-        p_impl->has_hasse = true;
-    }
     std::vector< cell_t > s_cofaces;
-    auto face_i = cell_to_index(face);
     int d = face.size() - 1;
     // codimension 1 faces
-    auto coface_i_v = p_impl->incidence.get_coface_i(d, face_i);
-    for (auto v : coface_i_v) {
-        auto face_h = (*(p_impl->levels[d + 1]))[v];
-        s_cofaces.push_back(p_impl->handle_to_cell(*face_h));
-    }
+    for (auto v : get_cofaces_index(d, cell_to_index(face)))
+        s_cofaces.push_back(p_impl->handle_to_cell(p_impl->levels[d + 1][v]));
     return s_cofaces;
 }
 
+simplicial_complex::incidence_view simplicial_complex::faces_view(int d) {
+    calculate_hasse();
+    const hasse_diag& diag = p_impl->incidence;
+    return {nullptr, nullptr, d > 0 ? size_t(d + 1) : 0,
+            diag.faces.at(d).data(), diag.face_signs.at(d).data()};
+}
+
+simplicial_complex::incidence_view simplicial_complex::cofaces_view(int d) {
+    calculate_hasse();
+    const hasse_diag& diag = p_impl->incidence;
+    return {diag.coface_offsets.at(d).data(),
+            diag.packed ? nullptr : diag.coface_ends.at(d).data(), 0,
+            diag.cofaces.at(d).data(), diag.coface_signs.at(d).data()};
+}
+
+const std::vector< simplicial_complex::boundary_facet >&
+simplicial_complex::boundary_facets() {
+    calculate_hasse();
+    return p_impl->incidence.boundary;
+}
+
 chain_v simplicial_complex::new_v_chain(int d) {
     std::vector< double > v(get_level_size(d), 0);
     return chain_v(d, v);
@@ -396,8 +1125,109 @@ chain_t simplicial_complex::new_chain(int d) {
     return chain_t(d, v);
 }
 
+bool simplicial_complex::reordered() { return !p_impl->original_key.empty(); }
+
+size_t simplicial_complex::original_index(int d, size_t i) {
+    return reordered() ? p_impl->original_key.at(d).at(i) : i;
+}
+
+size_t simplicial_complex::reordered_index(int d, size_t i) {
+    return reordered() ? p_impl->reordered_key.at(d).at(i) : i;
+}
+
+cell_t simplicial_complex::original_cell(cell_t cell) {
+    if (!p_impl->original_label.empty())
+        for (auto& v : cell) v = p_impl->original_label.at(v);
+    return cell;
+}
+
+cell_t simplicial_complex::reordered_cell(cell_t cell) {
+    if (!p_impl->reordered_label.empty())
+        for (auto& v : cell) v = p_impl->reordered_label.at(v);
+    return cell;
+}
+
+chain_v simplicial_complex::to_original_order(const chain_v& chain) {
+    if (!reordered()) return chain;
+    int d = chain.first;
+    const auto& keys = p_impl->original_key.at(d);
+    const auto& signs = p_impl->original_sign.at(d);
+    chain_v original(d, std::vector< double >(chain.second.size(), 0));
+    for (size_t i = 0; i < chain.second.size(); ++i)
+        original.second[keys[i]] = signs[i] * chain.second[i];
+    return original;
+}
+
+chain_v simplicial_complex::from_original_order(const chain_v& chain) {
+    if (!reordered()) return chain;
+    int d = chain.first;
+    const auto& keys = p_impl->original_key.at(d);
+    const auto& signs = p_impl->original_sign.at(d);
+    chain_v reordered(d, std::vector< double >(chain.second.size(), 0));
+    for (size_t i = 0; i < chain.second.size(); ++i)
+        reordered.second[i] = signs[i] * chain.second[keys[i]];
+    return reordered;
+}
+
+chain_t simplicial_complex::to_original_order(const chain_t& chain) {
+    if (!reordered()) return chain;
+    int d = chain.first;
+    const auto& keys = p_impl->original_key.at(d);
+    const auto& signs = p_impl->original_sign.at(d);
+    std::vector< std::pair< size_t, double > > entries;
+    entries.reserve(chain.second.nonZeros());
+    for (vector_t::InnerIterator it(chain.second); it; ++it)
+        entries.emplace_back(keys[it.index()],
+                             signs[it.index()] * it.value());
+    std::sort(entries.begin(), entries.end());
+    chain_t original(d, vector_t(chain.second.size()));
+    original.second.reserve(entries.size());
+    for (auto& entry : entries)
+        original.second.insertBack(entry.first) = entry.second;
+    return original;
+}
+
+simplicial_complex::update_report simplicial_complex::update_cells(
+    const std::vector< point_t >& points, const std::vector< cell_t >& removed,
+    const std::vector< cell_t >& inserted) {
+    calculate_hasse();
+    GSIMP_PHASE("update_cells");
+    return p_impl->update_cells(points, removed, inserted);
+}
+
+const std::vector< uint8_t >& simplicial_complex::tombstones(int d) {
+    return p_impl->removed.at(d);
+}
+
+size_t simplicial_complex::num_tombstones(int d) {
+    return p_impl->num_removed.at(d);
+}
+
+std::vector< std::vector< size_t > > simplicial_complex::compact() {
+    calculate_hasse();
+    GSIMP_PHASE("compact");
+    return p_impl->compact();
+}
+
+memory_report simplicial_complex::get_memory_report() {
+    return p_impl->get_memory_report();
+}
+
 void simplicial_complex::calculate_hasse() {
-    p_impl->has_hasse = true;
-    p_impl->incidence = hasse_diag(*this);
+    std::call_once(p_impl->hasse_built, [this] {
+        GSIMP_PHASE("hasse");
+        p_impl->calculate_hasse();
+    });
+}
+
+void simplicial_complex::prepare(int structures) {
+    GSIMP_PHASE("prepare");
+    // the two only read the simplex tree, they are built side by side
+    std::future< void > matrices;
+    if (structures & prepare_matrices)
+        matrices = std::async(std::launch::async,
+                              [this] { p_impl->build_matrices(); });
+    if (structures & prepare_hasse) calculate_hasse();
+    if (matrices.valid()) matrices.get();
 }
 };  // namespace gsimp
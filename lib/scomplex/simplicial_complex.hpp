@@ -1,6 +1,8 @@
 #pragma once
 
+#include <scomplex/memory.hpp>
 #include <scomplex/types.hpp>
+#include <cstdint>
 #include <memory>
 
 #include <gudhi/Simplex_tree.h>
@@ -10,18 +12,43 @@ namespace gsimp {
 
 class No_Boundary {};
 
+/*
+ * the Hasse diagram (cofaces) and the boundary matrices are derived from the
+ * simplex tree on first use, or all at once by prepare(). either way each
+ * is built exactly once, also when several threads ask for it at the same
+ * time, and after that a complex is only modified by update_cells and
+ * compact: between those every member function, coeff_flow and the
+ * path_snapper / bounding_chain built on it can be called concurrently.
+ * copies share the same data.
+ */
 class simplicial_complex {
     // implementation details
     struct impl;
     std::shared_ptr<impl> p_impl;
 
    public:
+    // derived structures, for prepare
+    enum { prepare_hasse = 1, prepare_matrices = 2, prepare_all = 3 };
 
     void calculate_hasse();
+    // build the requested derived structures now (in parallel), so later
+    // queries only read
+    void prepare(int structures = prepare_all);
+
+    // orderings, for the constructor
+    enum { reorder_vertices = 1, reorder_cells = 2, reorder_all = 3 };
 
     // constructor (no default)
     simplicial_complex(std::vector<cell_t>&);
     simplicial_complex(std::vector<point_t>&, std::vector<cell_t>&);
+    // reordered for locality: vertices are relabeled along a Morton curve
+    // over their coordinates (the points permuted to match), top cells take
+    // a reverse Cuthill-McKee order of their adjacency through facets and
+    // the cells in between the order in which the level above first uses
+    // them. the complex then works in its own labels, indices and
+    // orientations, the functions below translate.
+    simplicial_complex(std::vector<point_t>&, std::vector<cell_t>&,
+                       int reordering);
     simplicial_complex(const simplicial_complex&);
     simplicial_complex& operator=(const simplicial_complex&);
     // destructor
@@ -39,20 +66,102 @@ class simplicial_complex {
     // inclusion index
     int boundary_inclusion_index(cell_t, cell_t);
     int boundary_inclusion_index(int, size_t, int, size_t);
-    // cell boundaries
+    // cell boundaries (the index versions taking an output vector reuse its
+    // storage, they do not allocate once it is large enough; boundaries
+    // come in increasing index order)
     std::vector<cell_t> cell_boundary(cell_t);
     std::vector<size_t> cell_boundary_index(int, size_t);
+    void cell_boundary_index(int, size_t, std::vector<size_t>&);
     std::vector<std::pair<int, cell_t>> get_bdry_and_ind(cell_t);
     std::vector<std::pair<int, size_t>> get_bdry_and_ind_index(int, size_t);
+    void get_bdry_and_ind_index(int, size_t,
+                                std::vector<std::pair<int, size_t>>&);
     // treating cofaces
     std::vector<cell_t> get_cofaces(cell_t);
     std::vector<size_t> get_cofaces_index(int, size_t);
+    void get_cofaces_index(int, size_t, std::vector<size_t>&);
     std::vector<std::pair<int, cell_t>> get_cof_and_ind(cell_t);
     std::vector<std::pair<int, size_t>> get_cof_and_ind_index(int, size_t);
+    void get_cof_and_ind_index(int, size_t,
+                               std::vector<std::pair<int, size_t>>&);
+    // flat incidence arrays, built with the Hasse diagram, for loops that
+    // must not allocate: the facets of cell i of level d are
+    // cells[begin(i)] .. cells[end(i) - 1] of faces_view(d) (in increasing
+    // index order), its cofaces likewise in cofaces_view(d), with the
+    // incidence signs alongside. views stay valid as long as the complex.
+    struct incidence_view {
+        const size_t* offsets;  // null when every cell has stride entries
+        const size_t* ends;     // null when cell i ends where i + 1 begins
+        size_t stride;
+        const size_t* cells;
+        const int8_t* signs;
+
+        size_t begin(size_t i) const {
+            return offsets ? offsets[i] : i * stride;
+        }
+        size_t end(size_t i) const {
+            if (ends) return ends[i];
+            return offsets ? offsets[i + 1] : (i + 1) * stride;
+        }
+    };
+    incidence_view faces_view(int);
+    incidence_view cofaces_view(int);
+    // facets of the top cells with a single coface, the boundary of the
+    // complex, in increasing index order with that coface and the sign of
+    // the incidence. built with the Hasse diagram, empty when closed.
+    struct boundary_facet {
+        size_t facet;
+        size_t coface;
+        int8_t sign;
+    };
+    const std::vector<boundary_facet>& boundary_facets();
     // boundary matrices
     matrix_t get_boundary_matrix(int);
     // cells and indices back and forth
     cell_t index_to_cell(int, size_t);
     size_t cell_to_index(cell_t);
+    // between the complex and the one built without reordering (the
+    // identity when there is none): index of cell i of level d, vertex
+    // labels (point indices) of a cell, and chains (with orientations)
+    bool reordered();
+    size_t original_index(int, size_t);
+    size_t reordered_index(int, size_t);
+    cell_t original_cell(cell_t);
+    cell_t reordered_cell(cell_t);
+    chain_v to_original_order(const chain_v&);
+    chain_v from_original_order(const chain_v&);
+    chain_t to_original_order(const chain_t&);
+    // batched update of the top cells, in place: the points are appended,
+    // then the removed cells (and the faces they leave without cofaces)
+    // become tombstones that keep their indices, and the inserted ones
+    // take back the index of their tombstone or are appended to their
+    // levels with their new faces. cells are given in the labels of the
+    // complex (see reordered_cell), new points get the next labels. the
+    // Hasse diagram and the boundary matrices (when built) are only
+    // patched around the changed cells, and the report lists them. throws
+    // std::runtime_error, with the complex unchanged, on cells that cannot
+    // be removed or inserted. needs exclusive access to the complex, views
+    // taken before are no longer valid and chains need the new level
+    // sizes. in the order of the complex built without reordering, new
+    // cells come after the others in the order they were added.
+    struct update_report {
+        size_t first_point;  // label of the first point added
+        // per level, the cells removed and the ones added (or restored)
+        std::vector<std::vector<size_t>> removed, added;
+    };
+    update_report update_cells(const std::vector<point_t>& points,
+                               const std::vector<cell_t>& removed,
+                               const std::vector<cell_t>& inserted);
+    // one flag per cell of level d, set on the tombstones, empty while the
+    // level has none
+    const std::vector<uint8_t>& tombstones(int d);
+    size_t num_tombstones(int d);
+    // drops the tombstones, the other cells keep their order: for every
+    // level the new index of each old one (no_index for tombstones). the
+    // points stay, those of removed vertices in no cell
+    static constexpr size_t no_index = size_t(-1);
+    std::vector<std::vector<size_t>> compact();
+    // bytes held per structure and level (derived structures once built)
+    memory_report get_memory_report();
 };  // class simplicial_complex
 };  // namespace gsimp
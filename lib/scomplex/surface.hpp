@@ -0,0 +1,523 @@
+#pragma once
+
+#include <scomplex/coeff_flow.hpp>
+#include <scomplex/memory.hpp>
+#include <scomplex/mesh_generator.hpp>
+#include <scomplex/metrics.hpp>
+#include <scomplex/simplicial_complex.hpp>
+#include <scomplex/types.hpp>
+#include <scomplex/workspace.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief a triangle mesh as a surface, straight from its face buffer: no
+ * simplex tree and no Hasse diagram
+ *
+ * on a surface every edge has at most two triangles, so each side of a
+ * triangle (a slot) keeps its edge, the sign of the edge in its boundary
+ * and its twin, the same edge in the other triangle. the edges are found in
+ * one pass over the triangles with a hash table, numbered in the order they
+ * first appear. coefficient flow walks the twins and shortest paths run
+ * over the 1-skeleton in compressed rows.
+ *
+ * orientations are those of simplicial_complex (triangles and edges by
+ * increasing vertex), so chains carry over through surface_link. a triangle
+ * repeated (with at most one other on an edge) throws std::runtime_error,
+ * see weld_mesh to drop them. an edge with three or more triangles
+ * is non-manifold: it is reported by non_manifold_edges, has no twins, and
+ * the flows refuse to run, such meshes take the generic path
+ * (simplicial_complex and coeff_flow). queries only read, they can run
+ * concurrently.
+ */
+class surface_mesh {
+    size_t dim;
+    std::vector<double> coordinates;  // dim per point
+    std::vector<size_t> triangles;    // three vertices each, increasing
+    // slot 3 t + j is the edge of triangle t without its j-th vertex
+    std::vector<size_t> slot_edge;
+    std::vector<int8_t> slot_sign;
+    std::vector<size_t> twin;  // no_index on boundary and non-manifold edges
+    // two vertices per edge, increasing, and their hash table (open
+    // addressing, edge indices, no_index where empty)
+    std::vector<size_t> edge_vertices;
+    std::vector<size_t> edge_table;
+    std::vector<double> edge_lengths;
+    // the neighbours of vertex v, with the edges to them:
+    // adjacency[offsets[v]] .. adjacency[offsets[v + 1] - 1]
+    std::vector<size_t> offsets;
+    std::vector<std::pair<size_t, size_t>> adjacency;
+    std::vector<simplicial_complex::boundary_facet> boundary;
+    std::vector<size_t> non_manifold;
+
+    void build(const size_t* cells, size_t num_triangles, size_t num_points);
+    size_t table_slot(size_t a, size_t b) const;
+
+   public:
+    static constexpr size_t no_index = size_t(-1);
+
+    explicit surface_mesh(const flat_mesh& mesh);
+    surface_mesh(const std::vector<point_t>& points,
+                 const std::vector<cell_t>& cells);
+
+    size_t num_points() const { return offsets.size() - 1; }
+    size_t num_edges() const { return edge_vertices.size() / 2; }
+    size_t num_triangles() const { return triangles.size() / 3; }
+    // the j-th vertex of triangle t, and of edge e
+    size_t triangle_vertex(size_t t, int j) const {
+        return triangles[3 * t + j];
+    }
+    size_t edge_vertex(size_t e, int j) const {
+        return edge_vertices[2 * e + j];
+    }
+    // the edge between the vertices a and b, no_index when there is none
+    size_t edge_index(size_t a, size_t b) const {
+        return edge_table[table_slot(std::min(a, b), std::max(a, b))];
+    }
+
+    bool is_manifold() const { return non_manifold.empty(); }
+    // the edges with three or more triangles, in increasing order
+    const std::vector<size_t>& non_manifold_edges() const {
+        return non_manifold;
+    }
+    // the edges with a single triangle (facet: edge, coface: triangle), in
+    // increasing order, empty when the surface is closed
+    const std::vector<simplicial_complex::boundary_facet>& boundary_edges()
+        const {
+        return boundary;
+    }
+
+    /*
+     * coefficient flow over the twins, from triangle t_0 with value c_0:
+     * out gets one entry per triangle, those of other connected components
+     * are zero. p has one entry per edge. the same checks and exceptions as
+     * gsimp::coeff_flow, it does not allocate once out and ws are large
+     * enough. throws std::runtime_error on non-manifold surfaces.
+     */
+    void coeff_flow(const std::vector<double>& p, size_t t_0, double c_0,
+                    std::vector<double>& out,
+                    workspace& ws = thread_workspace()) const;
+    // from the first boundary edge, out_of_context when closed
+    void coeff_flow_embedded(const std::vector<double>& p,
+                             std::vector<double>& out,
+                             workspace& ws = thread_workspace()) const;
+
+    // the vertices after s up to t of a shortest path along the edges,
+    // appended to out. throws when t cannot be reached from s
+    void shortest_path(size_t s, size_t t, std::vector<size_t>& out,
+                       workspace& ws = thread_workspace()) const;
+    // the way points joined by shortest paths, into out
+    void complete_path(const std::vector<size_t>& waypoints,
+                       std::vector<size_t>& out,
+                       workspace& ws = thread_workspace()) const;
+    // the 1-chain of a vertex path, one entry per edge. throws when two
+    // consecutive vertices share no edge
+    void path_chain(const std::vector<size_t>& vertices,
+                    std::vector<double>& chain) const;
+
+    memory_report get_memory_report() const {
+        memory_report report;
+        report.add("points", memory::vector_bytes(coordinates));
+        report.add("triangles", memory::vector_bytes(triangles) +
+                                    memory::vector_bytes(slot_edge) +
+                                    memory::vector_bytes(slot_sign) +
+                                    memory::vector_bytes(twin));
+        report.add("edges", memory::vector_bytes(edge_vertices) +
+                                memory::vector_bytes(edge_table) +
+                                memory::vector_bytes(edge_lengths) +
+                                memory::vector_bytes(boundary) +
+                                memory::vector_bytes(non_manifold));
+        report.add("skeleton", memory::vector_bytes(offsets) +
+                                   memory::vector_bytes(adjacency));
+        return report;
+    }
+};
+
+/**
+ * @brief the cells of a surface_mesh matched with those of a
+ * simplicial_complex built from the same triangles
+ *
+ * runs the flows of the complex on the surface: chains come and go in the
+ * indices and orientations of the complex (reordered or not), through the
+ * scratch space of the workspace. built on the complex as it is, before
+ * any update_cells. throws std::runtime_error when the two do not have the
+ * same edges and triangles (duplicate triangles, say).
+ */
+class surface_link {
+    std::shared_ptr<const surface_mesh> surface;
+    // per edge and top cell of the complex, its match on the surface and
+    // the sign between their orientations
+    std::vector<size_t> edge_of;
+    std::vector<int8_t> edge_sign;
+    std::vector<size_t> triangle_of;
+    std::vector<int8_t> triangle_sign;
+    simplicial_complex::boundary_facet start;
+
+   public:
+    surface_link(std::shared_ptr<const surface_mesh> surface,
+                 simplicial_complex& s_comp);
+
+    const surface_mesh& get_surface() const { return *surface; }
+
+    // as gsimp::coeff_flow and gsimp::coeff_flow_embedded on the complex
+    // (from its first boundary facet), with the same results
+    void coeff_flow(const chain_v& p, size_t sigma_0, double c_0,
+                    chain_v& out, workspace& ws = thread_workspace()) const;
+    void coeff_flow_embedded(const chain_v& p, chain_v& out,
+                             workspace& ws = thread_workspace()) const;
+};
+
+//---------------------------------------
+// implementation
+
+namespace surface_detail {
+
+inline uint64_t edge_hash(size_t a, size_t b) {
+    uint64_t h = uint64_t(a) * 0x9e3779b97f4a7c15ULL ^ uint64_t(b);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+};  // namespace surface_detail
+
+surface_mesh::surface_mesh(const flat_mesh& mesh) : dim(3) {
+    if (mesh.cell_size != 3)
+        throw std::runtime_error("a surface is made of triangles\n");
+    coordinates = mesh.coordinates;
+    build(mesh.cells.data(), mesh.num_cells(), mesh.num_points());
+}
+
+surface_mesh::surface_mesh(const std::vector<point_t>& points,
+                           const std::vector<cell_t>& cells)
+    : dim(points.empty() ? 0 : points[0].size()) {
+    coordinates.reserve(dim * points.size());
+    for (const point_t& pt : points) {
+        if (pt.size() != dim)
+            throw std::runtime_error("points of different dimensions\n");
+        coordinates.insert(coordinates.end(), pt.begin(), pt.end());
+    }
+    std::vector<size_t> flat;
+    flat.reserve(3 * cells.size());
+    for (const cell_t& cell : cells) {
+        if (cell.size() != 3)
+            throw std::runtime_error("a surface is made of triangles\n");
+        flat.insert(flat.end(), cell.begin(), cell.end());
+    }
+    build(flat.data(), cells.size(), points.size());
+}
+
+size_t surface_mesh::table_slot(size_t a, size_t b) const {
+    size_t mask = edge_table.size() - 1;
+    size_t slot = surface_detail::edge_hash(a, b) & mask;
+    while (edge_table[slot] != no_index &&
+           (edge_vertices[2 * edge_table[slot]] != a ||
+            edge_vertices[2 * edge_table[slot] + 1] != b))
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+void surface_mesh::build(const size_t* cells, size_t num_triangles,
+                         size_t num_points) {
+    GSIMP_PHASE("surface");
+    size_t capacity = 16;
+    while (capacity < 4 * num_triangles) capacity *= 2;
+    edge_table.assign(capacity, no_index);
+    edge_vertices.reserve(3 * num_triangles);
+    triangles.resize(3 * num_triangles);
+    slot_edge.resize(3 * num_triangles);
+    slot_sign.resize(3 * num_triangles);
+    twin.assign(3 * num_triangles, no_index);
+    // per edge, its first slot and the number of triangles on it
+    std::vector<size_t> first_slot;
+    std::vector<uint32_t> count;
+    first_slot.reserve(3 * num_triangles);
+    count.reserve(3 * num_triangles);
+
+    // the same triangle twice is no surface around their edges (on a
+    // manifold edge it would pass for its own twin)
+    auto refuse_repeated = [&](size_t t, size_t other) {
+        if (std::equal(&triangles[3 * t], &triangles[3 * t + 3],
+                       &triangles[3 * other]))
+            throw std::runtime_error("triangles " + std::to_string(other) +
+                                     " and " + std::to_string(t) +
+                                     " are the same\n");
+    };
+
+    for (size_t t = 0; t < num_triangles; ++t) {
+        size_t* v = &triangles[3 * t];
+        std::copy(cells + 3 * t, cells + 3 * t + 3, v);
+        std::sort(v, v + 3);
+        if (v[2] >= num_points)
+            throw std::runtime_error("triangle " + std::to_string(t) +
+                                     " has a vertex that is not a point\n");
+        if (v[0] == v[1] || v[1] == v[2])
+            throw std::runtime_error("triangle " + std::to_string(t) +
+                                     " has a repeated vertex\n");
+        for (int j = 0; j < 3; ++j) {
+            size_t a = v[j == 0 ? 1 : 0], b = v[j == 2 ? 1 : 2];
+            size_t slot = 3 * t + j;
+            size_t& entry = edge_table[table_slot(a, b)];
+            slot_sign[slot] = j == 1 ? -1 : 1;
+            if (entry == no_index) {
+                entry = first_slot.size();
+                edge_vertices.push_back(a);
+                edge_vertices.push_back(b);
+                first_slot.push_back(slot);
+                count.push_back(1);
+            } else if (++count[entry] == 2) {
+                refuse_repeated(t, first_slot[entry] / 3);
+                twin[slot] = first_slot[entry];
+                twin[first_slot[entry]] = slot;
+            } else if (count[entry] == 3) {
+                refuse_repeated(t, first_slot[entry] / 3);
+                refuse_repeated(t, twin[first_slot[entry]] / 3);
+                // the first two triangles on the edge are no twins
+                twin[twin[first_slot[entry]]] = no_index;
+                twin[first_slot[entry]] = no_index;
+            }
+            slot_edge[slot] = entry;
+        }
+    }
+
+    size_t num_edges = first_slot.size();
+    for (size_t e = 0; e < num_edges; ++e) {
+        if (count[e] == 1)
+            boundary.push_back(
+                {e, first_slot[e] / 3, slot_sign[first_slot[e]]});
+        else if (count[e] > 2)
+            non_manifold.push_back(e);
+    }
+    GSIMP_COUNT("surface.edges", num_edges);
+    GSIMP_COUNT("surface.non_manifold_edges", non_manifold.size());
+
+    // the 1-skeleton, each vertex with its edges in increasing order
+    edge_lengths.resize(num_edges);
+    offsets.assign(num_points + 1, 0);
+    for (size_t e = 0; e < num_edges; ++e) {
+        const double* p = &coordinates[dim * edge_vertices[2 * e]];
+        const double* q = &coordinates[dim * edge_vertices[2 * e + 1]];
+        double norm = 0;
+        for (size_t k = 0; k < dim; ++k) norm += (p[k] - q[k]) * (p[k] - q[k]);
+        edge_lengths[e] = std::sqrt(norm);
+        offsets[edge_vertices[2 * e] + 1]++;
+        offsets[edge_vertices[2 * e + 1] + 1]++;
+    }
+    for (size_t v = 0; v < num_points; ++v) offsets[v + 1] += offsets[v];
+    adjacency.resize(offsets[num_points]);
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t e = 0; e < num_edges; ++e) {
+        size_t a = edge_vertices[2 * e], b = edge_vertices[2 * e + 1];
+        adjacency[next[a]++] = {b, e};
+        adjacency[next[b]++] = {a, e};
+    }
+}
+
+void surface_mesh::coeff_flow(const std::vector<double>& p, size_t t_0,
+                              double c_0, std::vector<double>& out,
+                              workspace& ws) const {
+    GSIMP_PHASE("surface_flow");
+    if (p.size() != num_edges() || t_0 >= num_triangles())
+        throw out_of_context();
+    if (!is_manifold())
+        throw std::runtime_error("the surface has " +
+                                 std::to_string(non_manifold.size()) +
+                                 " non-manifold edges\n");
+    size_t num_sigmas = num_triangles();
+    out.assign(num_sigmas, 0);
+    ws.seen_cells.reset(num_sigmas);
+    ws.seen_faces.reset(p.size());
+    fifo<size_t>& queue = ws.cell_queue;
+    queue.clear();
+
+    ws.seen_cells.set(t_0);
+    out[t_0] = c_0;
+    queue.push(t_0);
+    size_t seen_sigmas = 1;
+    while (!queue.empty()) {
+        size_t t = queue.front();
+        queue.pop();
+        for (size_t slot = 3 * t; slot < 3 * t + 3; ++slot) {
+            size_t e = slot_edge[slot];
+            if (ws.seen_faces.test(e)) continue;
+            ws.seen_faces.set(e);
+            double predicted_bdry = slot_sign[slot] * out[t];
+            size_t other = twin[slot];
+            if (other == no_index) {
+                // t is the only triangle on e
+                if (predicted_bdry != p[e]) throw no_bounding_chain();
+                continue;
+            }
+            size_t t_p = other / 3;
+            double c_p = slot_sign[other] * (p[e] - predicted_bdry);
+            if (ws.seen_cells.test(t_p)) {
+                // found local incoherence
+                if (out[t_p] != c_p) throw no_bounding_chain();
+            } else {
+                ws.seen_cells.set(t_p);
+                out[t_p] = c_p;
+                queue.push(t_p);
+                seen_sigmas++;
+            }
+        }
+    }
+    GSIMP_COUNT("surface_flow.seen_sigmas", seen_sigmas);
+}
+
+void surface_mesh::coeff_flow_embedded(const std::vector<double>& p,
+                                       std::vector<double>& out,
+                                       workspace& ws) const {
+    if (boundary.empty() || p.size() != num_edges()) throw out_of_context();
+    const simplicial_complex::boundary_facet& f = boundary.front();
+    coeff_flow(p, f.coface, f.sign * p[f.facet], out, ws);
+}
+
+void surface_mesh::shortest_path(size_t s, size_t t, std::vector<size_t>& out,
+                                 workspace& ws) const {
+    if (s == t) return;
+    size_t n = num_points();
+    ws.reached.reset(n);
+    if (ws.distance.size() < n) {
+        ws.distance.resize(n);
+        ws.predecessor.resize(n);
+    }
+    auto& heap = ws.heap;  // (distance, vertex), closest on top
+    auto closer = std::greater<std::pair<double, size_t>>();
+    heap.clear();
+
+    ws.reached.set(s);
+    ws.distance[s] = 0;
+    heap.emplace_back(0.0, s);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), closer);
+        std::pair<double, size_t> top = heap.back();
+        heap.pop_back();
+        size_t v = top.second;
+        if (top.first > ws.distance[v]) continue;  // already settled closer
+        if (v == t) break;
+        for (size_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+            size_t w = adjacency[k].first;
+            double dist = top.first + edge_lengths[adjacency[k].second];
+            if (ws.reached.test(w) && ws.distance[w] <= dist) continue;
+            ws.reached.set(w);
+            ws.distance[w] = dist;
+            ws.predecessor[w] = v;
+            heap.emplace_back(dist, w);
+            std::push_heap(heap.begin(), heap.end(), closer);
+        }
+    }
+    if (!ws.reached.test(t))
+        throw std::runtime_error("no path between the vertices " +
+                                 std::to_string(s) + " and " +
+                                 std::to_string(t) + "\n");
+
+    size_t first = out.size();
+    for (size_t v = t; v != s; v = ws.predecessor[v]) out.push_back(v);
+    std::reverse(out.begin() + first, out.end());
+}
+
+void surface_mesh::complete_path(const std::vector<size_t>& waypoints,
+                                 std::vector<size_t>& out,
+                                 workspace& ws) const {
+    out.clear();
+    if (waypoints.empty()) return;
+    out.push_back(waypoints.front());
+    for (size_t i = 1; i < waypoints.size(); ++i)
+        shortest_path(waypoints[i - 1], waypoints[i], out, ws);
+}
+
+void surface_mesh::path_chain(const std::vector<size_t>& vertices,
+                              std::vector<double>& chain) const {
+    chain.assign(num_edges(), 0);
+    for (size_t i = 0; i + 1 < vertices.size(); ++i) {
+        size_t a = vertices[i], b = vertices[i + 1];
+        size_t e = a < num_points() && b < num_points() ? edge_index(a, b)
+                                                        : no_index;
+        if (e == no_index)
+            throw std::runtime_error("no edge between the vertices " +
+                                     std::to_string(a) + " and " +
+                                     std::to_string(b) + "\n");
+        chain[e] += a < b ? 1 : -1;
+    }
+}
+
+surface_link::surface_link(std::shared_ptr<const surface_mesh> surface_,
+                           simplicial_complex& s_comp)
+    : surface(std::move(surface_)),
+      start{surface_mesh::no_index, surface_mesh::no_index, 0} {
+    if (s_comp.dimension() != 2 ||
+        size_t(s_comp.get_level_size(1)) != surface->num_edges() ||
+        size_t(s_comp.get_level_size(2)) != surface->num_triangles())
+        throw std::runtime_error("the complex and the surface do not have "
+                                 "the same cells\n");
+    // a cell of the surface in the labels of the complex: its index there
+    // and the parity of the labels (in increasing order on the surface)
+    auto match = [&](cell_t cell, size_t& index, int8_t& sign) {
+        cell = s_comp.reordered_cell(cell);
+        sign = 1;
+        for (size_t a = 0; a < cell.size(); ++a)
+            for (size_t b = 0; b < a; ++b)
+                if (cell[b] > cell[a]) sign = -sign;
+        index = s_comp.cell_to_index(cell);
+    };
+    size_t sigma;
+    int8_t sign;
+    edge_of.resize(surface->num_edges());
+    edge_sign.resize(surface->num_edges());
+    for (size_t e = 0; e < surface->num_edges(); ++e) {
+        match({surface->edge_vertex(e, 0), surface->edge_vertex(e, 1)},
+              sigma, sign);
+        edge_of[sigma] = e;
+        edge_sign[sigma] = sign;
+    }
+    triangle_of.resize(surface->num_triangles());
+    triangle_sign.resize(surface->num_triangles());
+    for (size_t t = 0; t < surface->num_triangles(); ++t) {
+        match({surface->triangle_vertex(t, 0), surface->triangle_vertex(t, 1),
+               surface->triangle_vertex(t, 2)},
+              sigma, sign);
+        triangle_of[sigma] = t;
+        triangle_sign[sigma] = sign;
+    }
+    if (!s_comp.boundary_facets().empty())
+        start = s_comp.boundary_facets().front();
+}
+
+void surface_link::coeff_flow(const chain_v& p, size_t sigma_0, double c_0,
+                              chain_v& out, workspace& ws) const {
+    if (p.first != 1 || p.second.size() != edge_of.size() ||
+        sigma_0 >= triangle_of.size())
+        throw out_of_context();
+    std::vector<double>& cycle = ws.surface_cycle;
+    std::vector<double>& chain = ws.surface_chain;
+    cycle.assign(edge_of.size(), 0);
+    for (size_t tau = 0; tau < p.second.size(); ++tau)
+        if (p.second[tau] != 0)
+            cycle[edge_of[tau]] = edge_sign[tau] * p.second[tau];
+    surface->coeff_flow(cycle, triangle_of[sigma_0],
+                        triangle_sign[sigma_0] * c_0, chain, ws);
+    out.first = 2;
+    out.second.resize(triangle_of.size());
+    for (size_t sigma = 0; sigma < triangle_of.size(); ++sigma)
+        out.second[sigma] = triangle_sign[sigma] * chain[triangle_of[sigma]];
+}
+
+void surface_link::coeff_flow_embedded(const chain_v& p, chain_v& out,
+                                       workspace& ws) const {
+    if (start.facet == surface_mesh::no_index ||
+        p.second.size() != edge_of.size())
+        throw out_of_context();
+    coeff_flow(p, start.coface, start.sign * p.second[start.facet], out, ws);
+}
+
+};  // namespace gsimp
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief fixed size pool of worker threads fed from a single task queue
+ *
+ * tasks must not wait on other tasks of the same pool (e.g. calling
+ * parallel_for from inside a task), they could end up waiting for
+ * themselves.
+ */
+class thread_pool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable has_tasks;
+    bool stopping{false};
+
+    void work() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                has_tasks.wait(lock,
+                               [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+   public:
+    // 0 threads means one per hardware thread
+    explicit thread_pool(size_t num_threads = 0) {
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < num_threads; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // finishes the queued tasks before joining
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        has_tasks.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    size_t size() const { return workers.size(); }
+
+    template <typename F>
+    auto submit(F&& f) -> std::future<decltype(f())> {
+        typedef decltype(f()) result_t;
+        auto task =
+            std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(f));
+        std::future<result_t> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            tasks.emplace([task] { (*task)(); });
+        }
+        has_tasks.notify_one();
+        return result;
+    }
+};
+
+/**
+ * @brief run fn(i) for i in [0, n) on the pool and wait for all of them
+ *
+ * indices are handed out dynamically, so uneven work balances itself. the
+ * first exception thrown by fn is rethrown here (after every task stopped).
+ */
+template <typename F>
+void parallel_for(thread_pool& pool, size_t n, F fn) {
+    if (n == 0) return;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_mtx;
+
+    auto run = [&] {
+        for (size_t i = next++; i < n && !failed; i = next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mtx);
+                if (!failed) error = std::current_exception();
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::future<void>> running;
+    size_t num_tasks = std::min(n, pool.size());
+    for (size_t t = 0; t < num_tasks; ++t) running.push_back(pool.submit(run));
+    for (auto& task : running) task.get();
+    if (error) std::rethrow_exception(error);
+}
+
+/**
+ * @brief sort v with one std::sort per thread of the pool on contiguous
+ * ranges, then merge the sorted ranges pairwise, every merge of a round in
+ * parallel. short vectors are sorted in place.
+ */
+template <typename T, typename Less>
+void parallel_sort(thread_pool& pool, std::vector<T>& v, Less less) {
+    size_t n = v.size(), num_parts = std::max<size_t>(1, pool.size());
+    if (num_parts == 1 || n < (size_t(1) << 14)) {
+        std::sort(v.begin(), v.end(), less);
+        return;
+    }
+    size_t part_size = (n + num_parts - 1) / num_parts;
+    parallel_for(pool, num_parts, [&](size_t part) {
+        size_t lo = std::min(n, part * part_size);
+        std::sort(v.begin() + lo, v.begin() + std::min(n, lo + part_size),
+                  less);
+    });
+    for (size_t width = part_size; width < n; width *= 2) {
+        parallel_for(pool, (n + 2 * width - 1) / (2 * width), [&](size_t k) {
+            size_t lo = 2 * width * k;
+            size_t mid = std::min(n, lo + width);
+            std::inplace_merge(v.begin() + lo, v.begin() + mid,
+                               v.begin() + std::min(n, mid + width), less);
+        });
+    }
+}
+
+};  // namespace gsimp
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <scomplex/thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief union find over 0 .. n - 1 that the threads of a pool can share
+ * without locks
+ *
+ * a root is always linked under the lower of the two roots, so parents
+ * only ever decrease and every set ends up with its lowest element as root,
+ * whatever the schedule.
+ */
+class concurrent_union_find {
+    std::vector<std::atomic<size_t>> parent;
+
+   public:
+    concurrent_union_find(size_t n, thread_pool& pool) : parent(n) {
+        size_t num_parts = std::max<size_t>(1, pool.size());
+        size_t part_size = (n + num_parts - 1) / num_parts;
+        parallel_for(pool, num_parts, [&](size_t part) {
+            size_t lo = std::min(n, part * part_size);
+            size_t hi = std::min(n, lo + part_size);
+            for (size_t x = lo; x < hi; ++x)
+                parent[x].store(x, std::memory_order_relaxed);
+        });
+    }
+
+    size_t size() const { return parent.size(); }
+
+    size_t find(size_t x) {
+        for (;;) {
+            size_t p = parent[x].load(std::memory_order_relaxed);
+            if (p == x) return x;
+            size_t gp = parent[p].load(std::memory_order_relaxed);
+            // path halving, lost races leave a parent that is still valid
+            if (gp != p) parent[x].compare_exchange_weak(p, gp);
+            x = gp;
+        }
+    }
+
+    void unite(size_t a, size_t b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return;
+            if (a < b) std::swap(a, b);
+            size_t root = a;
+            if (parent[a].compare_exchange_strong(root, b)) return;
+        }
+    }
+};
+
+};  // namespace gsimp
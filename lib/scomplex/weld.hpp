@@ -0,0 +1,266 @@
+#pragma once
+
+#include <scomplex/mesh_generator.hpp>
+#include <scomplex/metrics.hpp>
+#include <scomplex/thread_pool.hpp>
+#include <scomplex/types.hpp>
+#include <scomplex/union_find.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief ingestion stage for scanned meshes: points within a tolerance of
+ * each other are welded into one, then the cells left with a repeated
+ * vertex (degenerate) and the cells on the same vertices as an earlier one
+ * (duplicates) are dropped
+ *
+ * obj and ply scans often repeat a vertex for every face around it, or a
+ * face, and the complex built from them falls apart with boundary facets
+ * everywhere. points are binned in a hash grid of side the tolerance and
+ * compared with the points of the 27 bins around them, close ones joined by
+ * a union find shared by the threads of the pool, so welding is transitive
+ * (a chain of close points becomes one point). a welded point keeps the
+ * coordinates of its lowest point, points and cells keep their order and
+ * cells their orientation. a zero tolerance only welds points with equal
+ * coordinates. bins and duplicate cells are found by sorting flat buffers
+ * (see parallel_sort), in place in the mesh. throws std::runtime_error,
+ * with the mesh unchanged, on a cell vertex that is not a point.
+ */
+struct weld_report {
+    size_t welded_points = 0;  // points merged into an earlier one
+    size_t degenerate_cells = 0;
+    size_t duplicate_cells = 0;
+    // the new index of each old point
+    std::vector<size_t> point_map;
+};
+
+namespace weld_detail {
+
+inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+inline uint64_t bin_key(const int64_t* bin) {
+    uint64_t h = 0;
+    for (int a = 0; a < 3; ++a) h = mix(h ^ uint64_t(bin[a]));
+    return h;
+}
+
+// ranks of the kept entries in order, by part: counts, offsets, ranks
+inline size_t number_kept(thread_pool& pool, const std::vector<uint8_t>& keep,
+                          std::vector<size_t>& rank) {
+    size_t n = keep.size(), num_parts = std::max<size_t>(1, pool.size());
+    size_t part_size = (n + num_parts - 1) / num_parts;
+    std::vector<size_t> first(num_parts + 1, 0);
+    rank.resize(n);
+    parallel_for(pool, num_parts, [&](size_t part) {
+        size_t lo = std::min(n, part * part_size);
+        size_t hi = std::min(n, lo + part_size);
+        for (size_t i = lo; i < hi; ++i) first[part + 1] += keep[i];
+    });
+    for (size_t part = 0; part < num_parts; ++part)
+        first[part + 1] += first[part];
+    parallel_for(pool, num_parts, [&](size_t part) {
+        size_t lo = std::min(n, part * part_size);
+        size_t hi = std::min(n, lo + part_size);
+        for (size_t i = lo, next = first[part]; i < hi; ++i)
+            rank[i] = keep[i] ? next++ : next;
+    });
+    return first[num_parts];
+}
+
+};  // namespace weld_detail
+
+weld_report weld_mesh(flat_mesh& mesh, double tolerance, thread_pool& pool) {
+    GSIMP_PHASE("weld");
+    if (!(tolerance >= 0))
+        throw std::runtime_error("the weld tolerance must not be negative\n");
+    using namespace weld_detail;
+    weld_report report;
+    size_t n = mesh.num_points(), k = mesh.cell_size, m = mesh.num_cells();
+    // the mesh is left as it was on bad cells
+    for (size_t v : mesh.cells)
+        if (v >= n)
+            throw std::runtime_error("a cell has a vertex that is not a "
+                                     "point of the mesh\n");
+    size_t num_parts = std::max<size_t>(1, pool.size());
+    auto range = [&](size_t part, size_t size) {
+        size_t part_size = (size + num_parts - 1) / num_parts;
+        return std::make_pair(std::min(size, part * part_size),
+                              std::min(size, (part + 1) * part_size));
+    };
+    const double* xyz = mesh.coordinates.data();
+
+    // the bin of each point: its grid cell, or (zero tolerance) its
+    // coordinates bit for bit
+    std::vector<int64_t> bins(3 * n);
+    std::vector<std::pair<uint64_t, size_t>> sorted(n);
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, n);
+        for (size_t i = r.first; i < r.second; ++i) {
+            for (int a = 0; a < 3; ++a) {
+                double x = xyz[3 * i + a];
+                if (tolerance > 0) {
+                    bins[3 * i + a] = int64_t(std::floor(x / tolerance));
+                } else {
+                    x += 0.0;  // -0 and 0 are the same point
+                    std::memcpy(&bins[3 * i + a], &x, sizeof(x));
+                }
+            }
+            sorted[i] = {bin_key(&bins[3 * i]), i};
+        }
+    });
+    parallel_sort(pool, sorted,
+                  [](const std::pair<uint64_t, size_t>& a,
+                     const std::pair<uint64_t, size_t>& b) { return a < b; });
+
+    // each point against the lower points of the bins around it (keys that
+    // collide only cost a comparison)
+    concurrent_union_find sets(n, pool);
+    const double tol2 = tolerance * tolerance;
+    const int reach = tolerance > 0 ? 1 : 0;
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, n);
+        int64_t near[3];
+        for (size_t i = r.first; i < r.second; ++i) {
+            const double* p = xyz + 3 * i;
+            for (int dx = -reach; dx <= reach; ++dx)
+                for (int dy = -reach; dy <= reach; ++dy)
+                    for (int dz = -reach; dz <= reach; ++dz) {
+                        near[0] = bins[3 * i] + dx;
+                        near[1] = bins[3 * i + 1] + dy;
+                        near[2] = bins[3 * i + 2] + dz;
+                        uint64_t key = bin_key(near);
+                        auto it = std::lower_bound(
+                            sorted.begin(), sorted.end(),
+                            std::make_pair(key, size_t(0)));
+                        for (; it != sorted.end() && it->first == key &&
+                               it->second < i;
+                             ++it) {
+                            const double* q = xyz + 3 * it->second;
+                            double dist = 0;
+                            for (int a = 0; a < 3; ++a)
+                                dist += (p[a] - q[a]) * (p[a] - q[a]);
+                            if (dist <= tol2) sets.unite(i, it->second);
+                        }
+                    }
+        }
+    });
+
+    // roots (the lowest point of each set) are kept, in order
+    std::vector<uint8_t> keep(n);
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, n);
+        for (size_t i = r.first; i < r.second; ++i)
+            keep[i] = sets.find(i) == i;
+    });
+    std::vector<size_t> rank;
+    size_t num_kept = number_kept(pool, keep, rank);
+    report.welded_points = n - num_kept;
+    report.point_map.resize(n);
+    std::vector<double> coordinates(3 * num_kept);
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, n);
+        for (size_t i = r.first; i < r.second; ++i) {
+            report.point_map[i] = rank[sets.find(i)];
+            if (keep[i])
+                std::copy(xyz + 3 * i, xyz + 3 * i + 3,
+                          &coordinates[3 * rank[i]]);
+        }
+    });
+    mesh.coordinates.swap(coordinates);
+
+    // cells on the welded points, each with a sorted copy of its vertices
+    // to find the degenerate ones and sort the others by
+    std::vector<size_t> sorted_cells(m * k);
+    keep.assign(m, 1);
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, m);
+        for (size_t c = r.first; c < r.second; ++c) {
+            size_t* cell = &mesh.cells[c * k];
+            size_t* key = &sorted_cells[c * k];
+            for (size_t j = 0; j < k; ++j) {
+                cell[j] = report.point_map[cell[j]];
+                key[j] = cell[j];
+            }
+            std::sort(key, key + k);
+            if (std::adjacent_find(key, key + k) != key + k) keep[c] = 0;
+        }
+    });
+    std::vector<size_t> order;
+    order.reserve(m);
+    for (size_t c = 0; c < m; ++c)
+        if (keep[c]) order.push_back(c);
+    report.degenerate_cells = m - order.size();
+    auto key_less = [&](size_t a, size_t b) {
+        const size_t* key_a = &sorted_cells[a * k];
+        const size_t* key_b = &sorted_cells[b * k];
+        for (size_t j = 0; j < k; ++j)
+            if (key_a[j] != key_b[j]) return key_a[j] < key_b[j];
+        return a < b;
+    };
+    parallel_sort(pool, order, key_less);
+    // in a run of equal cells the first (lowest) one is kept
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, order.size());
+        for (size_t i = std::max<size_t>(1, r.first); i < r.second; ++i)
+            if (std::equal(&sorted_cells[order[i] * k],
+                           &sorted_cells[order[i] * k] + k,
+                           &sorted_cells[order[i - 1] * k]))
+                keep[order[i]] = 0;
+    });
+    size_t num_cells = number_kept(pool, keep, rank);
+    report.duplicate_cells = order.size() - num_cells;
+    std::vector<size_t> cells(num_cells * k);
+    parallel_for(pool, num_parts, [&](size_t part) {
+        auto r = range(part, m);
+        for (size_t c = r.first; c < r.second; ++c)
+            if (keep[c])
+                std::copy(&mesh.cells[c * k], &mesh.cells[c * k] + k,
+                          &cells[rank[c] * k]);
+    });
+    mesh.cells.swap(cells);
+
+    GSIMP_COUNT("weld.points", report.welded_points);
+    GSIMP_COUNT("weld.degenerate_cells", report.degenerate_cells);
+    GSIMP_COUNT("weld.duplicate_cells", report.duplicate_cells);
+    return report;
+}
+
+// the same on the point and cell vectors the simplicial_complex
+// constructor takes (points with three coordinates, cells of one size)
+weld_report weld_mesh(std::vector<point_t>& points, std::vector<cell_t>& cells,
+                      double tolerance, thread_pool& pool) {
+    flat_mesh mesh;
+    mesh.cell_size = cells.empty() ? 0 : cells[0].size();
+    mesh.coordinates.reserve(3 * points.size());
+    for (const point_t& pt : points) {
+        if (pt.size() != 3)
+            throw std::runtime_error("welding takes points in 3D\n");
+        mesh.coordinates.insert(mesh.coordinates.end(), pt.begin(), pt.end());
+    }
+    mesh.cells.reserve(mesh.cell_size * cells.size());
+    for (const cell_t& cell : cells) {
+        if (cell.size() != mesh.cell_size)
+            throw std::runtime_error("welding takes cells of one size\n");
+        mesh.cells.insert(mesh.cells.end(), cell.begin(), cell.end());
+    }
+    weld_report report = weld_mesh(mesh, tolerance, pool);
+    auto input = complex_input(mesh);
+    points.swap(input.first);
+    cells.swap(input.second);
+    return report;
+}
+
+};  // namespace gsimp
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace gsimp {
+
+/**
+ * @brief set of flags over 0..n-1 that is cleared in constant time
+ *
+ * a flag is set when its stamp equals the current epoch, reset() just moves
+ * to the next epoch (the stamps are only rewritten when it wraps around).
+ */
+class marks {
+    std::vector<uint32_t> stamps;
+    uint32_t epoch = 0;
+
+   public:
+    // clears every flag, n is the number of flags needed from now on
+    void reset(size_t n) {
+        if (stamps.size() < n) stamps.resize(n, 0);
+        if (++epoch == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    bool test(size_t i) const { return stamps[i] == epoch; }
+    void set(size_t i) { stamps[i] = epoch; }
+};
+
+/**
+ * @brief first in first out queue over a vector
+ *
+ * popped items are only reclaimed by clear(), so the storage of one query
+ * is reused by the next.
+ */
+template <typename T>
+class fifo {
+    std::vector<T> items;
+    size_t head = 0;
+
+   public:
+    void clear() {
+        items.clear();
+        head = 0;
+    }
+
+    bool empty() const { return head == items.size(); }
+    size_t size() const { return items.size() - head; }
+    void push(const T& item) { items.push_back(item); }
+    const T& front() const { return items[head]; }
+    void pop() { ++head; }
+};
+
+// an entry of the coefficient flow: the value c of sigma reaching its
+// facet tau, sign is the incidence of tau in sigma
+struct flow_item {
+    size_t sigma;
+    size_t tau;
+    int sign;
+    double c;
+};
+
+/**
+ * @brief one side of a local coefficient flow
+ *
+ * the cells it reached with their coefficients (the others are taken to be
+ * zero), the ones still to expand, and whether it ran into a contradiction.
+ */
+struct flood_side {
+    marks seen;
+    std::vector<double> value;
+    fifo<size_t> queue;
+    std::vector<size_t> cells;
+    bool failed = false;
+
+    void reset(size_t n) {
+        seen.reset(n);
+        if (value.size() < n) value.resize(n);
+        queue.clear();
+        cells.clear();
+        failed = false;
+    }
+
+    void visit(size_t cell, double c) {
+        seen.set(cell);
+        value[cell] = c;
+        cells.push_back(cell);
+        queue.push(cell);
+    }
+};
+
+/**
+ * @brief scratch space of the queries
+ *
+ * it grows to the largest query it served and is then reused, a steady
+ * stream of queries runs without heap allocations. not shared between
+ * threads, thread_workspace() gives each thread its own.
+ */
+struct workspace {
+    // coefficient flow
+    marks seen_cells;
+    marks seen_faces;
+    fifo<flow_item> flow_queue;
+    // the same over a ring, the cells whose facets are still to visit
+    fifo<size_t> cell_queue;
+
+    // local coefficient flow: the cycle by facet, the facets already
+    // bounded, the cells settled and the two sides of the component being
+    // flooded
+    marks on_cycle;
+    std::vector<double> cycle_value;
+    marks bounded;
+    std::vector<std::pair<size_t, double>> settled_cells;
+    flood_side sides[2];
+
+    // boundary of a sparse chain, and its pairings with the cocycles
+    marks in_boundary;
+    std::vector<double> boundary_value;
+    std::vector<size_t> boundary_cells;
+    std::vector<double> pairings;
+
+    // shortest paths on the 1-skeleton
+    marks reached;
+    std::vector<double> distance;
+    std::vector<size_t> predecessor;
+    std::vector<std::pair<double, size_t>> heap;
+
+    // snapping
+    std::vector<size_t> waypoints;
+
+    // the chains of a flow on a surface (see surface_link)
+    std::vector<double> surface_cycle;
+    std::vector<double> surface_chain;
+};
+
+inline workspace& thread_workspace() {
+    static thread_local workspace ws;
+    return ws;
+}
+
+};  // namespace gsimp
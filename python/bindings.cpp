@@ -1,23 +1,304 @@
 #include <vector>
 
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 
+#include "scomplex/chain_calc.hpp"
 #include "scomplex/coeff_flow.hpp"
+#include "scomplex/path_snapper.hpp"
 #include "scomplex/simplicial_complex.hpp"
+#include "scomplex/thread_pool.hpp"
 #include "scomplex/types.hpp"
 
 using namespace gsimp;
 
 namespace py = pybind11;
 
+// c-contiguous arrays, anything else (lists, other dtypes) gets converted
+typedef py::array_t< double, py::array::c_style | py::array::forcecast >
+    double_array;
+typedef py::array_t< int64_t, py::array::c_style | py::array::forcecast >
+    index_array;
+
+// take ownership of a vector and expose it as a numpy array without copying
+template < typename T >
+py::array_t< T > to_array(std::vector< T >&& vec,
+                          std::vector< py::ssize_t > shape) {
+    auto data = new std::vector< T >(std::move(vec));
+    py::capsule owner(data, [](void* v) {
+        delete reinterpret_cast< std::vector< T >* >(v);
+    });
+    return py::array_t< T >(shape, data->data(), owner);
+}
+
+std::vector< cell_t > cells_from_array(const index_array& cells) {
+    if (cells.ndim() != 2)
+        throw std::invalid_argument("cells must be an (M, k) array");
+    const size_t n_cells = cells.shape(0), k = cells.shape(1);
+    const int64_t* data = cells.data();
+    std::vector< cell_t > cells_v(n_cells);
+    for (size_t i = 0; i < n_cells; ++i)
+        cells_v[i].assign(data + i * k, data + (i + 1) * k);
+    return cells_v;
+}
+
+std::vector< point_t > points_from_array(const double_array& points) {
+    if (points.ndim() != 2)
+        throw std::invalid_argument("points must be an (N, dim) array");
+    const size_t n_points = points.shape(0), dim = points.shape(1);
+    const double* data = points.data();
+    std::vector< point_t > points_v(n_points);
+    for (size_t i = 0; i < n_points; ++i)
+        points_v[i].assign(data + i * dim, data + (i + 1) * dim);
+    return points_v;
+}
+
+// chains are (dimension, 1-d array of coefficients) pairs on the python side
+chain_v chain_from_python(py::tuple chain) {
+    int d = chain[0].cast< int >();
+    double_array coeffs = chain[1].cast< double_array >();
+    if (coeffs.ndim() != 1)
+        throw std::invalid_argument("chain coefficients must be a 1-d array");
+    const double* data = coeffs.data();
+    return chain_v(d, std::vector< double >(data, data + coeffs.shape(0)));
+}
+
+py::tuple chain_to_python(chain_v&& chain) {
+    auto& rep = chain_rep_v(chain);
+    py::ssize_t size = rep.size();
+    return py::make_tuple(chain_dim(chain), to_array(std::move(rep), {size}));
+}
+
+chain_t sparse_chain(chain_v& chain) {
+    auto& rep = chain_rep_v(chain);
+    vector_t sparse(rep.size());
+    for (size_t i = 0; i < rep.size(); ++i)
+        if (rep[i] != 0) sparse.insertBack(i) = rep[i];
+    return chain_t(chain_dim(chain), sparse);
+}
+
+chain_v dense_chain(chain_t& chain) {
+    std::vector< double > rep(chain_size(chain), 0);
+    for (vector_t::InnerIterator it(chain_rep(chain)); it; ++it)
+        rep[it.index()] = it.value();
+    return chain_v(chain_dim(chain), rep);
+}
+
+// pool shared by the batch entry points of every object in the module
+thread_pool& batch_pool() {
+    static thread_pool pool;
+    return pool;
+}
+
+std::shared_ptr< simplicial_complex > make_complex(
+    std::vector< point_t >&& points, std::vector< cell_t >&& cells) {
+    auto s_comp = std::make_shared< simplicial_complex >(points, cells);
+    // build the derived structures up front so queries only read the complex
+    s_comp->prepare();
+    return s_comp;
+}
+
 PYBIND11_MODULE(coeffflow, m) {
-    py::class_< simplicial_complex >(m, "simplicial_complex")      //
-        .def(py::init< std::vector< cell_t >& >())                 //
-        .def("cell_to_index", &simplicial_complex::cell_to_index)  //
+    static py::exception< no_bounding_chain > no_bounding_chain_error(
+        m, "NoBoundingChain");
+    static py::exception< out_of_context > out_of_context_error(
+        m, "OutOfContext");
+    py::register_exception_translator([](std::exception_ptr p) {
+        try {
+            if (p) std::rethrow_exception(p);
+        } catch (const no_bounding_chain&) {
+            no_bounding_chain_error("the chain is not a boundary");
+        } catch (const out_of_context&) {
+            out_of_context_error("the chain does not fit the complex");
+        } catch (const non_zero_chain&) {
+            no_bounding_chain_error("the chain is not a boundary");
+        }
+    });
+
+    py::class_< simplicial_complex, std::shared_ptr< simplicial_complex > >(
+        m, "simplicial_complex")
+        .def(py::init([](index_array cells) {
+                 py::gil_scoped_release release;
+                 return make_complex({}, cells_from_array(cells));
+             }),
+             py::arg("cells"))
+        .def(py::init([](double_array points, index_array cells) {
+                 // the arrays stay alive (and unchanged) for the whole call
+                 py::gil_scoped_release release;
+                 return make_complex(points_from_array(points),
+                                     cells_from_array(cells));
+             }),
+             py::arg("points"), py::arg("cells"))
+        .def("dimension", &simplicial_complex::dimension)
+        .def("get_level_size", &simplicial_complex::get_level_size)
+        .def("get_level",
+             [](simplicial_complex& s_comp, int d) {
+                 py::ssize_t rows = s_comp.get_level_size(d);
+                 std::vector< int64_t > flat;
+                 flat.reserve(rows * (d + 1));
+                 for (py::ssize_t i = 0; i < rows; ++i)
+                     for (size_t v : s_comp.index_to_cell(d, i))
+                         flat.push_back(v);
+                 return to_array(std::move(flat), {rows, d + 1});
+             })
+        .def("get_points",
+             [](simplicial_complex& s_comp) {
+                 std::vector< double > flat;
+                 py::ssize_t dim = 0;
+                 for (auto& pt : s_comp.get_points()) {
+                     dim = pt.size();
+                     flat.insert(flat.end(), pt.begin(), pt.end());
+                 }
+                 py::ssize_t rows = dim == 0 ? 0 : flat.size() / dim;
+                 return to_array(std::move(flat), {rows, dim});
+             })
+        .def("boundary_facets",
+             [](simplicial_complex& s_comp) {
+                 // rows of facet, coface, sign
+                 std::vector< int64_t > flat;
+                 for (auto& f : s_comp.boundary_facets()) {
+                     flat.push_back(f.facet);
+                     flat.push_back(f.coface);
+                     flat.push_back(f.sign);
+                 }
+                 py::ssize_t rows = flat.size() / 3;
+                 return to_array(std::move(flat), {rows, 3});
+             })
+        .def("cell_to_index", &simplicial_complex::cell_to_index)
         .def("index_to_cell", &simplicial_complex::index_to_cell);
 
-    m.def("coeff_flow", coeff_flow);
+    m.def("coeff_flow",
+          [](simplicial_complex& s_comp, py::tuple chain, cell_t sigma_0,
+             double c_0) {
+              chain_v p = chain_from_python(chain);
+              chain_v result;
+              {
+                  py::gil_scoped_release release;
+                  result = coeff_flow(s_comp, p, sigma_0, c_0);
+              }
+              return chain_to_python(std::move(result));
+          },
+          py::arg("s_comp"), py::arg("chain"), py::arg("sigma_0"),
+          py::arg("c_0"));
+
+    m.def("coeff_flow_embedded",
+          [](simplicial_complex& s_comp, py::tuple chain) {
+              chain_v p = chain_from_python(chain);
+              chain_v result;
+              {
+                  py::gil_scoped_release release;
+                  result = coeff_flow_embedded(s_comp, p);
+              }
+              return chain_to_python(std::move(result));
+          },
+          py::arg("s_comp"), py::arg("chain"));
+
+    // snappers and solvers share the complex of the python object they are
+    // built from, nothing is rebuilt
+    py::class_< path_snapper, std::shared_ptr< path_snapper > >(
+        m, "path_snapper")
+        .def(py::init([](std::shared_ptr< simplicial_complex > s_comp) {
+                 py::gil_scoped_release release;
+                 return std::make_shared< path_snapper >(s_comp);
+             }),
+             py::arg("s_comp"))
+        .def("snap_path_to_indices",
+             [](path_snapper& snapper, double_array path) {
+                 std::vector< size_t > snapped;
+                 {
+                     py::gil_scoped_release release;
+                     snapped = snapper.snap_path_to_indices(
+                         points_from_array(path));
+                 }
+                 py::ssize_t size = snapped.size();
+                 return to_array(std::vector< int64_t >(snapped.begin(),
+                                                        snapped.end()),
+                                 {size});
+             },
+             py::arg("path"))
+        .def("snap_path_to_chain",
+             [](path_snapper& snapper, double_array path) {
+                 chain_v chain;
+                 {
+                     py::gil_scoped_release release;
+                     chain = snapper.snap_path_to_v_chain(
+                         points_from_array(path));
+                 }
+                 return chain_to_python(std::move(chain));
+             },
+             py::arg("path"))
+        .def("snap_paths",
+             [](path_snapper& snapper, std::vector< double_array > paths) {
+                 std::vector< chain_v > chains(paths.size());
+                 {
+                     py::gil_scoped_release release;
+                     parallel_for(batch_pool(), paths.size(), [&](size_t i) {
+                         chains[i] = snapper.snap_path_to_v_chain(
+                             points_from_array(paths[i]));
+                     });
+                 }
+                 py::list result;
+                 for (auto& chain : chains)
+                     result.append(chain_to_python(std::move(chain)));
+                 return result;
+             },
+             py::arg("paths"),
+             "snap a list of (K, dim) point arrays into a list of 1-chains, "
+             "the batch runs in parallel")
+        .def("get_underlying_complex", &path_snapper::get_underlying_complex);
 
-    m.def("coeff_flow_embedded", coeff_flow_embedded);
+    py::class_< bounding_chain, std::shared_ptr< bounding_chain > >(
+        m, "bounding_chain")
+        .def(py::init([](std::shared_ptr< simplicial_complex > s_comp) {
+                 py::gil_scoped_release release;
+                 return std::make_shared< bounding_chain >(s_comp);
+             }),
+             py::arg("s_comp"))
+        .def("get_bounding_chain",
+             [](bounding_chain& solver, py::tuple chain) {
+                 chain_v p = chain_from_python(chain);
+                 chain_v result;
+                 {
+                     py::gil_scoped_release release;
+                     chain_t sparse = sparse_chain(p);
+                     chain_t b_chain = solver.get_bounding_chain(sparse);
+                     result = dense_chain(b_chain);
+                 }
+                 return chain_to_python(std::move(result));
+             },
+             py::arg("chain"))
+        .def("solve_batch",
+             [](bounding_chain& solver, std::vector< py::tuple > chains) {
+                 std::vector< chain_v > inputs;
+                 for (auto& chain : chains)
+                     inputs.push_back(chain_from_python(chain));
+                 std::vector< chain_v > results(inputs.size());
+                 // one flag per chain, written concurrently (so not vector< bool >)
+                 std::vector< char > bounded(inputs.size(), true);
+                 {
+                     py::gil_scoped_release release;
+                     parallel_for(batch_pool(), inputs.size(), [&](size_t i) {
+                         chain_t sparse = sparse_chain(inputs[i]);
+                         try {
+                             chain_t b_chain =
+                                 solver.get_bounding_chain(sparse);
+                             results[i] = dense_chain(b_chain);
+                         } catch (const non_zero_chain&) {
+                             bounded[i] = false;
+                         }
+                     });
+                 }
+                 py::list result;
+                 for (size_t i = 0; i < results.size(); ++i) {
+                     if (bounded[i])
+                         result.append(chain_to_python(std::move(results[i])));
+                     else
+                         result.append(py::none());
+                 }
+                 return result;
+             },
+             py::arg("chains"),
+             "bounding chains of a list of chains, computed in parallel. "
+             "chains that do not bound give None");
 };
@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scomplex/chain_calc.hpp"
+#include "scomplex/coeff_flow.hpp"
+#include "scomplex/coeff_ring.hpp"
+#include "scomplex/cohomology.hpp"
+#include "scomplex/components.hpp"
+#include "scomplex/incremental_chain.hpp"
+#include "scomplex/memory.hpp"
+#include "scomplex/mesh_generator.hpp"
+#include "scomplex/metrics.hpp"
+#include "scomplex/path_snapper.hpp"
+#include "scomplex/simplicial_complex.hpp"
+#include "scomplex/surface.hpp"
+#include "scomplex/types.hpp"
+
+//
+// self contained timing benchmark: meshes are generated in process, every
+// phase is timed separately with a monotonic clock over several repetitions
+//
+// usage: benchmark [--mesh grid|perturbed|sphere|torus|block]
+//                  [--sizes 1000,10000,...] [--reps N] [--seed S]
+//                  [--csv results.csv] [--json results.json]
+//                  [--metrics metrics.json] [--trace trace.json]
+//                  [--reorder 0|1]
+//
+// sizes are (approximate) numbers of top cells. the coeff_flow result, and
+// that of coeff_flow_parallel (one range per hardware thread), are checked
+// against the known bounding chain of the generated mesh, as are those of
+// the flow over int8 and (mod 2) over z2. is_boundary pairs the cycle with
+// the cocycles of the cohomology basis. coeff_flow_components runs one
+// flow per connected component (labelled in the components phase), its
+// result is checked through its boundary. on surfaces the surface phase
+// builds the twin-edge engine from the triangles (no simplex tree) and
+// surface_flow runs the flow on it, checked like coeff_flow. the edit phase
+// moves one way point of the snapped loop and updates its bounding chain
+// incrementally, which is checked against a full coeff_flow. the update
+// phase removes a patch of cells away from the cycle in place (tombstones),
+// the compact phase drops them, the flow is checked again after both. the
+// library's own metrics (and trace) are only written when it was built
+// with GSIMP_ENABLE_METRICS. with --reorder 1 the complexes are built with
+// their vertices and cells reordered for locality.
+//
+// every phase also records the number of allocations it made and the peak
+// resident set size of the process while it ran (the peak is only per phase
+// where the kernel lets us reset it, otherwise it is the running maximum).
+// the memory taken by each structure is reported on stderr.
+//
+
+typedef std::chrono::steady_clock bench_clock;
+
+GSIMP_COUNT_ALLOCATIONS()
+
+struct phase_stats {
+    std::string mesh;
+    size_t vertices, edges, top_cells;
+    std::string phase;
+    std::vector< double > seconds;
+    uint64_t allocations;  // most allocations made in one repetition
+    size_t peak_rss;       // largest peak rss seen, in bytes
+
+    // nearest rank percentile
+    double percentile(double p) const {
+        std::vector< double > sorted(seconds);
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = std::ceil(p / 100.0 * sorted.size());
+        return sorted[std::max< size_t >(rank, 1) - 1];
+    }
+    double mean() const {
+        double sum = 0;
+        for (double s : seconds) sum += s;
+        return sum / seconds.size();
+    }
+};
+
+struct phase_sample {
+    double seconds;
+    uint64_t allocations;
+    size_t peak_rss;
+};
+
+template < typename F >
+phase_sample time_phase(F f) {
+    gsimp::memory::reset_peak_rss();
+    gsimp::memory::allocation_scope allocs;
+    auto t0 = bench_clock::now();
+    f();
+    auto t1 = bench_clock::now();
+    uint64_t allocations = allocs.delta().allocations;
+    return {std::chrono::duration< double >(t1 - t0).count(), allocations,
+            gsimp::memory::peak_rss()};
+}
+
+std::vector< phase_stats > run_mesh(const gsimp::mesh_generator& gen,
+                                    int reordering, size_t reps) {
+    gsimp::thread_pool pool;
+    auto input = gsimp::complex_input(gsimp::generate_mesh(gen, pool));
+
+    // waypoints along the first boundary loop, for the snapping phases
+    std::vector< gsimp::point_t > cycle_points;
+    auto loops = gen.boundary_loops();
+    if (!loops.empty()) {
+        size_t stride = std::max< size_t >(1, loops[0].size() / 8);
+        for (size_t i = 0; i < loops[0].size(); i += stride)
+            cycle_points.push_back(input.first[loops[0][i]]);
+        cycle_points.push_back(cycle_points.front());
+    }
+
+    const std::vector< std::string > phases{
+        "construction", "hasse", "matrices", "snapper", "snapping", "lscg",
+        "coeff_flow", "coeff_flow_parallel", "coeff_flow_sparse",
+        "coeff_flow_int8", "coeff_flow_z2", "cohomology", "is_boundary",
+        "components", "coeff_flow_components", "surface", "surface_flow",
+        "edit", "update", "compact"};
+    std::map< std::string, std::vector< phase_sample > > times;
+    size_t sizes[4] = {0, 0, 0, 0};
+
+    for (size_t rep = 0; rep < reps; ++rep) {
+        std::vector< gsimp::point_t > points(input.first);
+        std::vector< gsimp::cell_t > cells(input.second);
+        std::shared_ptr< gsimp::simplicial_complex > s_comp;
+        std::shared_ptr< gsimp::bounding_chain > solver;
+        std::shared_ptr< gsimp::path_snapper > snapper;
+
+        times["construction"].push_back(time_phase([&] {
+            s_comp = std::make_shared< gsimp::simplicial_complex >(
+                points, cells, reordering);
+        }));
+        times["hasse"].push_back(
+            time_phase([&] { s_comp->calculate_hasse(); }));
+        times["matrices"].push_back(time_phase([&] {
+            solver = std::make_shared< gsimp::bounding_chain >(s_comp);
+        }));
+        if (gen.dimension() == 2) {
+            times["snapper"].push_back(time_phase([&] {
+                snapper = std::make_shared< gsimp::path_snapper >(s_comp);
+            }));
+        }
+        if (snapper && !cycle_points.empty()) {
+            times["snapping"].push_back(time_phase(
+                [&] { snapper->snap_path_to_indices(cycle_points); }));
+        }
+
+        auto pair = gsimp::known_pair(*s_comp, gen);
+        gsimp::chain_v& cycle_v = pair.first;
+        gsimp::chain_t cycle = s_comp->new_chain(gen.dimension() - 1);
+        for (size_t i = 0; i < gsimp::chain_size(cycle_v); ++i)
+            if (gsimp::chain_val(cycle_v, i) != 0)
+                gsimp::chain_rep(cycle).insertBack(i) =
+                    gsimp::chain_val(cycle_v, i);
+
+        // on closed meshes the least squares solution is not integral and
+        // the solver gives up, it is still timed
+        times["lscg"].push_back(time_phase([&] {
+            try {
+                solver->get_bounding_chain(cycle);
+            } catch (const gsimp::non_zero_chain&) {
+            }
+        }));
+        gsimp::chain_v result;
+        times["coeff_flow"].push_back(time_phase([&] {
+            result = gen.closed()
+                         ? gsimp::coeff_flow(
+                               *s_comp, cycle_v,
+                               s_comp->reordered_cell(gsimp::null_cell(gen)),
+                               0)
+                         : gsimp::coeff_flow_embedded(*s_comp, cycle_v);
+        }));
+        if (gsimp::chain_rep_v(result) != gsimp::chain_rep_v(pair.second))
+            throw std::runtime_error("coeff_flow gave a wrong bounding chain "
+                                     "on " + gen.name());
+        times["coeff_flow_parallel"].push_back(time_phase([&] {
+            result = gen.closed()
+                         ? gsimp::coeff_flow_parallel(
+                               *s_comp, cycle_v,
+                               s_comp->reordered_cell(gsimp::null_cell(gen)),
+                               0, pool)
+                         : gsimp::coeff_flow_embedded_parallel(*s_comp,
+                                                               cycle_v, pool);
+        }));
+        if (gsimp::chain_rep_v(result) != gsimp::chain_rep_v(pair.second))
+            throw std::runtime_error("coeff_flow_parallel gave a wrong "
+                                     "bounding chain on " + gen.name());
+
+        // the zero cell of the generator is outside the region
+        std::vector< std::pair< size_t, double > > sparse;
+        size_t zero_cell = s_comp->cell_to_index(
+            s_comp->reordered_cell(gsimp::null_cell(gen)));
+        times["coeff_flow_sparse"].push_back(time_phase([&] {
+            gsimp::coeff_flow_sparse(*s_comp, cycle, zero_cell, sparse);
+        }));
+        std::vector< double > from_sparse(pair.second.second.size(), 0);
+        for (auto& cell : sparse) from_sparse[cell.first] = cell.second;
+        if (from_sparse != gsimp::chain_rep_v(pair.second))
+            throw std::runtime_error("coeff_flow_sparse gave a wrong "
+                                     "bounding chain on " + gen.name());
+
+        // the same flow over small integers and over z2, where the known
+        // chain is taken mod 2
+        auto cycle_8 = gsimp::to_ring_chain< gsimp::int8_ring >(cycle_v);
+        auto cycle_2 = gsimp::to_ring_chain< gsimp::z2_ring >(cycle_v);
+        gsimp::int8_chain result_8;
+        gsimp::z2_chain result_2;
+        times["coeff_flow_int8"].push_back(time_phase([&] {
+            if (gen.closed())
+                gsimp::coeff_flow(*s_comp, cycle_8, zero_cell, 0, result_8);
+            else
+                gsimp::coeff_flow_embedded(*s_comp, cycle_8, result_8);
+        }));
+        if (result_8 != gsimp::to_ring_chain< gsimp::int8_ring >(pair.second))
+            throw std::runtime_error("coeff_flow over int8 gave a wrong "
+                                     "bounding chain on " + gen.name());
+        times["coeff_flow_z2"].push_back(time_phase([&] {
+            if (gen.closed())
+                gsimp::coeff_flow(*s_comp, cycle_2, zero_cell, 0, result_2);
+            else
+                gsimp::coeff_flow_embedded(*s_comp, cycle_2, result_2);
+        }));
+        if (result_2 != gsimp::to_ring_chain< gsimp::z2_ring >(pair.second))
+            throw std::runtime_error("coeff_flow over z2 gave a wrong "
+                                     "bounding chain on " + gen.name());
+
+        std::shared_ptr< gsimp::cohomology_basis > cohomology;
+        times["cohomology"].push_back(time_phase([&] {
+            cohomology = std::make_shared< gsimp::cohomology_basis >(s_comp);
+        }));
+        bool is_boundary = false;
+        times["is_boundary"].push_back(
+            time_phase([&] { is_boundary = cohomology->is_boundary(cycle); }));
+        if (!is_boundary)
+            throw std::runtime_error("the known cycle is not a boundary of " +
+                                     gen.name() + " for its cohomology");
+
+        // closed components start from their first cell at zero, not from
+        // the zero cell of the generator
+        std::shared_ptr< gsimp::complex_components > components;
+        times["components"].push_back(time_phase([&] {
+            components =
+                std::make_shared< gsimp::complex_components >(s_comp, pool);
+        }));
+        std::vector< gsimp::component_flow > flows;
+        times["coeff_flow_components"].push_back(time_phase([&] {
+            gsimp::coeff_flow_components(*s_comp, *components, cycle_v,
+                                         result, flows, pool);
+        }));
+        for (auto& flow : flows)
+            if (!flow.bounding)
+                throw std::runtime_error("coeff_flow_components found no "
+                                         "bounding chain on " + gen.name());
+        gsimp::chain_v bounded = gsimp::to_chain_v(gsimp::boundary(
+            *s_comp, gsimp::to_ring_chain< gsimp::real_ring >(result)));
+        if (bounded != cycle_v)
+            throw std::runtime_error("coeff_flow_components gave a wrong "
+                                     "bounding chain on " + gen.name());
+
+        std::shared_ptr< gsimp::surface_mesh > surface;
+        if (gen.dimension() == 2) {
+            times["surface"].push_back(time_phase([&] {
+                surface = std::make_shared< gsimp::surface_mesh >(
+                    input.first, input.second);
+            }));
+            gsimp::surface_link link(surface, *s_comp);
+            times["surface_flow"].push_back(time_phase([&] {
+                if (gen.closed())
+                    link.coeff_flow(cycle_v, zero_cell, 0, result);
+                else
+                    link.coeff_flow_embedded(cycle_v, result);
+            }));
+            if (result != pair.second)
+                throw std::runtime_error("the surface flow gave a wrong "
+                                         "bounding chain on " + gen.name());
+        }
+
+        // one way point of the snapped loop moved half way to the next one
+        if (snapper && !gen.closed() && cycle_points.size() > 3) {
+            gsimp::incremental_chain loop(snapper);
+            std::vector< gsimp::point_t > edited(cycle_points);
+            for (size_t k = 0; k < edited[1].size(); ++k)
+                edited[1][k] = (edited[1][k] + edited[2][k]) / 2;
+            bool bounds = true;
+            try {
+                loop.set_path(cycle_points);
+            } catch (const gsimp::no_bounding_chain&) {
+                bounds = false;
+            }
+            if (bounds) {
+                times["edit"].push_back(
+                    time_phase([&] { loop.edit_path(edited); }));
+                gsimp::chain_v cycle = loop.get_cycle(), full;
+                gsimp::coeff_flow_embedded(*s_comp, cycle, full);
+                if (full != loop.get_bounding_chain())
+                    throw std::runtime_error("the edited bounding chain is "
+                                             "wrong on " + gen.name());
+            }
+        }
+
+        for (int d = 0; d <= gen.dimension(); ++d)
+            sizes[d] = s_comp->get_level_size(d);
+
+        // a patch of top cells away from the cycle and its bounding chain
+        // (one in a thousand, from the middle of the level) is removed in
+        // place, then the tombstones are compacted: the known chain stays
+        // the bounding chain, at its new indices after compaction
+        int d = gen.dimension();
+        size_t num_cells = s_comp->get_level_size(d);
+        std::vector< gsimp::cell_t > patch;
+        gsimp::simplicial_complex::incidence_view faces =
+            s_comp->faces_view(d);
+        for (size_t sigma = num_cells / 2;
+             sigma < num_cells &&
+             patch.size() < std::max< size_t >(1, num_cells / 1000);
+             ++sigma) {
+            bool away = sigma != zero_cell &&
+                        gsimp::chain_val(pair.second, sigma) == 0;
+            for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k)
+                away = away && cycle_v.second[faces.cells[k]] == 0;
+            if (away) patch.push_back(s_comp->index_to_cell(d, sigma));
+        }
+        gsimp::simplicial_complex::update_report update;
+        times["update"].push_back(time_phase([&] {
+            update = s_comp->update_cells({}, patch, {});
+            if (snapper) snapper->update(update);
+        }));
+        if (gen.closed())
+            gsimp::coeff_flow(*s_comp, cycle_v, zero_cell, 0, result);
+        else
+            gsimp::coeff_flow_embedded(*s_comp, cycle_v, result);
+        if (result != pair.second)
+            throw std::runtime_error("coeff_flow gave a wrong bounding chain "
+                                     "on " + gen.name() + " once updated");
+        std::vector< std::vector< size_t > > remap;
+        times["compact"].push_back(time_phase([&] {
+            remap = s_comp->compact();
+            if (snapper) snapper->remap(remap);
+        }));
+        gsimp::chain_v cycle_c(d - 1, std::vector< double >(
+                                          s_comp->get_level_size(d - 1), 0));
+        gsimp::chain_v known_c(d, std::vector< double >(
+                                      s_comp->get_level_size(d), 0));
+        for (size_t tau = 0; tau < remap[d - 1].size(); ++tau)
+            if (remap[d - 1][tau] != gsimp::simplicial_complex::no_index)
+                cycle_c.second[remap[d - 1][tau]] = cycle_v.second[tau];
+        for (size_t sigma = 0; sigma < remap[d].size(); ++sigma)
+            if (remap[d][sigma] != gsimp::simplicial_complex::no_index)
+                known_c.second[remap[d][sigma]] = pair.second.second[sigma];
+        if (gen.closed())
+            gsimp::coeff_flow(*s_comp, cycle_c, remap[d][zero_cell], 0,
+                              result);
+        else
+            gsimp::coeff_flow_embedded(*s_comp, cycle_c, result);
+        if (result != known_c)
+            throw std::runtime_error("coeff_flow gave a wrong bounding chain "
+                                     "on " + gen.name() + " once compacted");
+
+        if (rep + 1 == reps) {
+            gsimp::memory_report report;
+            report.add("complex", s_comp->get_memory_report());
+            report.add("solver", solver->get_memory_report());
+            if (snapper) report.add("snapper", snapper->get_memory_report());
+            report.add("cohomology", cohomology->get_memory_report());
+            report.add("components", components->get_memory_report());
+            if (surface) report.add("surface", surface->get_memory_report());
+            report.add("bounding_chain.real",
+                       gsimp::memory::vector_bytes(result.second));
+            report.add("bounding_chain.int8", result_8.bytes());
+            report.add("bounding_chain.z2", result_2.bytes());
+            std::cerr << "memory of " << gen.name() << ":\n";
+            report.write(std::cerr);
+        }
+    }
+
+    std::vector< phase_stats > stats;
+    for (auto& phase : phases) {
+        if (times[phase].empty()) continue;
+        phase_stats s{gen.name(), sizes[0], sizes[1], sizes[gen.dimension()],
+                      phase, {}, 0, 0};
+        for (auto& sample : times[phase]) {
+            s.seconds.push_back(sample.seconds);
+            s.allocations = std::max(s.allocations, sample.allocations);
+            s.peak_rss = std::max(s.peak_rss, sample.peak_rss);
+        }
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+void write_csv(std::ostream& out, const std::vector< phase_stats >& stats) {
+    out << "mesh,vertices,edges,top_cells,phase,reps,min,median,p90,p99,max,"
+           "mean,allocations,peak_rss\n";
+    for (auto& s : stats) {
+        out << s.mesh << "," << s.vertices << "," << s.edges << ","
+            << s.top_cells << "," << s.phase << "," << s.seconds.size() << ","
+            << s.percentile(0) << "," << s.percentile(50) << ","
+            << s.percentile(90) << "," << s.percentile(99) << ","
+            << s.percentile(100) << "," << s.mean() << "," << s.allocations
+            << "," << s.peak_rss << "\n";
+    }
+}
+
+void write_json(std::ostream& out, const std::vector< phase_stats >& stats) {
+    out << "[\n";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        auto& s = stats[i];
+        out << "  {\"mesh\": \"" << s.mesh << "\", \"vertices\": " << s.vertices
+            << ", \"edges\": " << s.edges
+            << ", \"top_cells\": " << s.top_cells
+            << ", \"phase\": \"" << s.phase
+            << "\", \"reps\": " << s.seconds.size()
+            << ", \"min\": " << s.percentile(0)
+            << ", \"median\": " << s.percentile(50)
+            << ", \"p90\": " << s.percentile(90)
+            << ", \"p99\": " << s.percentile(99)
+            << ", \"max\": " << s.percentile(100)
+            << ", \"mean\": " << s.mean()
+            << ", \"allocations\": " << s.allocations
+            << ", \"peak_rss\": " << s.peak_rss << "}"
+            << (i + 1 < stats.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::vector< size_t > sizes{1000, 10000, 100000};
+    std::string kind = "perturbed";
+    size_t reps = 5;
+    unsigned seed = 1;
+    std::string csv_file, json_file, metrics_file, trace_file;
+    int reordering = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i], val = argv[i + 1];
+        if (opt == "--mesh") {
+            kind = val;
+        } else if (opt == "--sizes") {
+            sizes.clear();
+            std::istringstream list(val);
+            std::string size;
+            while (std::getline(list, size, ','))
+                sizes.push_back(std::stoul(size));
+        } else if (opt == "--reps") {
+            reps = std::max(1ul, std::stoul(val));
+        } else if (opt == "--seed") {
+            seed = std::stoul(val);
+        } else if (opt == "--csv") {
+            csv_file = val;
+        } else if (opt == "--json") {
+            json_file = val;
+        } else if (opt == "--metrics") {
+            metrics_file = val;
+        } else if (opt == "--trace") {
+            trace_file = val;
+        } else if (opt == "--reorder") {
+            reordering = std::stoi(val) ? gsimp::simplicial_complex::reorder_all
+                                        : 0;
+        } else {
+            std::cerr << "unknown option " << opt << "\n";
+            return 1;
+        }
+    }
+
+    std::vector< phase_stats > stats;
+    for (size_t size : sizes) {
+        auto gen = gsimp::make_mesh_generator(kind, size, seed);
+        std::cerr << "running " << gen->name() << " (" << reps
+                  << " repetitions)\n";
+        auto mesh_stats = run_mesh(*gen, reordering, reps);
+        stats.insert(stats.end(), mesh_stats.begin(), mesh_stats.end());
+    }
+
+    write_csv(std::cout, stats);
+    if (!csv_file.empty()) {
+        std::ofstream csv(csv_file);
+        write_csv(csv, stats);
+    }
+    if (!json_file.empty()) {
+        std::ofstream json(json_file);
+        write_json(json, stats);
+    }
+    if (!metrics_file.empty() && gsimp::metrics::enabled()) {
+        std::ofstream metrics(metrics_file);
+        gsimp::metrics::write_json(metrics);
+    }
+    if (!trace_file.empty() && gsimp::metrics::enabled()) {
+        std::ofstream trace(trace_file);
+        gsimp::metrics::write_chrome_trace(trace);
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "line_io.hpp"
+
+//
+// command line client of flow_server: sends the requests read from stdin
+// (one JSON document per line) and prints the replies as they come
+//
+// usage: flow_client /tmp/coeffflow.sock < requests.jsonl
+//
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "usage: flow_client socket < requests.jsonl\n";
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int fd;
+    try {
+        fd = connect_unix(argv[1]);
+    } catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+
+    // the server closes the connection after answering everything we sent
+    std::thread sender([fd] {
+        std::string line;
+        try {
+            while (std::getline(std::cin, line)) write_all(fd, line + "\n");
+        } catch (const std::exception& e) {
+            std::cerr << e.what();
+        }
+        shutdown(fd, SHUT_WR);
+    });
+
+    line_reader replies(fd);
+    std::string reply;
+    while (replies.next(reply)) std::cout << reply << std::endl;
+
+    // still waiting on stdin if the server went away first
+    sender.detach();
+    return 0;
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// just enough JSON for the line protocol of the server tools: parsing of
+// one document per line into a tree, and helpers to write replies
+//
+
+namespace json {
+
+class parse_error : public std::runtime_error {
+   public:
+    explicit parse_error(const std::string& what)
+        : std::runtime_error(what) {}
+};
+
+struct value {
+    enum kind_t { null_v, bool_v, number_v, string_v, array_v, object_v };
+
+    kind_t kind = null_v;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector< value > array;
+    std::vector< std::pair< std::string, value > > object;
+
+    bool is_null() const { return kind == null_v; }
+    bool is_number() const { return kind == number_v; }
+    bool is_string() const { return kind == string_v; }
+    bool is_array() const { return kind == array_v; }
+    bool is_object() const { return kind == object_v; }
+
+    bool has(const std::string& key) const {
+        for (auto& member : object)
+            if (member.first == key) return true;
+        return false;
+    }
+
+    // null value for missing keys
+    const value& operator[](const std::string& key) const {
+        static const value none;
+        for (auto& member : object)
+            if (member.first == key) return member.second;
+        return none;
+    }
+
+    const value& operator[](size_t i) const { return array.at(i); }
+    size_t size() const { return is_array() ? array.size() : object.size(); }
+
+    double as_number() const {
+        if (!is_number()) throw parse_error("expected a number");
+        return number;
+    }
+
+    size_t as_index() const {
+        double n = as_number();
+        // 2^64 and up do not fit
+        if (!(n >= 0 && n < 18446744073709551616.0) || n != std::floor(n))
+            throw parse_error("expected a non negative integer");
+        return size_t(n);
+    }
+
+    const std::string& as_string() const {
+        if (!is_string()) throw parse_error("expected a string");
+        return string;
+    }
+};
+
+class parser {
+    const std::string& text;
+    size_t pos = 0;
+    // arrays and objects open around the current value
+    size_t depth = 0;
+
+    void skip_space() {
+        while (pos < text.size() &&
+               (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' ||
+                text[pos] == '\r'))
+            ++pos;
+    }
+
+    [[noreturn]] void fail(const std::string& what) {
+        throw parse_error(what + " at offset " + std::to_string(pos));
+    }
+
+    void expect(char c) {
+        skip_space();
+        if (pos >= text.size() || text[pos] != c)
+            fail(std::string("expected '") + c + "'");
+        ++pos;
+    }
+
+    bool literal(const char* word) {
+        size_t len = std::char_traits< char >::length(word);
+        if (text.compare(pos, len, word) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    std::string parse_string() {
+        expect('"');
+        std::string str;
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c != '\\') {
+                str += c;
+                continue;
+            }
+            if (pos >= text.size()) break;
+            char esc = text[pos++];
+            switch (esc) {
+                case 'n': str += '\n'; break;
+                case 't': str += '\t'; break;
+                case 'r': str += '\r'; break;
+                case 'b': str += '\b'; break;
+                case 'f': str += '\f'; break;
+                case 'u': {
+                    // only the ascii range is needed by the tools
+                    if (pos + 4 > text.size()) fail("bad escape");
+                    long code =
+                        std::strtol(text.substr(pos, 4).c_str(), nullptr, 16);
+                    str += code < 128 ? char(code) : '?';
+                    pos += 4;
+                    break;
+                }
+                default: str += esc;
+            }
+        }
+        if (pos >= text.size()) fail("unterminated string");
+        ++pos;
+        return str;
+    }
+
+    // bounds the recursion, a line of nested brackets would overflow the stack
+    struct nesting {
+        parser& p;
+        explicit nesting(parser& _p) : p(_p) {
+            if (++p.depth > max_depth) p.fail("nested too deep");
+        }
+        ~nesting() { --p.depth; }
+    };
+
+    value parse_value() {
+        skip_space();
+        if (pos >= text.size()) fail("unexpected end");
+        value val;
+        char c = text[pos];
+        if (c == '{' || c == '[') {
+            nesting level(*this);
+            return c == '{' ? parse_object() : parse_array();
+        }
+        if (c == '"') {
+            val.kind = value::string_v;
+            val.string = parse_string();
+        } else if (literal("true")) {
+            val.kind = value::bool_v;
+            val.boolean = true;
+        } else if (literal("false")) {
+            val.kind = value::bool_v;
+        } else if (literal("null")) {
+        } else {
+            // json numbers only, strtod would also take inf, nan and hex
+            const char* start = text.c_str() + pos;
+            const char* digit = start + (*start == '-');
+            if (*digit < '0' || *digit > '9') fail("unexpected character");
+            char* end;
+            val.number = std::strtod(start, &end);
+            if (!std::isfinite(val.number)) fail("number out of range");
+            val.kind = value::number_v;
+            pos += end - start;
+        }
+        return val;
+    }
+
+    value parse_object() {
+        value val;
+        val.kind = value::object_v;
+        ++pos;
+        skip_space();
+        if (pos < text.size() && text[pos] == '}') {
+            ++pos;
+            return val;
+        }
+        for (;;) {
+            std::string key = parse_string();
+            expect(':');
+            val.object.emplace_back(key, parse_value());
+            skip_space();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            expect('}');
+            return val;
+        }
+    }
+
+    value parse_array() {
+        value val;
+        val.kind = value::array_v;
+        ++pos;
+        skip_space();
+        if (pos < text.size() && text[pos] == ']') {
+            ++pos;
+            return val;
+        }
+        for (;;) {
+            val.array.push_back(parse_value());
+            skip_space();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            expect(']');
+            return val;
+        }
+    }
+
+   public:
+    static constexpr size_t max_depth = 64;
+
+    explicit parser(const std::string& _text) : text(_text) {}
+
+    value parse() {
+        value val = parse_value();
+        skip_space();
+        if (pos != text.size()) fail("trailing characters");
+        return val;
+    }
+};
+
+inline value parse(const std::string& text) { return parser(text).parse(); }
+
+inline std::string quote(const std::string& str) {
+    std::string quoted = "\"";
+    for (char c : str) {
+        switch (c) {
+            case '"': quoted += "\\\""; break;
+            case '\\': quoted += "\\\\"; break;
+            case '\n': quoted += "\\n"; break;
+            case '\t': quoted += "\\t"; break;
+            case '\r': quoted += "\\r"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    quoted += buf;
+                } else {
+                    quoted += c;
+                }
+        }
+    }
+    return quoted + "\"";
+}
+
+// numbers print exactly (integral ones without a decimal point)
+inline std::string number(double x) {
+    char buf[32];
+    if (x == std::floor(x) && std::fabs(x) < 1e15)
+        std::snprintf(buf, sizeof(buf), "%.0f", x);
+    else
+        std::snprintf(buf, sizeof(buf), "%.17g", x);
+    return buf;
+}
+
+template < typename T >
+std::string array(const std::vector< T >& values) {
+    std::string arr = "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i) arr += ",";
+        arr += number(values[i]);
+    }
+    return arr + "]";
+}
+
+};  // namespace json
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//
+// line based io over file descriptors (stdin/stdout or unix sockets) for
+// the server tools
+//
+
+inline std::runtime_error io_error(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno) + "\n");
+}
+
+inline sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("socket path too long: " + path + "\n");
+    std::strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+// listening socket at path (a stale socket file is replaced)
+inline int listen_unix(const std::string& path, int backlog = 128) {
+    sockaddr_un address = unix_address(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw io_error("socket");
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(fd, backlog) < 0) {
+        close(fd);
+        throw io_error("cannot listen on " + path);
+    }
+    return fd;
+}
+
+inline int connect_unix(const std::string& path) {
+    sockaddr_un address = unix_address(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw io_error("socket");
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        throw io_error("cannot connect to " + path);
+    }
+    return fd;
+}
+
+inline void write_all(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw io_error("write");
+        done += n;
+    }
+}
+
+class line_reader {
+    int fd;
+    std::string buffer;
+    size_t start = 0;
+
+   public:
+    explicit line_reader(int _fd) : fd(_fd) {}
+
+    // next line without its newline, false at end of input
+    bool next(std::string& line) {
+        for (;;) {
+            size_t end = buffer.find('\n', start);
+            if (end != std::string::npos) {
+                line.assign(buffer, start, end - start);
+                start = end + 1;
+                return true;
+            }
+            buffer.erase(0, start);
+            start = 0;
+            char chunk[1 << 16];
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                // last line without a newline
+                if (buffer.empty()) return false;
+                line.swap(buffer);
+                buffer.clear();
+                return true;
+            }
+            buffer.append(chunk, n);
+        }
+    }
+};
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json_lines.hpp"
+#include "line_io.hpp"
+
+//
+// load generator for flow_server: every connection sends one request at a
+// time (small random polygons in the bounding box of the mesh) and the
+// round trip latencies of all of them are reported
+//
+// usage: flow_load --socket /tmp/coeffflow.sock --mesh grid
+//                  [--requests N] [--concurrency C]
+//                  [--op bounding_chain|snap] [--method coeff_flow|lscg]
+//                  [--seed S]
+//
+
+typedef std::chrono::steady_clock load_clock;
+
+struct load_options {
+    std::string socket, mesh;
+    std::string op = "bounding_chain";
+    std::string method = "coeff_flow";
+    size_t requests = 1000;
+    size_t concurrency = 4;
+    unsigned seed = 1;
+};
+
+struct load_results {
+    std::mutex mtx;
+    std::vector< double > latencies;  // microseconds
+    size_t errors = 0;
+    std::string first_error;
+};
+
+// a connection to the server, one request in flight at a time
+struct load_connection {
+    int fd;
+    line_reader replies;
+
+    explicit load_connection(const std::string& path)
+        : fd(connect_unix(path)), replies(fd) {}
+    ~load_connection() { close(fd); }
+
+    json::value call(const std::string& request) {
+        write_all(fd, request + "\n");
+        std::string reply;
+        if (!replies.next(reply))
+            throw std::runtime_error("the server closed the connection\n");
+        return json::parse(reply);
+    }
+};
+
+// a polygon of 3 to 8 points around a random center, in the plane of the
+// first two coordinates
+std::string random_path(std::mt19937_64& rng,
+                        const std::vector< double >& lower,
+                        const std::vector< double >& upper) {
+    std::uniform_real_distribution< double > unit(0, 1);
+    double extent = std::min(upper[0] - lower[0], upper[1] - lower[1]);
+    double radius = (0.02 + 0.08 * unit(rng)) * extent;
+    std::vector< double > center(lower.size());
+    for (size_t k = 0; k < lower.size(); ++k) {
+        double margin = k < 2 ? radius : 0;
+        center[k] = lower[k] + margin +
+                    unit(rng) * (upper[k] - lower[k] - 2 * margin);
+    }
+    size_t corners = 3 + rng() % 6;
+    std::string path = "[";
+    for (size_t i = 0; i <= corners; ++i) {
+        double angle = 2 * M_PI * (i % corners) / corners;
+        std::vector< double > pt(center);
+        pt[0] += radius * std::cos(angle);
+        pt[1] += radius * std::sin(angle);
+        path += (i ? "," : "") + json::array(pt);
+    }
+    return path + "]";
+}
+
+void run_connection(const load_options& opts, size_t id, size_t requests,
+                    const std::vector< double >& lower,
+                    const std::vector< double >& upper, load_results& results) {
+    std::mt19937_64 rng(opts.seed * 1000003 + id);
+    std::vector< double > latencies;
+    size_t errors = 0;
+    std::string first_error;
+    try {
+        load_connection conn(opts.socket);
+        for (size_t i = 0; i < requests; ++i) {
+            std::string request =
+                "{\"id\":" + json::number(i) +
+                ",\"op\":" + json::quote(opts.op) +
+                ",\"mesh\":" + json::quote(opts.mesh) +
+                ",\"method\":" + json::quote(opts.method) +
+                ",\"path\":" + random_path(rng, lower, upper) + "}";
+            auto start = load_clock::now();
+            json::value reply = conn.call(request);
+            latencies.push_back(std::chrono::duration< double, std::micro >(
+                                    load_clock::now() - start)
+                                    .count());
+            if (reply["ok"].boolean) continue;
+            if (errors++ == 0) first_error = reply["error"].string;
+        }
+    } catch (const std::exception& e) {
+        errors++;
+        first_error = e.what();
+    }
+
+    std::lock_guard< std::mutex > lock(results.mtx);
+    results.latencies.insert(results.latencies.end(), latencies.begin(),
+                             latencies.end());
+    results.errors += errors;
+    if (results.first_error.empty()) results.first_error = first_error;
+}
+
+int main(int argc, char* argv[]) {
+    load_options opts;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i], val = argv[i + 1];
+        if (opt == "--socket") {
+            opts.socket = val;
+        } else if (opt == "--mesh") {
+            opts.mesh = val;
+        } else if (opt == "--requests") {
+            opts.requests = std::stoul(val);
+        } else if (opt == "--concurrency") {
+            opts.concurrency = std::max(1ul, std::stoul(val));
+        } else if (opt == "--op") {
+            opts.op = val;
+        } else if (opt == "--method") {
+            opts.method = val;
+        } else if (opt == "--seed") {
+            opts.seed = std::stoul(val);
+        } else {
+            std::cerr << "unknown option " << opt << "\n";
+            return 1;
+        }
+    }
+    if (opts.socket.empty() || opts.mesh.empty()) {
+        std::cerr << "usage: flow_load --socket path --mesh name [options]\n";
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // bounding box of the mesh
+    std::vector< double > lower, upper;
+    try {
+        load_connection conn(opts.socket);
+        json::value reply = conn.call("{\"op\":\"meshes\"}");
+        for (auto& mesh : reply["meshes"].array) {
+            if (mesh["name"].string != opts.mesh) continue;
+            for (auto& x : mesh["lower"].array) lower.push_back(x.as_number());
+            for (auto& x : mesh["upper"].array) upper.push_back(x.as_number());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what();
+        return 1;
+    }
+    if (lower.size() < 2) {
+        std::cerr << "the server has no mesh " << opts.mesh << "\n";
+        return 1;
+    }
+
+    load_results results;
+    std::vector< std::thread > clients;
+    auto start = load_clock::now();
+    for (size_t c = 0; c < opts.concurrency; ++c) {
+        size_t share = opts.requests / opts.concurrency +
+                       (c < opts.requests % opts.concurrency ? 1 : 0);
+        clients.emplace_back([&, c, share] {
+            run_connection(opts, c, share, lower, upper, results);
+        });
+    }
+    for (auto& client : clients) client.join();
+    double seconds =
+        std::chrono::duration< double >(load_clock::now() - start).count();
+
+    auto& lat = results.latencies;
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) {
+        if (lat.empty()) return 0.0;
+        size_t rank = std::ceil(p / 100 * lat.size());
+        return lat[std::max< size_t >(rank, 1) - 1];
+    };
+    std::cout << "requests: " << lat.size() << " (" << results.errors
+              << " errors) over " << opts.concurrency << " connections\n"
+              << "throughput: " << lat.size() / seconds << " requests/s\n"
+              << "latency (us): p50 " << pct(50) << ", p90 " << pct(90)
+              << ", p99 " << pct(99) << ", max " << pct(100) << "\n";
+    if (!results.first_error.empty())
+        std::cout << "first error: " << results.first_error << "\n";
+    return results.errors == 0 ? 0 : 2;
+}
@@ -6,23 +6,24 @@
 
 using namespace std;
 
+// usage:
+//   qhull2ply <file>          reads <file>, writes <file>.ply
+//   qhull2ply - <name>        reads stdin (e.g. a qhull pipe), writes <name>.ply
 int main(int argc, char* argv[]) {
     string filename = argv[1];
 
-    pair<vector<vector<double>>, vector<vector<size_t>>> mesh;
-    mesh = parse_qhull_file(filename);
+    qhull_mesh mesh;
+    if (filename == "-") {
+        mesh = parse_qhull_stream(stdin);
+        filename = (argc > 2) ? argv[2] : "qhull";
+    } else {
+        mesh = parse_qhull_flat(filename);
+    }
 
-    vector<vector<double>> points = get<0>(mesh);
-    vector<vector<size_t>> faces = get<1>(mesh);
+    if (mesh.cell_size != 3) {throw std::exception();}
 
-    for ( auto face : faces ) {if (face.size() != 3) {throw std::exception();}}
-    ofstream ply_file(filename.append(".ply"));
-    make_ply(ply_file, points,faces);
+    ofstream ply_file(filename.append(".ply"), ios::binary);
+    make_binary_ply(ply_file, mesh.coordinates, mesh.dimension, mesh.cells);
     ply_file.close();
     return 0;
 }
-
-
-
-
-
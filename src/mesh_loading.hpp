@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "scomplex/types.hpp"
+
+#include "tiny_obj_loader.h"
+#include "tinyply.h"
+
+template < typename T >
+struct vec3 {
+    T x, y, z;
+
+    std::vector< double > point() {
+        std::vector< double > vec_;
+        vec_.push_back(double(x));
+        vec_.push_back(double(y));
+        vec_.push_back(double(z));
+        return vec_;
+    }
+
+    std::vector< size_t > simp() {
+        std::vector< size_t > vec_;
+        vec_.push_back(size_t(x));
+        vec_.push_back(size_t(y));
+        vec_.push_back(size_t(z));
+        return vec_;
+    }
+};
+
+// read a triangle mesh from a ply file (first line "ply") or an obj file,
+// cells come out 0-indexed
+inline void load_mesh(const std::string& complex_file,
+                      std::vector< gsimp::point_t >& points_v,
+                      std::vector< gsimp::cell_t >& cells_v) {
+    std::ifstream file(complex_file);
+    std::string meshtype;
+    std::getline(file, meshtype);
+
+    if (meshtype == "ply") {
+        tinyply::PlyFile plyMeshFile;
+        plyMeshFile.parse_header(file);
+
+        std::shared_ptr< tinyply::PlyData > vertices, faces;
+        try {
+            vertices = plyMeshFile.request_properties_from_element(
+                "vertex", {"x", "y", "z"});
+            faces = plyMeshFile.request_properties_from_element(
+                "face", {"vertex_indices"});
+        } catch (const std::exception& e) {
+            std::cerr << "tinyply exception: " << e.what() << std::endl;
+        }
+
+        plyMeshFile.read(file);
+
+        {
+            const size_t numVerticesBytes = vertices->buffer.size_bytes();
+            std::vector< vec3< float > > verts(vertices->count);
+            std::memcpy(verts.data(), vertices->buffer.get(), numVerticesBytes);
+            for (vec3< float > v : verts) {
+                points_v.push_back(v.point());
+            }
+        }
+
+        {
+            const size_t numFacesBytes = faces->buffer.size_bytes();
+            std::vector< vec3< uint32_t > > faces_(faces->count);
+            std::memcpy(faces_.data(), faces->buffer.get(), numFacesBytes);
+            for (vec3< uint32_t > f : faces_) {
+                cells_v.push_back(f.simp());
+            }
+        }
+
+    } else {
+        tinyobj::attrib_t attrib;
+        std::vector< tinyobj::shape_t > shapes;
+        std::vector< tinyobj::material_t > materials;
+        const char* basepath = {};//= std::string("").c_str();
+        std::string err;
+        const char* filename = complex_file.c_str();
+
+        bool triangulate = false;
+
+        tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename, basepath,
+                         triangulate);
+
+        std::vector< double > vert;
+        for (size_t i = 0; i < attrib.vertices.size(); i++) {
+            vert.push_back(attrib.vertices.at(i));
+            if (i % 3 == 2) {
+                points_v.push_back(vert);
+                vert.clear();
+            }
+        }
+
+        std::vector< size_t > face;
+        tinyobj::shape_t shape = shapes.at(0);
+        for (size_t i = 0; i < shape.mesh.indices.size(); i++) {
+            tinyobj::index_t idx = shape.mesh.indices.at(i);
+            face.push_back(idx.vertex_index);
+            if (i % 3 == 2) {
+                cells_v.push_back(face);
+                face.clear();
+            }
+        }
+    }
+
+    // watch out for 0 or 1 indexing
+    bool zero_index = true;
+    for (gsimp::cell_t cell : cells_v) {
+        for (size_t vert : cell) {
+            if (vert >= points_v.size()) {
+                zero_index = false;
+                break;
+            }
+        }
+        if (!zero_index) break;
+    }
+
+    if (!zero_index) {
+        for (size_t i = 0; i < cells_v.size(); ++i) {
+            for (size_t j = 0; j < cells_v[i].size(); ++j) cells_v[i][j] -= 1;
+        }
+    }
+}
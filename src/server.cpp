@@ -0,0 +1,714 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "scomplex/chain_calc.hpp"
+#include "scomplex/coeff_flow.hpp"
+#include "scomplex/cohomology.hpp"
+#include "scomplex/coeff_ring.hpp"
+#include "scomplex/components.hpp"
+#include "scomplex/mesh_generator.hpp"
+#include "scomplex/path_snapper.hpp"
+#include "scomplex/prepared_complex.hpp"
+#include "scomplex/simplicial_complex.hpp"
+#include "scomplex/surface.hpp"
+#include "scomplex/thread_pool.hpp"
+#include "scomplex/types.hpp"
+#include "scomplex/weld.hpp"
+
+#include "json_lines.hpp"
+#include "line_io.hpp"
+#include "mesh_loading.hpp"
+
+//
+// query server: loads meshes once, keeps them prepared and answers
+// bounding chain and snapping requests, one JSON document per line
+//
+// usage: flow_server config.yaml
+//
+// config:
+//   socket: /tmp/coeffflow.sock  # unix socket, stdin/stdout when left out
+//   workers: 8                   # default: one per hardware thread
+//   meshes:
+//     - name: bunny
+//       file: bunny.ply          # ply or obj, as for yamltest
+//     - name: grid
+//       generate: perturbed      # see gsimp::make_mesh_generator
+//       cells: 100000
+//       seed: 1
+//       reorder: true            # reordered for locality, requests and
+//                                # replies keep the original indices
+//       weld: 1e-6               # weld points closer than this and drop
+//                                # degenerate and duplicate cells (see
+//                                # gsimp::weld_mesh), vertices then index
+//                                # the welded points
+//       surface: true            # coeff_flow over the reals runs on the
+//                                # twin-edge surface engine (see
+//                                # gsimp::surface_mesh), same chains; meshes
+//                                # with non-manifold edges stay on the
+//                                # complex
+//
+// requests (replies echo "id" and carry "ok", "latency_us" from receipt to
+// reply and "service_us" for the work itself, or "error"):
+//   {"op": "meshes"}
+//   {"op": "snap", "mesh": "bunny", "path": [[x, y, z], ...]}
+//   {"op": "bounding_chain", "mesh": "bunny", "path": [[x, y, z], ...]}
+//       the cycle can also be given as "vertices": [i, j, ...] or as
+//       "chain": {"indices": [...], "coefficients": [...]}; "method" is
+//       "coeff_flow" (default), "sparse" (only walks the region the cycle
+//       encloses) or "lscg"; closed meshes take the top cell "null_cell"
+//       (default 0) as the one with coefficient 0; coeff_flow takes
+//       "coefficients": "real" (default), "int32", "int8" or "z2" for the
+//       ring it works over (z2 drops the orientations); "components" runs
+//       one flow per connected component the cycle touches and lists them
+//       as "components", each with "bounding" (the chain is zero on the
+//       others)
+//   {"op": "homology_class", "mesh": "bunny", ...}
+//       the cycle as for bounding_chain; "boundary" and its pairings with
+//       the cocycles of the mesh as "class" (all zero for boundaries)
+//   {"op": "stats"}     latency percentiles per operation
+//   {"op": "shutdown"}  stop the server once pending requests are answered
+//
+// requests of one connection are served concurrently, so replies may come
+// out of order.
+//
+
+typedef std::chrono::steady_clock server_clock;
+
+struct served_mesh {
+    std::string name;
+    std::shared_ptr< gsimp::simplicial_complex > s_comp;
+    std::shared_ptr< gsimp::path_snapper > snapper;
+    std::shared_ptr< gsimp::bounding_chain > solver;
+    // null when some facet has more than two cofaces
+    std::shared_ptr< gsimp::cohomology_basis > cohomology;
+    std::shared_ptr< gsimp::complex_components > components;
+    // null unless asked for and the mesh is a manifold surface
+    std::shared_ptr< gsimp::surface_link > surface;
+    bool closed;
+    gsimp::point_t lower, upper;  // bounding box
+};
+
+// the flows of the components of one request run here, apart from the
+// pool serving the requests (a task must not wait on its own pool)
+gsimp::thread_pool& component_pool() {
+    static gsimp::thread_pool pool;
+    return pool;
+}
+
+std::shared_ptr< served_mesh > load_served_mesh(const YAML::Node& config) {
+    auto mesh = std::make_shared< served_mesh >();
+    mesh->name = config["name"].as< std::string >();
+
+    std::vector< gsimp::point_t > points;
+    std::vector< gsimp::cell_t > cells;
+    if (config["file"]) {
+        load_mesh(config["file"].as< std::string >(), points, cells);
+    } else if (config["generate"]) {
+        auto gen = gsimp::make_mesh_generator(
+            config["generate"].as< std::string >(),
+            config["cells"] ? config["cells"].as< size_t >() : 10000,
+            config["seed"] ? config["seed"].as< unsigned >() : 1);
+        auto input = gsimp::complex_input(gsimp::generate_mesh(*gen));
+        points.swap(input.first);
+        cells.swap(input.second);
+    } else {
+        throw std::runtime_error("mesh " + mesh->name +
+                                 " needs a file or a generator\n");
+    }
+
+    if (config["weld"]) {
+        gsimp::weld_report welded = gsimp::weld_mesh(
+            points, cells, config["weld"].as< double >(), component_pool());
+        std::cerr << mesh->name << ": welded " << welded.welded_points
+                  << " points, dropped " << welded.degenerate_cells
+                  << " degenerate and " << welded.duplicate_cells
+                  << " duplicate cells\n";
+    }
+
+    // built from the triangles before the complex (which relabels them)
+    std::shared_ptr< gsimp::surface_mesh > surface;
+    if (config["surface"] && config["surface"].as< bool >()) {
+        try {
+            surface = std::make_shared< gsimp::surface_mesh >(points, cells);
+            if (!surface->is_manifold())
+                throw std::runtime_error(
+                    std::to_string(surface->non_manifold_edges().size()) +
+                    " non-manifold edges\n");
+        } catch (const std::runtime_error& e) {
+            std::cerr << mesh->name << ": no surface engine, " << e.what();
+            surface.reset();
+        }
+    }
+
+    int reordering = config["reorder"] && config["reorder"].as< bool >()
+                         ? gsimp::simplicial_complex::reorder_all
+                         : 0;
+    mesh->s_comp = std::make_shared< gsimp::simplicial_complex >(
+        points, cells, reordering);
+    gsimp::prepared_complex prepared = gsimp::prepare_async(mesh->s_comp);
+
+    // closed when no facet is on the boundary (waits for the Hasse diagram)
+    mesh->closed = mesh->s_comp->boundary_facets().empty();
+
+    if (!points.empty()) {
+        mesh->lower = mesh->upper = points[0];
+        for (auto& pt : points) {
+            for (size_t k = 0; k < pt.size(); ++k) {
+                mesh->lower[k] = std::min(mesh->lower[k], pt[k]);
+                mesh->upper[k] = std::max(mesh->upper[k], pt[k]);
+            }
+        }
+    }
+
+    mesh->snapper = prepared.snapper.get();
+    mesh->solver = prepared.solver.get();
+    prepared.wait();
+    try {
+        mesh->cohomology =
+            std::make_shared< gsimp::cohomology_basis >(mesh->s_comp);
+    } catch (const std::runtime_error&) {
+    }
+    mesh->components = std::make_shared< gsimp::complex_components >(
+        mesh->s_comp, component_pool());
+    if (surface) {
+        try {
+            mesh->surface =
+                std::make_shared< gsimp::surface_link >(surface, *mesh->s_comp);
+        } catch (const std::runtime_error& e) {
+            std::cerr << mesh->name << ": no surface engine, " << e.what();
+        }
+    }
+    return mesh;
+}
+
+// latencies of the last max_samples requests of each operation
+class latency_log {
+    static const size_t max_samples = 1 << 20;
+
+    struct op_log {
+        size_t count = 0;
+        size_t errors = 0;
+        std::vector< double > samples;
+    };
+
+    std::mutex mtx;
+    std::map< std::string, op_log > ops;
+
+   public:
+    void record(const std::string& op, double micros, bool ok) {
+        std::lock_guard< std::mutex > lock(mtx);
+        op_log& log = ops[op];
+        if (log.samples.size() < max_samples)
+            log.samples.push_back(micros);
+        else
+            log.samples[log.count % max_samples] = micros;
+        log.count++;
+        if (!ok) log.errors++;
+    }
+
+    // {"op": {"count", "errors", "p50_us", "p90_us", "p99_us", "max_us"}}
+    std::string summary() {
+        std::lock_guard< std::mutex > lock(mtx);
+        std::string out = "{";
+        for (auto& op : ops) {
+            std::vector< double > sorted(op.second.samples);
+            std::sort(sorted.begin(), sorted.end());
+            auto pct = [&](double p) {
+                size_t rank = std::ceil(p / 100 * sorted.size());
+                return sorted[std::max< size_t >(rank, 1) - 1];
+            };
+            if (out.size() > 1) out += ",";
+            out += json::quote(op.first) +
+                   ":{\"count\":" + json::number(op.second.count) +
+                   ",\"errors\":" + json::number(op.second.errors) +
+                   ",\"p50_us\":" + json::number(std::round(pct(50))) +
+                   ",\"p90_us\":" + json::number(std::round(pct(90))) +
+                   ",\"p99_us\":" + json::number(std::round(pct(99))) +
+                   ",\"max_us\":" + json::number(std::round(pct(100))) + "}";
+        }
+        return out + "}";
+    }
+};
+
+class request_error : public std::runtime_error {
+   public:
+    explicit request_error(const std::string& what)
+        : std::runtime_error(what) {}
+};
+
+struct server_state {
+    std::map< std::string, std::shared_ptr< served_mesh > > meshes;
+    latency_log latencies;
+    std::atomic< bool > stopping{false};
+    int listen_fd = -1;
+};
+
+const served_mesh& find_mesh(server_state& state, const json::value& req) {
+    auto it = state.meshes.find(req["mesh"].as_string());
+    if (it == state.meshes.end())
+        throw request_error("unknown mesh " + req["mesh"].as_string());
+    return *it->second;
+}
+
+std::vector< gsimp::point_t > parse_path(const served_mesh& mesh,
+                                         const json::value& path) {
+    if (!path.is_array() || path.size() < 2)
+        throw request_error("a path needs at least two points");
+    std::vector< gsimp::point_t > points;
+    for (auto& pt : path.array) {
+        if (!pt.is_array()) throw request_error("points are arrays");
+        gsimp::point_t point;
+        for (auto& c : pt.array) point.push_back(c.as_number());
+        if (point.size() != mesh.lower.size())
+            throw request_error("points do not match the mesh dimension");
+        points.push_back(point);
+    }
+    return points;
+}
+
+std::string sparse_chain(int d, const std::vector< double >& coefficients) {
+    std::vector< size_t > indices;
+    std::vector< double > values;
+    for (size_t i = 0; i < coefficients.size(); ++i) {
+        if (coefficients[i] != 0) {
+            indices.push_back(i);
+            values.push_back(coefficients[i]);
+        }
+    }
+    return "{\"dimension\":" + json::number(d) +
+           ",\"indices\":" + json::array(indices) +
+           ",\"coefficients\":" + json::array(values) + "}";
+}
+
+std::string sparse_chain(const gsimp::chain_t& chain) {
+    std::vector< size_t > indices;
+    std::vector< double > values;
+    for (gsimp::vector_t::InnerIterator it(chain.second); it; ++it) {
+        indices.push_back(it.index());
+        values.push_back(it.value());
+    }
+    return "{\"dimension\":" + json::number(chain.first) +
+           ",\"indices\":" + json::array(indices) +
+           ",\"coefficients\":" + json::array(values) + "}";
+}
+
+gsimp::chain_v request_cycle(const served_mesh& mesh,
+                             const json::value& req) {
+    int d = mesh.s_comp->dimension();
+    if (req.has("chain")) {
+        const json::value& chain = req["chain"];
+        const json::value& indices = chain["indices"];
+        const json::value& coefficients = chain["coefficients"];
+        if (!indices.is_array() || !coefficients.is_array() ||
+            indices.size() != coefficients.size())
+            throw request_error(
+                "a chain has matching indices and coefficients");
+        gsimp::chain_v cycle = mesh.s_comp->new_v_chain(d - 1);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            size_t index = indices[i].as_index();
+            if (index >= gsimp::chain_size(cycle))
+                throw request_error("chain index out of range");
+            gsimp::chain_val(cycle, index) += coefficients[i].as_number();
+        }
+        return mesh.s_comp->from_original_order(cycle);
+    }
+    // paths are 1-cycles
+    if (d != 2) throw request_error("paths only bound on surfaces");
+    if (req.has("vertices")) {
+        std::vector< size_t > vertices;
+        for (auto& v : req["vertices"].array) {
+            vertices.push_back(v.as_index());
+            if (vertices.back() >= (size_t)mesh.s_comp->get_level_size(0))
+                throw request_error("vertex index out of range");
+        }
+        if (vertices.size() < 2) throw request_error("too few vertices");
+        // throws when consecutive vertices share no edge
+        gsimp::chain_v cycle;
+        if (!mesh.s_comp->reordered()) {
+            mesh.snapper->index_sequence_to_v_chain(vertices, cycle);
+            return cycle;
+        }
+        std::vector< size_t > labels = mesh.s_comp->reordered_cell(vertices);
+        try {
+            mesh.snapper->index_sequence_to_v_chain(labels, cycle);
+        } catch (const std::runtime_error&) {
+            // the error names the vertices as the request did: the first
+            // pair whose vertex has no edge to the next one
+            for (size_t i = 0; i + 1 < labels.size(); ++i) {
+                if (labels[i] == labels[i + 1]) continue;
+                size_t v = mesh.s_comp->cell_to_index({labels[i]});
+                bool found = false;
+                for (size_t e : mesh.s_comp->get_cofaces_index(0, v)) {
+                    auto edge = mesh.s_comp->index_to_cell(1, e);
+                    found = found || edge[0] == labels[i + 1] ||
+                            edge[1] == labels[i + 1];
+                }
+                if (!found)
+                    throw request_error("no edge between the vertices " +
+                                        std::to_string(vertices[i]) +
+                                        " and " +
+                                        std::to_string(vertices[i + 1]));
+            }
+            throw;
+        }
+        return cycle;
+    }
+    return mesh.snapper->snap_path_to_v_chain(parse_path(mesh, req["path"]));
+}
+
+// the top cell at zero on closed meshes, in the order of the complex
+size_t request_null_cell(const served_mesh& mesh, const json::value& req) {
+    int d = mesh.s_comp->dimension();
+    size_t null_index = req.has("null_cell") ? req["null_cell"].as_index() : 0;
+    if (null_index >= (size_t)mesh.s_comp->get_level_size(d))
+        throw request_error("null_cell out of range");
+    return mesh.s_comp->reordered_index(d, null_index);
+}
+
+// the bounding chain over the ring R, in the order of the complex
+template < typename R >
+gsimp::chain_v ring_bounding_chain(const served_mesh& mesh,
+                                   const gsimp::chain_v& cycle,
+                                   const json::value& req) {
+    gsimp::ring_chain< R > p = gsimp::to_ring_chain< R >(cycle), b_chain;
+    if (mesh.closed)
+        gsimp::coeff_flow(*mesh.s_comp, p, request_null_cell(mesh, req),
+                          typename R::value_type(0), b_chain);
+    else
+        gsimp::coeff_flow_embedded(*mesh.s_comp, p, b_chain);
+    return gsimp::to_chain_v(b_chain);
+}
+
+std::string bounding_chain_reply(const served_mesh& mesh,
+                                 const json::value& req) {
+    int d = mesh.s_comp->dimension();
+    gsimp::chain_v cycle = request_cycle(mesh, req);
+    std::string method =
+        req.has("method") ? req["method"].as_string() : "coeff_flow";
+    if (method == "components") {
+        std::vector< gsimp::component_flow > report;
+        gsimp::chain_v b_chain = mesh.s_comp->to_original_order(
+            gsimp::coeff_flow_components(*mesh.s_comp, *mesh.components, cycle,
+                                         report, component_pool()));
+        std::string out = "\"chain\":" +
+                          sparse_chain(d, gsimp::chain_rep_v(b_chain)) +
+                          ",\"components\":[";
+        for (auto& flow : report) {
+            if (out.back() != '[') out += ",";
+            size_t c = flow.component;
+            out += "{\"component\":" + json::number(c) + ",\"cells\":" +
+                   json::number(mesh.components->end(c) -
+                                mesh.components->begin(c)) +
+                   ",\"bounding\":" + (flow.bounding ? "true" : "false") +
+                   "}";
+        }
+        return out + "]";
+    }
+    // rejected before any flow runs, when over the reals (the basis is):
+    // other rings may bound what the reals do not, z2 ignores the signs
+    std::string ring = method == "coeff_flow" && req.has("coefficients")
+                           ? req["coefficients"].as_string()
+                           : "real";
+    if (ring == "real" && mesh.cohomology &&
+        !mesh.cohomology->is_boundary(cycle))
+        throw gsimp::no_bounding_chain();
+
+    if (method == "lscg") {
+        gsimp::chain_t sparse = mesh.s_comp->new_chain(d - 1);
+        for (size_t i = 0; i < gsimp::chain_size(cycle); ++i)
+            if (gsimp::chain_val(cycle, i) != 0)
+                gsimp::chain_rep(sparse).insertBack(i) =
+                    gsimp::chain_val(cycle, i);
+        gsimp::chain_t b_chain = mesh.solver->get_bounding_chain(sparse);
+        std::vector< double > dense(gsimp::chain_size(b_chain), 0);
+        for (gsimp::vector_t::InnerIterator it(gsimp::chain_rep(b_chain)); it;
+             ++it)
+            dense[it.index()] = it.value();
+        gsimp::chain_v original =
+            mesh.s_comp->to_original_order(gsimp::chain_v(d, dense));
+        return "\"chain\":" + sparse_chain(d, gsimp::chain_rep_v(original));
+    }
+    if (method == "sparse") {
+        gsimp::chain_t sparse = mesh.s_comp->new_chain(d - 1);
+        for (size_t i = 0; i < gsimp::chain_size(cycle); ++i)
+            if (gsimp::chain_val(cycle, i) != 0)
+                gsimp::chain_rep(sparse).insertBack(i) =
+                    gsimp::chain_val(cycle, i);
+        gsimp::chain_t b_chain;
+        if (mesh.closed) {
+            std::vector< std::pair< size_t, double > > cells;
+            gsimp::coeff_flow_sparse(*mesh.s_comp, sparse,
+                                     request_null_cell(mesh, req), cells);
+            b_chain = mesh.s_comp->new_chain(d);
+            for (auto& cell : cells)
+                gsimp::chain_rep(b_chain).insertBack(cell.first) =
+                    cell.second;
+        } else {
+            gsimp::coeff_flow_local(*mesh.s_comp, sparse, b_chain);
+        }
+        return "\"chain\":" +
+               sparse_chain(mesh.s_comp->to_original_order(b_chain));
+    }
+    if (method != "coeff_flow") throw request_error("unknown method " + method);
+
+    gsimp::chain_v b_chain;
+    if (ring == "int32") {
+        b_chain = ring_bounding_chain< gsimp::int32_ring >(mesh, cycle, req);
+    } else if (ring == "int8") {
+        b_chain = ring_bounding_chain< gsimp::int8_ring >(mesh, cycle, req);
+    } else if (ring == "z2") {
+        b_chain = mesh.s_comp->to_original_order(
+            ring_bounding_chain< gsimp::z2_ring >(mesh, cycle, req));
+        // reorienting cells only changes signs, which z2 does not have
+        for (auto& c : gsimp::chain_rep_v(b_chain)) c = std::abs(c);
+        return "\"chain\":" + sparse_chain(d, gsimp::chain_rep_v(b_chain));
+    } else if (ring != "real") {
+        throw request_error("unknown coefficients " + ring);
+    } else if (mesh.closed && mesh.surface) {
+        mesh.surface->coeff_flow(cycle, request_null_cell(mesh, req), 0,
+                                 b_chain);
+    } else if (mesh.closed) {
+        size_t null_index = request_null_cell(mesh, req);
+        b_chain = gsimp::coeff_flow(
+            *mesh.s_comp, cycle, mesh.s_comp->index_to_cell(d, null_index), 0);
+    } else if (mesh.surface) {
+        mesh.surface->coeff_flow_embedded(cycle, b_chain);
+    } else {
+        b_chain = gsimp::coeff_flow_embedded(*mesh.s_comp, cycle);
+    }
+    b_chain = mesh.s_comp->to_original_order(b_chain);
+    return "\"chain\":" + sparse_chain(d, gsimp::chain_rep_v(b_chain));
+}
+
+std::string homology_class_reply(const served_mesh& mesh,
+                                 const json::value& req) {
+    if (!mesh.cohomology)
+        throw request_error("no cohomology basis for mesh " + mesh.name);
+    gsimp::chain_v cycle = request_cycle(mesh, req);
+    if (!mesh.cohomology->is_cycle(cycle))
+        throw request_error("the chain is not a cycle");
+    std::vector< double > coordinates;
+    mesh.cohomology->homology_class(cycle, coordinates);
+    bool boundary = std::all_of(coordinates.begin(), coordinates.end(),
+                                [](double c) { return c == 0; });
+    return std::string("\"boundary\":") + (boundary ? "true" : "false") +
+           ",\"class\":" + json::array(coordinates);
+}
+
+std::string snap_reply(const served_mesh& mesh, const json::value& req) {
+    auto vertices =
+        mesh.snapper->snap_path_to_indices(parse_path(mesh, req["path"]));
+    gsimp::chain_v chain = mesh.s_comp->to_original_order(
+        mesh.snapper->index_sequence_to_v_chain(vertices));
+    vertices = mesh.s_comp->original_cell(vertices);
+    return "\"vertices\":" + json::array(vertices) +
+           ",\"chain\":" + sparse_chain(1, gsimp::chain_rep_v(chain));
+}
+
+std::string meshes_reply(server_state& state) {
+    std::string out = "\"meshes\":[";
+    for (auto& entry : state.meshes) {
+        const served_mesh& mesh = *entry.second;
+        int d = mesh.s_comp->dimension();
+        if (out.back() != '[') out += ",";
+        size_t top_cells = mesh.s_comp->get_level_size(d);
+        out += "{\"name\":" + json::quote(mesh.name) +
+               ",\"dimension\":" + json::number(d) +
+               ",\"vertices\":" + json::number(mesh.s_comp->get_level_size(0)) +
+               ",\"top_cells\":" + json::number(top_cells) +
+               ",\"closed\":" + (mesh.closed ? "true" : "false") +
+               ",\"components\":" + json::number(mesh.components->size()) +
+               ",\"cocycles\":" +
+               (mesh.cohomology ? json::number(mesh.cohomology->rank())
+                                : std::string("null")) +
+               ",\"lower\":" + json::array(mesh.lower) +
+               ",\"upper\":" + json::array(mesh.upper) + "}";
+    }
+    return out + "]";
+}
+
+// a client (or stdin/stdout), alive while it is read or has pending replies
+struct connection {
+    int in_fd, out_fd;
+    std::mutex write_mtx;
+
+    connection(int _in, int _out) : in_fd(_in), out_fd(_out) {}
+    ~connection() {
+        if (in_fd > 2) close(in_fd);
+    }
+
+    void reply(const std::string& line) {
+        std::lock_guard< std::mutex > lock(write_mtx);
+        try {
+            write_all(out_fd, line);
+        } catch (const std::exception&) {
+            // the client went away, nothing left to tell it
+        }
+    }
+};
+
+void serve_request(server_state& state, connection& conn,
+                   const std::string& line, server_clock::time_point received) {
+    std::string op = "invalid", id = "null", body, error;
+    auto started = server_clock::now();
+    try {
+        json::value req = json::parse(line);
+        if (req["id"].is_number()) id = json::number(req["id"].number);
+        if (req["id"].is_string()) id = json::quote(req["id"].string);
+        op = req["op"].as_string();
+
+        if (op == "bounding_chain")
+            body = bounding_chain_reply(find_mesh(state, req), req);
+        else if (op == "homology_class")
+            body = homology_class_reply(find_mesh(state, req), req);
+        else if (op == "snap")
+            body = snap_reply(find_mesh(state, req), req);
+        else if (op == "meshes")
+            body = meshes_reply(state);
+        else if (op == "stats")
+            body = "\"stats\":" + state.latencies.summary();
+        else if (op == "shutdown") {
+            state.stopping = true;
+            if (state.listen_fd >= 0) shutdown(state.listen_fd, SHUT_RDWR);
+        } else
+            throw request_error("unknown op " + op);
+    } catch (const gsimp::no_bounding_chain&) {
+        error = "the chain is not a boundary";
+    } catch (const gsimp::non_zero_chain&) {
+        error = "the chain is not a boundary";
+    } catch (const gsimp::out_of_context&) {
+        error = "the chain does not fit the mesh";
+    } catch (const std::exception& e) {
+        error = e.what();
+        if (!error.empty() && error.back() == '\n') error.pop_back();
+    }
+
+    auto done = server_clock::now();
+    double service = std::chrono::duration< double, std::micro >(done - started)
+                         .count();
+    double latency =
+        std::chrono::duration< double, std::micro >(done - received).count();
+    state.latencies.record(op, latency, error.empty());
+
+    std::string reply = "{\"id\":" + id +
+                        ",\"ok\":" + (error.empty() ? "true" : "false") +
+                        ",\"latency_us\":" + json::number(std::round(latency)) +
+                        ",\"service_us\":" + json::number(std::round(service));
+    if (!error.empty())
+        reply += ",\"error\":" + json::quote(error);
+    else if (!body.empty())
+        reply += "," + body;
+    conn.reply(reply + "}\n");
+}
+
+// the reader stops at a shutdown right away, the workers only get to it later
+bool is_shutdown(const std::string& line) {
+    try {
+        json::value req = json::parse(line);
+        return req["op"].is_string() && req["op"].string == "shutdown";
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+void read_requests(server_state& state, gsimp::thread_pool& pool,
+                   std::shared_ptr< connection > conn) {
+    line_reader reader(conn->in_fd);
+    std::string line;
+    while (!state.stopping && reader.next(line)) {
+        if (line.empty()) continue;
+        auto received = server_clock::now();
+        if (is_shutdown(line)) state.stopping = true;
+        pool.submit([&state, conn, line, received] {
+            serve_request(state, *conn, line, received);
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "usage: flow_server config.yaml\n";
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    YAML::Node config = YAML::LoadFile(argv[1]);
+
+    server_state state;
+    for (auto mesh_config : config["meshes"]) {
+        auto t0 = server_clock::now();
+        auto mesh = load_served_mesh(mesh_config);
+        double seconds =
+            std::chrono::duration< double >(server_clock::now() - t0).count();
+        std::cerr << "prepared " << mesh->name << " ("
+                  << mesh->s_comp->get_level_size(mesh->s_comp->dimension())
+                  << " top cells) in " << seconds << " seconds\n";
+        state.meshes[mesh->name] = mesh;
+    }
+
+    // declared after the meshes: pending requests finish before they go
+    std::unique_ptr< gsimp::thread_pool > pool(new gsimp::thread_pool(
+        config["workers"] ? config["workers"].as< size_t >() : 0));
+
+    if (!config["socket"]) {
+        // replies get a copy of stdout to themselves, stdout then goes to
+        // stderr: nothing the library prints can land among the replies
+        std::cout.flush();
+        int reply_fd = dup(STDOUT_FILENO);
+        if (reply_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            std::cerr << "failed to set up stdout for the replies\n";
+            return 1;
+        }
+        auto conn = std::make_shared< connection >(STDIN_FILENO, reply_fd);
+        read_requests(state, *pool, conn);
+        pool.reset();
+    } else {
+        std::string path = config["socket"].as< std::string >();
+        state.listen_fd = listen_unix(path);
+        std::cerr << "listening on " << path << " with " << pool->size()
+                  << " workers\n";
+
+        std::vector< std::thread > readers;
+        std::mutex clients_mtx;
+        std::vector< std::weak_ptr< connection > > clients;
+        while (!state.stopping) {
+            int fd = accept(state.listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            auto conn = std::make_shared< connection >(fd, fd);
+            {
+                std::lock_guard< std::mutex > lock(clients_mtx);
+                clients.push_back(conn);
+            }
+            readers.emplace_back(
+                [&state, &pool, conn] { read_requests(state, *pool, conn); });
+        }
+
+        // wake up the readers still waiting on their clients
+        {
+            std::lock_guard< std::mutex > lock(clients_mtx);
+            for (auto& client : clients)
+                if (auto conn = client.lock()) shutdown(conn->in_fd, SHUT_RD);
+        }
+        for (auto& reader : readers) reader.join();
+        pool.reset();
+        close(state.listen_fd);
+        unlink(path.c_str());
+    }
+
+    std::cerr << "latencies: " << state.latencies.summary() << "\n";
+    return 0;
+}
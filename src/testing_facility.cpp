@@ -7,16 +7,17 @@
 #include <algorithm>
 #include "scomplex/chain_calc.hpp"
 #include "scomplex/coeff_flow.hpp"
+#include "scomplex/metrics.hpp"
 #include "scomplex/path_snapper.hpp"
 #include "scomplex/plywriter.hpp"
+#include "scomplex/prepared_complex.hpp"
 #include "scomplex/qhull_parsing.hpp"
 #include "scomplex/simplicial_complex.hpp"
 #include "scomplex/types.hpp"
 
-#include "tiny_obj_loader.h"
-#include "tinyply.h"
+#include "mesh_loading.hpp"
 
-#include <time.h>
+#include <chrono>
 
 void call_single_cycle_test(std::string, std::vector< size_t >,
                             std::vector< std::vector< double > >, size_t, bool);
@@ -65,6 +66,14 @@ int main(int argc, char* argv[]) {
                                    in_plane);
         }
     }
+
+    // per phase totals and a trace of the run, next to the ply outputs
+    if (gsimp::metrics::enabled()) {
+        std::ofstream metrics_file("metrics.json");
+        gsimp::metrics::write_json(metrics_file);
+        std::ofstream trace_file("trace.json");
+        gsimp::metrics::write_chrome_trace(trace_file);
+    }
 }
 
 void call_single_cycle_test(std::string complex_file,
@@ -92,24 +101,17 @@ void call_single_cycle_test(std::string complex_file,
     call_single_cycle_test(complex_file, cycle_indices, {}, null_face, false);
 }
 
-template < typename T >
-struct vec3 {
-    T x, y, z;
 
-    std::vector< double > point() {
-        std::vector< double > vec_;
-        vec_.push_back(double(x));
-        vec_.push_back(double(y));
-        vec_.push_back(double(z));
-        return vec_;
-    }
+// wall clock time since the last lap (or construction) in seconds
+struct lap_timer {
+    std::chrono::steady_clock::time_point start{
+        std::chrono::steady_clock::now()};
 
-    std::vector< size_t > simp() {
-        std::vector< size_t > vec_;
-        vec_.push_back(size_t(x));
-        vec_.push_back(size_t(y));
-        vec_.push_back(size_t(z));
-        return vec_;
+    double lap() {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration< double >(now - start).count();
+        start = now;
+        return seconds;
     }
 };
 
@@ -136,111 +138,25 @@ void call_single_cycle_test(std::string complex_file,
     std::vector< point_t > points_v;
     std::vector< cell_t > cells_v;
 
-    clock_t t0, t1;
-    t0 = clock();
-
-    std::ifstream file(complex_file);
-    std::string meshtype;
-    std::getline(file, meshtype);
-
-    if (meshtype == "ply") {
-        tinyply::PlyFile plyMeshFile;
-        plyMeshFile.parse_header(file);
-
-        std::shared_ptr< tinyply::PlyData > vertices, faces;
-        try {
-            vertices = plyMeshFile.request_properties_from_element(
-                "vertex", {"x", "y", "z"});
-            faces = plyMeshFile.request_properties_from_element(
-                "face", {"vertex_indices"});
-        } catch (const std::exception& e) {
-            std::cerr << "tinyply exception: " << e.what() << std::endl;
-        }
-
-        plyMeshFile.read(file);
-
-        {
-            const size_t numVerticesBytes = vertices->buffer.size_bytes();
-            std::vector< vec3< float > > verts(vertices->count);
-            std::memcpy(verts.data(), vertices->buffer.get(), numVerticesBytes);
-            for (vec3< float > v : verts) {
-                points_v.push_back(v.point());
-            }
-        }
-
-        {
-            const size_t numFacesBytes = faces->buffer.size_bytes();
-            std::vector< vec3< uint32_t > > faces_(faces->count);
-            std::memcpy(faces_.data(), faces->buffer.get(), numFacesBytes);
-            for (vec3< uint32_t > f : faces_) {
-                cells_v.push_back(f.simp());
-            }
-        }
-
-    } else {
-        tinyobj::attrib_t attrib;
-        std::vector< tinyobj::shape_t > shapes;
-        std::vector< tinyobj::material_t > materials;
-        const char* basepath = {};//= std::string("").c_str();
-        std::string err;
-        const char* filename = complex_file.c_str();
-
-        bool triangulate = false;
-
-        tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename, basepath,
-                         triangulate);
-
-        std::vector< double > vert;
-        for (size_t i = 0; i < attrib.vertices.size(); i++) {
-            vert.push_back(attrib.vertices.at(i));
-            if (i % 3 == 2) {
-                points_v.push_back(vert);
-                vert.clear();
-            }
-        }
+    lap_timer timer;
+    double seconds;
 
-        std::vector< size_t > face;
-        tinyobj::shape_t shape = shapes.at(0);
-        for (size_t i = 0; i < shape.mesh.indices.size(); i++) {
-            tinyobj::index_t idx = shape.mesh.indices.at(i);
-            face.push_back(idx.vertex_index);
-            if (i % 3 == 2) {
-                cells_v.push_back(face);
-                face.clear();
-            }
-        }
-    }
+    load_mesh(complex_file, points_v, cells_v);
 
-    t1 = clock();
+    seconds = timer.lap();
     std::cout << "mesh has " << points_v.size() << " vertices and "
               << cells_v.size() << " faces\n";
-    std::cout << "read mesh in " << t1 - t0 << " clock cycles "
-              << float(t1 - t0) / CLOCKS_PER_SEC << " seconds\n";
-
-    // watch out for 0 or 1 indexing
-    bool zero_index = true;
-    for (cell_t cell : cells_v) {
-        for (size_t vert : cell) {
-            if (vert >= points_v.size()) {
-                zero_index = false;
-                break;
-            }
-        }
-        if (!zero_index) break;
-    }
+    std::cout << "read mesh in " << seconds << " seconds\n";
 
-    if (!zero_index) {
-        for (int i = 0; i < cells_v.size(); ++i) {
-            for (int j = 0; j < cells_v[i].size(); ++j) cells_v[i][j] -= 1;
-        }
-    }
-
-    t0 = clock();
+    timer.lap();
     std::shared_ptr< gsimp::simplicial_complex > s_comp =
         std::make_shared< gsimp::simplicial_complex >(points_v, cells_v);
-    t1 = clock();
-    std::cout << "created complex in " << t1 - t0 << " clock cycles "
-              << float(t1 - t0) / CLOCKS_PER_SEC << " seconds\n";
+    seconds = timer.lap();
+    std::cout << "created complex in " << seconds << " seconds\n";
+
+    // snapper, solver, Hasse diagram and matrices are built in the
+    // background from here on, each step below only waits for what it uses
+    gsimp::prepared_complex prepared = gsimp::prepare_async(s_comp);
 
     std::cout << "complex comosition:\n";
     std::cout << "    number of faces: " << s_comp->get_level_size(2) << "\n";
@@ -269,14 +185,12 @@ void call_single_cycle_test(std::string complex_file,
     }
 
     // end sorting
-    t0 = clock();
-    std::shared_ptr< gsimp::path_snapper > p_snap =
-        std::make_shared< gsimp::path_snapper >(s_comp);
-    t1 = clock();
-    std::cout << "created snapper in " << t1 - t0 << " clock cycles "
-              << float(t1 - t0) / CLOCKS_PER_SEC << " seconds\n";
-
-    t0 = clock();
+    timer.lap();
+    std::shared_ptr< gsimp::path_snapper > p_snap = prepared.snapper.get();
+    seconds = timer.lap();
+    std::cout << "waited for the snapper for " << seconds << " seconds\n";
+
+    timer.lap();
     std::vector< size_t > snapped;
     if (cycle_indices.size() == 0)
         snapped = p_snap->snap_path_to_indices(cycle_points);
@@ -284,55 +198,48 @@ void call_single_cycle_test(std::string complex_file,
         snapped = cycle_indices;
     }
 
-    t1 = clock();
-    std::cout << "snapped path in " << t1 - t0 << " clock cycles "
-              << float(t1 - t0) / CLOCKS_PER_SEC << " seconds\n";
+    seconds = timer.lap();
+    std::cout << "snapped path in " << seconds << " seconds\n";
     std::cout << "computed path contains " << snapped.size() << " points\n";
 
-    t0 = clock();
+    timer.lap();
     gsimp::chain_v cycle = p_snap->index_sequence_to_v_chain(snapped);
-    t1 = clock();
-    std::cout << "produced chain from path in " << t1 - t0 << " clock cycles "
-              << float(t1 - t0) / CLOCKS_PER_SEC << " seconds\n";
-
-    t0 = clock();
-    gsimp::bounding_chain ch_calc(s_comp);
-    t1 = clock();
-    std::cout << "calculated boundary matrices in " << t1 - t0
-              << " clock cycles\
-        " << float(t1 - t0) / CLOCKS_PER_SEC
+    seconds = timer.lap();
+    std::cout << "produced chain from path in " << seconds << " seconds\n";
+
+    timer.lap();
+    std::shared_ptr< gsimp::bounding_chain > ch_calc = prepared.solver.get();
+    seconds = timer.lap();
+    std::cout << "waited for the boundary matrices for " << seconds
               << " seconds\n";
 
     gsimp::chain_t cycle2 = p_snap->index_sequence_to_chain(snapped);
-    t0 = clock();
-    gsimp::chain_t b_chain_0 = ch_calc.get_bounding_chain(cycle2);
-    t1 = clock();
-    std::cout << "calculated bounding chain (using Eigen) in " << t1 - t0 << "\
-        clock cycles "
-              << float(t1 - t0) / CLOCKS_PER_SEC << " seconds\n";
-
-    std::vector< std::vector< int > > colors;
-
-    for (size_t i = 0; i < gsimp::chain_size(b_chain_0); i++) {
-        if (std::abs(gsimp::chain_val(b_chain_0, i)) > 10e-3)
-            colors.push_back({255, 0, 0});
-        else
-            colors.push_back({255, 255, 255});
-    }
-
-    std::ofstream my_ply;
-    my_ply.open("my_ply.ply");
+    timer.lap();
+    gsimp::chain_t b_chain_0 = ch_calc->get_bounding_chain(cycle2);
+    seconds = timer.lap();
+    std::cout << "calculated bounding chain (using Eigen) in " << seconds
+              << " seconds\n";
 
-    std::vector< std::vector< size_t > > edges{};
-    std::vector< std::vector< int > > edge_colors{};
+    // flat copies of the mesh for the ply exports, faces in level order
+    std::vector< double > coordinates;
+    for (auto& pt : points_v)
+        coordinates.insert(coordinates.end(), pt.begin(), pt.end());
+    std::vector< size_t > faces;
+    for (auto& tri : cells_v) faces.insert(faces.end(), tri.begin(), tri.end());
+    const size_t point_dim = points_v.empty() ? 3 : points_v[0].size();
 
+    std::vector< size_t > edges{};
     for (size_t i = 0; i < gsimp::chain_size(cycle); i++) {
-        if (std::abs(gsimp::chain_val(cycle, i)) > 10e-3)
-            edges.push_back(s_comp->index_to_cell(1, i));
-        edge_colors.push_back({0, 0, 255});
+        if (std::abs(gsimp::chain_val(cycle, i)) > 10e-3) {
+            gsimp::cell_t edge = s_comp->index_to_cell(1, i);
+            edges.insert(edges.end(), edge.begin(), edge.end());
+        }
     }
 
-    make_ply(my_ply, s_comp->get_points(), cells_v, colors, edges, edge_colors);
+    std::ofstream my_ply("my_ply.ply", std::ios::binary);
+    const gsimp::vector_t& b_vec_0 = gsimp::chain_rep(b_chain_0);
+    make_chain_ply(my_ply, coordinates, point_dim, faces,
+                   [&](size_t i) { return b_vec_0.coeff(i); }, edges);
     my_ply.close();
 
 
@@ -345,13 +252,13 @@ void call_single_cycle_test(std::string complex_file,
         std::cout << "\n";
     }
 
-    t0 = clock();
-    s_comp->calculate_hasse();
-    t1 = clock();
-    std::cout << "calculated the hasse diagram in " << t1 - t0
-              << " clock cycles " << float(t1 - t0) / CLOCKS_PER_SEC
+    timer.lap();
+    prepared.hasse.get();
+    prepared.matrices.get();
+    seconds = timer.lap();
+    std::cout << "waited for the hasse diagram for " << seconds
               << " seconds\n";
-    t0 = clock();
+    timer.lap();
 
     gsimp::chain_v b_chain_1;
     if (!in_plane)
@@ -359,31 +266,13 @@ void call_single_cycle_test(std::string complex_file,
     else
         b_chain_1 = gsimp::coeff_flow_embedded(*s_comp, cycle);
 
-    t1 = clock();
-    std::cout << "calculated bounding chain using coeff_flow in " << t1 - t0
-              << " clock cycles " << float(t1 - t0) / CLOCKS_PER_SEC
+    seconds = timer.lap();
+    std::cout << "calculated bounding chain using coeff_flow in " << seconds
               << " seconds\n";
 
-    colors = {};
-    for (size_t i = 0; i < gsimp::chain_size(b_chain_1); i++) {
-        if (std::abs(gsimp::chain_val(b_chain_1, i)) > 10e-3)
-            colors.push_back({255, 0, 0});
-        else
-            colors.push_back({255, 255, 255});
-    }
-
-    std::ofstream my_ply2;
-    my_ply2.open("my_ply2.ply");
-
-    edges = {};
-    edge_colors = {};
-    for (size_t i = 0; i < gsimp::chain_size(cycle); i++) {
-        if (std::abs(gsimp::chain_val(cycle, i)) > 10e-3)
-            edges.push_back(s_comp->index_to_cell(1, i));
-        edge_colors.push_back({0, 0, 255});
-    }
-
-    make_ply(my_ply2, s_comp->get_points(), cells_v, colors, edges,
-             edge_colors);
+    std::ofstream my_ply2("my_ply2.ply", std::ios::binary);
+    const std::vector< double >& b_vec_1 = gsimp::chain_rep_v(b_chain_1);
+    make_chain_ply(my_ply2, coordinates, point_dim, faces,
+                   [&](size_t i) { return b_vec_1[i]; }, edges);
     my_ply2.close();
 }
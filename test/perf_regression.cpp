@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "scomplex/chain_calc.hpp"
+#include "scomplex/coeff_flow.hpp"
+#include "scomplex/memory.hpp"
+#include "scomplex/mesh_generator.hpp"
+#include "scomplex/path_snapper.hpp"
+#include "scomplex/simplicial_complex.hpp"
+#include "scomplex/types.hpp"
+
+//
+// performance regression test (run by ctest)
+//
+// usage: perf_regression --baseline test/perf_baseline.yaml [--reps N]
+//                        [--tolerance T]
+//        perf_regression --write-baseline test/perf_baseline.yaml [--reps N]
+//
+// fixed seed meshes go through every phase, the median time and the
+// allocations of each phase are compared against the baseline file.
+// times are normalized by a calibration workload timed on both machines, a
+// phase fails when it is slower than (1 + tolerance) times its expected
+// time or allocates more than (1 + allocation_tolerance) times its baseline
+// allocations. independently of the baseline, the index based queries and
+// the coefficient flow and snapping into reused outputs must not allocate at
+// all.
+//
+// phases missing from the baseline fail, so the baseline has to be
+// regenerated (on the reference machine) when phases or meshes are added.
+// a phase listed without seconds (or allocations) skips that comparison
+// only.
+//
+// allocations are counted through the global operator new, Eigen's dense
+// vectors and matrices go straight to malloc (aligned_malloc) and are not
+// counted: the lscg allocations are understated.
+//
+
+typedef std::chrono::steady_clock perf_clock;
+
+GSIMP_COUNT_ALLOCATIONS()
+
+struct measurement {
+    double seconds;        // median over the repetitions
+    uint64_t allocations;  // of the last repetition
+};
+
+typedef std::map< std::string, std::map< std::string, measurement > >
+    results_t;
+
+const std::vector< std::string > phases{
+    "construction", "hasse", "matrices",   "snapper",
+    "snapping",     "lscg",  "coeff_flow", "index_queries",
+    "flow_queries"};
+
+// phases that must not allocate at all
+bool allocation_free(const std::string& phase) {
+    return phase == "index_queries" || phase == "flow_queries";
+}
+
+std::vector< std::unique_ptr< gsimp::mesh_generator > > test_meshes() {
+    std::vector< std::unique_ptr< gsimp::mesh_generator > > meshes;
+    meshes.emplace_back(new gsimp::grid_mesh(60, 60, 0.4, true, 7));
+    meshes.emplace_back(new gsimp::torus_mesh(80, 20, 2, 0.2, 7));
+    meshes.emplace_back(new gsimp::block_mesh(10, 10, 10, 0.2, 7));
+    return meshes;
+}
+
+double median(std::vector< double > values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// fixed mix of sorting and node based container work, the kind of work the
+// library does, to compare machines with
+double calibration(size_t reps) {
+    std::vector< double > times;
+    for (size_t rep = 0; rep < reps; ++rep) {
+        auto t0 = perf_clock::now();
+        std::vector< double > values(1 << 20);
+        for (size_t i = 0; i < values.size(); ++i)
+            values[i] = gsimp::mesh_gen::noise(1, i, 0);
+        std::sort(values.begin(), values.end());
+        std::map< uint64_t, size_t > tree;
+        for (size_t i = 0; i < (1 << 17); ++i)
+            tree[gsimp::mesh_gen::splitmix64(i)] = i;
+        auto t1 = perf_clock::now();
+        if (values.front() > values.back() || tree.size() != (1 << 17))
+            throw std::runtime_error("calibration went wrong\n");
+        times.push_back(std::chrono::duration< double >(t1 - t0).count());
+    }
+    return median(times);
+}
+
+class phase_timer {
+    std::map< std::string, std::vector< double > > times;
+    std::map< std::string, uint64_t > allocations;
+
+   public:
+    template < typename F >
+    void run(const std::string& phase, F f) {
+        gsimp::memory::allocation_scope allocs;
+        auto t0 = perf_clock::now();
+        f();
+        auto t1 = perf_clock::now();
+        allocations[phase] = allocs.delta().allocations;
+        times[phase].push_back(
+            std::chrono::duration< double >(t1 - t0).count());
+    }
+
+    std::map< std::string, measurement > results() {
+        std::map< std::string, measurement > res;
+        for (auto& phase : times)
+            res[phase.first] = {median(phase.second),
+                                allocations[phase.first]};
+        return res;
+    }
+};
+
+// every boundary and coface query by index, through reused output vectors
+void index_queries(gsimp::simplicial_complex& s_comp) {
+    static std::vector< size_t > faces(16);
+    static std::vector< std::pair< int, size_t > > signed_faces(16);
+    int d = s_comp.dimension();
+    for (size_t i = 0; i < (size_t)s_comp.get_level_size(d); ++i) {
+        s_comp.cell_boundary_index(d, i, faces);
+        s_comp.get_bdry_and_ind_index(d, i, signed_faces);
+    }
+    for (size_t i = 0; i < (size_t)s_comp.get_level_size(d - 1); ++i) {
+        s_comp.get_cofaces_index(d - 1, i, faces);
+        s_comp.get_cof_and_ind_index(d - 1, i, signed_faces);
+        for (auto& coface : signed_faces)
+            s_comp.boundary_inclusion_index(d - 1, i, d, coface.second);
+    }
+}
+
+std::map< std::string, measurement > run_mesh(
+    const gsimp::mesh_generator& gen, size_t reps) {
+    gsimp::thread_pool pool;
+    auto input = gsimp::complex_input(gsimp::generate_mesh(gen, pool));
+
+    std::vector< gsimp::point_t > cycle_points;
+    auto loops = gen.boundary_loops();
+    if (!loops.empty()) {
+        size_t stride = std::max< size_t >(1, loops[0].size() / 8);
+        for (size_t i = 0; i < loops[0].size(); i += stride)
+            cycle_points.push_back(input.first[loops[0][i]]);
+        cycle_points.push_back(cycle_points.front());
+    }
+
+    phase_timer timer;
+    for (size_t rep = 0; rep < reps; ++rep) {
+        std::vector< gsimp::point_t > points(input.first);
+        std::vector< gsimp::cell_t > cells(input.second);
+        std::shared_ptr< gsimp::simplicial_complex > s_comp;
+        std::shared_ptr< gsimp::bounding_chain > solver;
+        std::shared_ptr< gsimp::path_snapper > snapper;
+
+        timer.run("construction", [&] {
+            s_comp =
+                std::make_shared< gsimp::simplicial_complex >(points, cells);
+        });
+        timer.run("hasse", [&] { s_comp->calculate_hasse(); });
+        timer.run("matrices", [&] {
+            solver = std::make_shared< gsimp::bounding_chain >(s_comp);
+        });
+        if (gen.dimension() == 2) {
+            timer.run("snapper", [&] {
+                snapper = std::make_shared< gsimp::path_snapper >(s_comp);
+            });
+            if (!cycle_points.empty())
+                timer.run("snapping", [&] {
+                    snapper->snap_path_to_indices(cycle_points);
+                });
+        }
+
+        auto pair = gsimp::known_pair(*s_comp, gen);
+        gsimp::chain_t cycle = s_comp->new_chain(gen.dimension() - 1);
+        for (size_t i = 0; i < gsimp::chain_size(pair.first); ++i)
+            if (gsimp::chain_val(pair.first, i) != 0)
+                gsimp::chain_rep(cycle).insertBack(i) =
+                    gsimp::chain_val(pair.first, i);
+
+        timer.run("lscg", [&] {
+            try {
+                solver->get_bounding_chain(cycle);
+            } catch (const gsimp::non_zero_chain&) {
+            }
+        });
+        gsimp::chain_v result;
+        timer.run("coeff_flow", [&] {
+            result = gen.closed() ? gsimp::coeff_flow(*s_comp, pair.first,
+                                                      gsimp::null_cell(gen), 0)
+                                  : gsimp::coeff_flow_embedded(*s_comp,
+                                                               pair.first);
+        });
+        if (gsimp::chain_rep_v(result) != gsimp::chain_rep_v(pair.second))
+            throw std::runtime_error("coeff_flow gave a wrong bounding chain "
+                                     "on " + gen.name() + "\n");
+
+        // first pass sizes the output vectors
+        index_queries(*s_comp);
+        timer.run("index_queries", [&] { index_queries(*s_comp); });
+
+        // steady state queries: outputs and workspace sized by the first run
+        std::vector< size_t > snapped;
+        size_t null_index =
+            gen.closed() ? s_comp->cell_to_index(gsimp::null_cell(gen)) : 0;
+        auto flow_queries = [&] {
+            if (snapper && !cycle_points.empty())
+                snapper->snap_path_to_indices(cycle_points, snapped);
+            if (gen.closed())
+                gsimp::coeff_flow(*s_comp, pair.first, null_index, 0, result);
+            else
+                gsimp::coeff_flow_embedded(*s_comp, pair.first, result);
+        };
+        flow_queries();
+        timer.run("flow_queries", flow_queries);
+    }
+    return timer.results();
+}
+
+void write_baseline(const std::string& filename, double calib,
+                    const results_t& results) {
+    std::ofstream out(filename);
+    out << "# baseline for the perf_regression test (test/perf_regression.cpp)\n"
+        << "# regenerate on the reference machine with\n"
+        << "#   perf_regression --write-baseline test/perf_baseline.yaml\n"
+        << "# a phase may get its own tolerance next to seconds/allocations\n"
+        << "calibration: " << calib << "\n"
+        << "tolerance: 0.5\n"
+        << "allocation_tolerance: 0.05\n"
+        << "meshes:\n";
+    for (auto& mesh : results) {
+        out << "  " << mesh.first << ":\n";
+        for (auto& phase : mesh.second)
+            out << "    " << phase.first
+                << ": {seconds: " << phase.second.seconds
+                << ", allocations: " << phase.second.allocations << "}\n";
+    }
+}
+
+// prints one line per phase, returns the number of failed checks
+int compare(const YAML::Node& baseline, double calib, double tolerance,
+            const results_t& results) {
+    double base_calib = baseline["calibration"].as< double >();
+    double alloc_tolerance = baseline["allocation_tolerance"].as< double >();
+    double scale = calib / base_calib;
+    int failures = 0, missing = 0;
+
+    std::printf("calibration %.4fs, baseline %.4fs: times scaled by %.2f\n\n",
+                calib, base_calib, scale);
+    std::printf("%-22s %-14s %11s %11s %8s %10s %10s  %s\n", "mesh", "phase",
+                "expected", "measured", "change", "allocs", "base", "status");
+
+    // const nodes: looking up a missing key must not insert it
+    const YAML::Node meshes = baseline["meshes"];
+    for (auto& mesh : results) {
+        const YAML::Node base_mesh = meshes[mesh.first];
+        for (auto& phase_name : phases) {
+            auto found = mesh.second.find(phase_name);
+            if (found == mesh.second.end()) continue;
+            const measurement& m = found->second;
+
+            std::string status;
+            if (allocation_free(phase_name) && m.allocations != 0) {
+                status += " ALLOCATES";
+                failures++;
+            }
+            const YAML::Node base =
+                base_mesh.IsDefined() ? base_mesh[phase_name] : YAML::Node();
+            if (!base.IsDefined() || !base.IsMap()) {
+                std::printf("%-22s %-14s %11s %10.4fs %8s %10llu %10s  "
+                            "NO BASELINE%s\n",
+                            mesh.first.c_str(), phase_name.c_str(), "-",
+                            m.seconds, "-", (unsigned long long)m.allocations,
+                            "-", status.c_str());
+                missing++;
+                failures++;
+                continue;
+            }
+
+            double phase_tolerance = base["tolerance"]
+                                         ? base["tolerance"].as< double >()
+                                         : tolerance;
+            char expected_col[16] = "-", change_col[16] = "-",
+                 base_col[24] = "-";
+            if (base["seconds"]) {
+                double expected = base["seconds"].as< double >() * scale;
+                double change = (m.seconds - expected) / expected * 100;
+                std::snprintf(expected_col, sizeof(expected_col), "%.4fs",
+                              expected);
+                std::snprintf(change_col, sizeof(change_col), "%+.1f%%",
+                              change);
+                if (m.seconds > expected * (1 + phase_tolerance)) {
+                    status += " SLOWER";
+                    failures++;
+                } else if (m.seconds * (1 + phase_tolerance) < expected) {
+                    status += " faster (update the baseline?)";
+                }
+            }
+            if (base["allocations"]) {
+                uint64_t base_allocs = base["allocations"].as< uint64_t >();
+                std::snprintf(base_col, sizeof(base_col), "%llu",
+                              (unsigned long long)base_allocs);
+                if (m.allocations > base_allocs * (1 + alloc_tolerance)) {
+                    status += " MORE ALLOCATIONS";
+                    failures++;
+                }
+            }
+            if (status.empty()) status = " ok";
+            std::printf("%-22s %-14s %11s %10.4fs %8s %10llu %10s %s\n",
+                        mesh.first.c_str(), phase_name.c_str(), expected_col,
+                        m.seconds, change_col,
+                        (unsigned long long)m.allocations, base_col,
+                        status.c_str());
+        }
+    }
+    if (missing)
+        std::printf("\n%d phase(s) have no baseline: record one on the "
+                    "reference machine with make perf_baseline\n",
+                    missing);
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    std::string baseline_file, output_file;
+    size_t reps = 5;
+    double tolerance = -1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i], val = argv[i + 1];
+        if (opt == "--baseline") {
+            baseline_file = val;
+        } else if (opt == "--write-baseline") {
+            output_file = val;
+        } else if (opt == "--reps") {
+            reps = std::max(1ul, std::stoul(val));
+        } else if (opt == "--tolerance") {
+            tolerance = std::stod(val);
+        } else {
+            std::cerr << "unknown option " << opt << "\n";
+            return 2;
+        }
+    }
+    if (baseline_file.empty() == output_file.empty()) {
+        std::cerr << "usage: perf_regression (--baseline | --write-baseline) "
+                     "file [--reps N] [--tolerance T]\n";
+        return 2;
+    }
+
+    double calib = calibration(reps);
+    results_t results;
+    for (auto& gen : test_meshes()) results[gen->name()] = run_mesh(*gen, reps);
+
+    if (!output_file.empty()) {
+        write_baseline(output_file, calib, results);
+        std::cout << "baseline written to " << output_file << "\n";
+        return 0;
+    }
+
+    YAML::Node baseline = YAML::LoadFile(baseline_file);
+    if (tolerance < 0) tolerance = baseline["tolerance"].as< double >();
+    int failures = compare(baseline, calib, tolerance, results);
+    if (failures) {
+        std::printf("\nFAILED: %d check(s) out of tolerance\n", failures);
+        return 1;
+    }
+    std::printf("\nall phases within tolerance\n");
+    return 0;
+}
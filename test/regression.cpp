@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "scomplex/chain_io.hpp"
+#include "scomplex/coeff_flow.hpp"
+#include "scomplex/coeff_ring.hpp"
+#include "scomplex/cohomology.hpp"
+#include "scomplex/incremental_chain.hpp"
+#include "scomplex/mesh_generator.hpp"
+#include "scomplex/qhull_parsing.hpp"
+#include "scomplex/simplicial_complex.hpp"
+#include "scomplex/surface.hpp"
+#include "scomplex/types.hpp"
+#include "scomplex/weld.hpp"
+
+//
+// regression test (run by ctest): known answers for the cases that went
+// wrong before, on small generated meshes
+//
+// usage: regression
+//
+// every check that fails is printed, the exit status is the number of
+// failed checks.
+//
+
+int failures = 0;
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            failures++;                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << context \
+                      << ": " #cond "\n";                                \
+        }                                                                \
+    } while (0)
+
+std::string context;
+
+// the top cells within radius steps (through facets) of center
+std::vector< double > ball(gsimp::simplicial_complex& s_comp, size_t center,
+                           size_t radius) {
+    int d = s_comp.dimension();
+    auto faces = s_comp.faces_view(d);
+    auto cofaces = s_comp.cofaces_view(d - 1);
+    std::vector< double > in(s_comp.get_level_size(d), 0);
+    std::vector< size_t > front{center};
+    in[center] = 1;
+    for (size_t step = 0; step < radius; ++step) {
+        std::vector< size_t > next;
+        for (size_t sigma : front)
+            for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k) {
+                size_t tau = faces.cells[k];
+                for (size_t j = cofaces.begin(tau); j < cofaces.end(tau); ++j)
+                    if (in[cofaces.cells[j]] == 0) {
+                        in[cofaces.cells[j]] = 1;
+                        next.push_back(cofaces.cells[j]);
+                    }
+            }
+        front.swap(next);
+    }
+    return in;
+}
+
+gsimp::chain_v boundary_of(gsimp::simplicial_complex& s_comp,
+                           const gsimp::chain_v& c) {
+    return gsimp::to_chain_v(gsimp::boundary(
+        s_comp, gsimp::to_ring_chain< gsimp::real_ring >(c)));
+}
+
+gsimp::chain_t sparse_of(gsimp::simplicial_complex& s_comp,
+                         const gsimp::chain_v& c) {
+    gsimp::chain_t sparse = s_comp.new_chain(c.first);
+    for (size_t i = 0; i < c.second.size(); ++i)
+        if (c.second[i] != 0)
+            gsimp::chain_rep(sparse).insertBack(i) = c.second[i];
+    return sparse;
+}
+
+gsimp::chain_v dense_of(const gsimp::chain_t& c) {
+    gsimp::chain_v dense(c.first, std::vector< double >(c.second.size(), 0));
+    for (gsimp::vector_t::InnerIterator it(c.second); it; ++it)
+        dense.second[it.index()] = it.value();
+    return dense;
+}
+
+bool strictly_increasing(const gsimp::chain_t& c) {
+    long last = -1;
+    for (gsimp::vector_t::InnerIterator it(c.second); it; ++it) {
+        if (it.index() <= last) return false;
+        last = it.index();
+    }
+    return true;
+}
+
+// the lowest index of a facet on the boundary of a region of top cells
+size_t first_boundary_facet(gsimp::simplicial_complex& s_comp,
+                            const std::vector< double >& region) {
+    int d = s_comp.dimension();
+    auto faces = s_comp.faces_view(d);
+    auto cofaces = s_comp.cofaces_view(d - 1);
+    size_t first = size_t(-1);
+    for (size_t sigma = 0; sigma < region.size(); ++sigma) {
+        if (region[sigma] == 0) continue;
+        for (size_t k = faces.begin(sigma); k < faces.end(sigma); ++k) {
+            size_t tau = faces.cells[k], inside = 0;
+            for (size_t j = cofaces.begin(tau); j < cofaces.end(tau); ++j)
+                inside += region[cofaces.cells[j]] != 0;
+            if (inside == 1) first = std::min(first, tau);
+        }
+    }
+    return first;
+}
+
+// the local and sparse flows of the boundary of cells against the dense
+// flows (from the zero cells on closed meshes), and through the boundary
+void check_local_flows(const gsimp::mesh_generator& gen,
+                       gsimp::simplicial_complex& s_comp,
+                       const gsimp::chain_v& cells,
+                       const std::vector< size_t >& zeros) {
+    int d = s_comp.dimension();
+    gsimp::chain_v cycle = boundary_of(s_comp, cells);
+    gsimp::chain_t sparse = sparse_of(s_comp, cycle);
+
+    gsimp::chain_t local;
+    gsimp::coeff_flow_local(s_comp, sparse, local);
+    CHECK(strictly_increasing(local));
+    CHECK(boundary_of(s_comp, dense_of(local)) == cycle);
+    if (!gen.closed()) {
+        gsimp::chain_v dense;
+        gsimp::coeff_flow_embedded(s_comp, cycle, dense);
+        CHECK(dense_of(local) == dense);
+        // from the bounding chain of nothing
+        gsimp::chain_v updated = s_comp.new_v_chain(d);
+        gsimp::update_bounding_chain(s_comp, updated, sparse);
+        CHECK(updated == dense);
+        return;
+    }
+    for (size_t zero : zeros) {
+        std::vector< std::pair< size_t, double > > flow;
+        gsimp::coeff_flow_sparse(s_comp, sparse, zero, flow);
+        gsimp::chain_v dense;
+        gsimp::chain_v from_sparse = s_comp.new_v_chain(d);
+        gsimp::coeff_flow(s_comp, cycle, zero, 0, dense);
+        for (size_t i = 0; i < flow.size(); ++i) {
+            CHECK(i == 0 || flow[i - 1].first < flow[i].first);
+            from_sparse.second[flow[i].first] = flow[i].second;
+        }
+        CHECK(from_sparse == dense);
+        CHECK(boundary_of(s_comp, from_sparse) == cycle);
+    }
+}
+
+// cycles bounding sums of nested (the inner one indexed first, too),
+// disjoint and complementary balls
+void local_flows() {
+    std::vector< std::unique_ptr< gsimp::mesh_generator > > meshes;
+    meshes.emplace_back(new gsimp::grid_mesh(40, 40, 0.3, false, 3));
+    meshes.emplace_back(new gsimp::sphere_mesh(24, 32));
+    meshes.emplace_back(new gsimp::torus_mesh(40, 12));
+    std::mt19937 rng(11);
+    for (auto& gen : meshes) {
+        for (int reordering : {0, 3}) {
+            context = gen->name() + " r" + std::to_string(reordering);
+            auto input = gsimp::complex_input(gsimp::generate_mesh(*gen));
+            gsimp::simplicial_complex s_comp(input.first, input.second,
+                                             reordering);
+            int d = s_comp.dimension();
+            size_t n = s_comp.get_level_size(d);
+            auto sum = [&](const std::vector< std::vector< double > >& parts) {
+                gsimp::chain_v cells(d, std::vector< double >(n, 0));
+                for (auto& part : parts)
+                    for (size_t i = 0; i < n; ++i) cells.second[i] += part[i];
+                return cells;
+            };
+
+            std::vector< gsimp::chain_v > cases;
+            for (size_t center : {size_t(0), n / 3, n - 1}) {
+                auto inner = ball(s_comp, center, 3);
+                auto outer = ball(s_comp, center, 8);
+                auto other = ball(s_comp, (center + n / 2) % n, 3);
+                cases.push_back(sum({inner, outer}));
+                cases.push_back(sum({inner, outer, other}));
+                cases.push_back(sum({inner, other}));
+                if (gen->closed()) {
+                    // a cap and the complement of a larger one
+                    auto rest = ball(s_comp, center, 6);
+                    for (double& x : rest) x = 1 - x;
+                    cases.push_back(sum({inner, rest}));
+                }
+            }
+            // a small ball well inside a larger one, with the lowest facet
+            // of the cycle on the small one
+            size_t nested = 0;
+            for (int trial = 0; trial < 20 && nested < 4; ++trial) {
+                auto outer = ball(s_comp, rng() % n, 10);
+                size_t outer_first = first_boundary_facet(s_comp, outer);
+                for (size_t center = 0; center < n; ++center) {
+                    if (outer[center] == 0) continue;
+                    auto margin = ball(s_comp, center, 3);
+                    bool inside = true;
+                    for (size_t i = 0; i < n; ++i)
+                        inside = inside && (margin[i] == 0 || outer[i] != 0);
+                    auto inner = ball(s_comp, center, 1);
+                    if (!inside ||
+                        first_boundary_facet(s_comp, inner) >= outer_first)
+                        continue;
+                    cases.push_back(sum({inner, outer}));
+                    if (gen->closed()) {
+                        auto rest(outer);
+                        for (double& x : rest) x = 1 - x;
+                        cases.push_back(sum({inner, rest}));
+                    }
+                    nested++;
+                    break;
+                }
+            }
+            // a small ball in the hole of an annulus (the disc filling the
+            // hole nests it)
+            for (size_t center = 0; center < n && nested < 8; center += 7) {
+                auto inner = ball(s_comp, center, 1);
+                auto annulus = ball(s_comp, center, 12);
+                auto hole = ball(s_comp, center, 4);
+                for (size_t i = 0; i < n; ++i) annulus[i] -= hole[i];
+                if (first_boundary_facet(s_comp, inner) >=
+                    first_boundary_facet(s_comp, annulus))
+                    continue;
+                cases.push_back(sum({inner, annulus}));
+                nested++;
+            }
+            CHECK(nested > 0);
+            for (auto& cells : cases)
+                check_local_flows(*gen, s_comp, cells, {n - 1, n / 2});
+        }
+    }
+}
+
+// the sparse flow of a cycle in two pieces on a closed sphere: the boundary
+// of the north cap plus that of everything past three more bands, from the
+// last cell
+void sphere_bands() {
+    const size_t n_lat = 24, n_lon = 32;
+    gsimp::sphere_mesh gen(n_lat, n_lon);
+    auto mesh = gsimp::generate_mesh(gen);
+    auto input = gsimp::complex_input(mesh);
+    // the two regions, oriented as the generator (outwards), in the order
+    // of the complex built without reordering
+    gsimp::simplicial_complex plain(input.first, input.second, 0);
+    gsimp::chain_v cells = plain.new_v_chain(2);
+    for (size_t c = 0; c < gen.num_cells(); ++c) {
+        // the cap, three bands of two triangles per meridian, the rest
+        if (c >= n_lon && c < 7 * n_lon) continue;
+        gsimp::cell_t vs(mesh.cells.begin() + 3 * c,
+                         mesh.cells.begin() + 3 * (c + 1));
+        double sign = 1;
+        for (int i = 0; i < 3; ++i)
+            for (int j = i + 1; j < 3; ++j)
+                if (vs[i] > vs[j]) sign = -sign;
+        std::sort(vs.begin(), vs.end());
+        cells.second[plain.cell_to_index(vs)] = sign;
+    }
+    for (int reordering : {0, 3}) {
+        context = "sphere bands r" + std::to_string(reordering);
+        gsimp::simplicial_complex s_comp(input.first, input.second,
+                                         reordering);
+        size_t n = s_comp.get_level_size(2);
+        gsimp::chain_v cycle =
+            boundary_of(s_comp, s_comp.from_original_order(cells));
+        std::vector< std::pair< size_t, double > > flow;
+        gsimp::coeff_flow_sparse(s_comp, sparse_of(s_comp, cycle), n - 1,
+                                 flow);
+        gsimp::chain_v result = s_comp.new_v_chain(2);
+        for (auto& cell : flow) result.second[cell.first] += cell.second;
+        CHECK(boundary_of(s_comp, result) == cycle);
+        gsimp::chain_v dense;
+        gsimp::coeff_flow(s_comp, cycle, n - 1, 0, dense);
+        CHECK(result == dense);
+    }
+}
+
+// true when f throws std::runtime_error
+template < typename F >
+bool throws(F f) {
+    try {
+        f();
+    } catch (std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// chains written to a chain file and read back, appended to, and rejected
+// (unsorted or out of the complex, on either side, or another snapshot)
+void chain_files() {
+    context = "chain files";
+    const std::string filename = "regression_chains.gsch";
+    std::remove(filename.c_str());
+    gsimp::grid_mesh gen(8, 8, 0, false, 1);
+    auto input = gsimp::complex_input(gsimp::generate_mesh(gen));
+    gsimp::simplicial_complex s_comp(input.first, input.second);
+    auto header = gsimp::chain_header(s_comp, "grid");
+    size_t num_edges = s_comp.get_level_size(1);
+
+    gsimp::chain_v dense = s_comp.new_v_chain(1);
+    dense.second[0] = 3;
+    dense.second[num_edges - 1] = -7;
+    gsimp::chain_t sparse = sparse_of(s_comp, dense);
+    {
+        gsimp::chain_writer writer(filename, header);
+        writer.write(dense);
+        writer.write(sparse);
+        CHECK(throws([&] { writer.write(1, {{5, 1}, {2, 1}}); }));
+        CHECK(throws([&] { writer.write(1, {{2, 1}, {2, 1}}); }));
+        CHECK(throws([&] { writer.write(1, {{num_edges, 1}}); }));
+        // coefficients past int64_t
+        gsimp::chain_v huge = s_comp.new_v_chain(1);
+        for (double coef : {1e19, -1e300, 1.0 / 0.0}) {
+            huge.second[1] = coef;
+            CHECK(throws([&] { writer.write(huge); }));
+        }
+        CHECK(writer.chains_written() == 2);
+    }
+    {
+        // appended after the records already there
+        gsimp::chain_writer writer(filename, header);
+        writer.write(sparse);
+        writer.flush();
+    }
+    CHECK(throws([&] {
+        gsimp::chain_writer(filename, gsimp::chain_header(s_comp, "other"));
+    }));
+
+    gsimp::chain_reader reader(filename);
+    CHECK(reader.header() == header);
+    gsimp::chain_v dense_back;
+    gsimp::chain_t sparse_back, appended;
+    CHECK(reader.read(dense_back) && dense_back == dense);
+    CHECK(reader.read(sparse_back) && dense_of(sparse_back) == dense);
+    CHECK(reader.read(appended) && dense_of(appended) == dense);
+    CHECK(!reader.read(dense_back));
+
+    // records the writer refuses, written by hand: an index past the level
+    // and a gap wrapping around to a valid one
+    for (auto support : {gsimp::chain_support_t{{num_edges, 1}},
+                         gsimp::chain_support_t{{100000, 1}, {2, 1}}}) {
+        std::string bytes = gsimp::chain_io::encode_header(header);
+        gsimp::chain_io::encode_record(bytes, 1, support);
+        std::ofstream(filename, std::ios::binary) << bytes;
+        gsimp::chain_reader bad(filename);
+        CHECK(throws([&] { bad.read(dense_back); }));
+    }
+
+    // lengths far past the end of the file: the snapshot, the level count
+    // and a record
+    const uint64_t far = uint64_t(1) << 62;
+    std::string start = gsimp::chain_io::encode_header(header).substr(0, 5);
+    std::string bytes = start;
+    gsimp::chain_io::put_varint(bytes, far);
+    std::ofstream(filename, std::ios::binary) << bytes << "grid";
+    CHECK(throws([&] { gsimp::chain_reader bad(filename); }));
+    bytes = start;
+    gsimp::chain_io::put_varint(bytes, 0);
+    gsimp::chain_io::put_varint(bytes, far);
+    std::ofstream(filename, std::ios::binary) << bytes << "\x01\x02";
+    CHECK(throws([&] { gsimp::chain_reader bad(filename); }));
+    bytes = gsimp::chain_io::encode_header(header);
+    gsimp::chain_io::put_varint(bytes, far);
+    std::ofstream(filename, std::ios::binary) << bytes << "\x01\x02";
+    gsimp::chain_reader bad(filename);
+    CHECK(throws([&] { bad.read(dense_back); }));
+    std::remove(filename.c_str());
+}
+
+// a closed mesh scattered the way scans come (every cell on its own copies
+// of its vertices, some cells twice, some degenerate) welds back to itself
+void weld_back() {
+    gsimp::thread_pool pool(4);
+    gsimp::torus_mesh gen(40, 12);
+    const gsimp::flat_mesh mesh = gsimp::generate_mesh(gen, pool);
+    size_t n = mesh.num_points(), m = mesh.num_cells(), k = mesh.cell_size;
+    for (double tolerance : {0.0, 1e-6}) {
+        context = "weld, tolerance " + std::to_string(tolerance);
+        // the points, then a copy (nudged within the tolerance) of the
+        // vertices of each cell, which the cells use
+        gsimp::flat_mesh scan = mesh;
+        scan.cells.clear();
+        for (size_t c = 0; c < m; ++c)
+            for (size_t j = 0; j < k; ++j) {
+                size_t v = mesh.cells[c * k + j];
+                for (int a = 0; a < 3; ++a)
+                    scan.coordinates.push_back(mesh.coordinates[3 * v + a] +
+                                               tolerance / 4);
+                scan.cells.push_back(scan.num_points() - 1);
+            }
+        // every fifth cell again, rotated, and a cell on one edge per tenth
+        size_t duplicates = 0, degenerate = 0;
+        for (size_t c = 0; c < m; c += 5, ++duplicates)
+            for (size_t j = 0; j < k; ++j)
+                scan.cells.push_back(mesh.cells[c * k + (j + 1) % k]);
+        for (size_t c = 0; c < m; c += 10, ++degenerate)
+            for (size_t j = 0; j < k; ++j)
+                scan.cells.push_back(mesh.cells[c * k + std::min< size_t >(
+                                                            j, 1)]);
+
+        auto report = gsimp::weld_mesh(scan, tolerance, pool);
+        CHECK(report.welded_points == m * k);
+        CHECK(report.duplicate_cells == duplicates);
+        CHECK(report.degenerate_cells == degenerate);
+        CHECK(scan.num_points() == n && scan.cells == mesh.cells);
+        CHECK(std::equal(mesh.coordinates.begin(), mesh.coordinates.end(),
+                         scan.coordinates.begin()));
+    }
+
+    // a vertex past the points is refused before anything changes
+    context = "weld, bad cell";
+    gsimp::flat_mesh bad = mesh;
+    bad.coordinates.insert(bad.coordinates.end(), mesh.coordinates.begin(),
+                           mesh.coordinates.begin() + 3);
+    bad.cells.back() = bad.num_points();
+    gsimp::flat_mesh before = bad;
+    CHECK(throws([&] { gsimp::weld_mesh(bad, 0, pool); }));
+    CHECK(bad.coordinates == before.coordinates && bad.cells == before.cells);
+}
+
+// the surface engine refuses a repeated triangle (it would pass for the
+// twin of itself) and a start triangle it does not have
+void surface_checks() {
+    context = "surface";
+    gsimp::sphere_mesh gen(6, 8);
+    gsimp::flat_mesh mesh = gsimp::generate_mesh(gen);
+    gsimp::surface_mesh surface(mesh);
+    std::vector< double > cycle(surface.num_edges(), 0), chain;
+    surface.coeff_flow(cycle, 0, 0, chain);
+    CHECK(chain == std::vector< double >(surface.num_triangles(), 0));
+    bool refused = false;
+    try {
+        surface.coeff_flow(cycle, surface.num_triangles(), 0, chain);
+    } catch (gsimp::out_of_context&) {
+        refused = true;
+    }
+    CHECK(refused);
+
+    // the first triangle again, turned around: between all its neighbours
+    // (three triangles on its edges), then next to a single one (two)
+    mesh.cells.insert(mesh.cells.end(),
+                      {mesh.cells[1], mesh.cells[0], mesh.cells[2]});
+    CHECK(throws([&] { gsimp::surface_mesh repeated(mesh); }));
+    mesh.cells.erase(mesh.cells.begin() + 6, mesh.cells.end() - 3);
+    CHECK(throws([&] { gsimp::surface_mesh repeated(mesh); }));
+}
+
+// rbox + qhull output read back, and numbers with trailing garbage refused
+void qhull_files() {
+    context = "qhull files";
+    const std::string filename = "regression_qhull.txt";
+    const std::string points = "2 rbox 4 D2\n4\n0 0\n1 0\n0 1\n1 1\n";
+    std::ofstream(filename) << points << "2\n0 1 2\n1 3 2\n";
+    auto mesh = parse_qhull_flat(filename);
+    CHECK(mesh.dimension == 2 && mesh.cell_size == 3);
+    CHECK(mesh.coordinates.size() == 8 && mesh.coordinates[5] == 1);
+    CHECK((mesh.cells == std::vector< size_t >{0, 1, 2, 1, 3, 2}));
+
+    for (std::string bad : {"2\n0 1 2\n1 3 2x\n", "2\n0 1 2\n1 3 2.5\n"}) {
+        std::ofstream(filename) << points << bad;
+        CHECK(throws([&] { parse_qhull_flat(filename); }));
+    }
+    std::ofstream(filename) << "2\n1\n1.5abc 0\n0\n";
+    CHECK(throws([&] { parse_qhull_flat(filename); }));
+
+    // the same output from a command, refused when the command fails
+    std::ofstream(filename) << points << "2\n0 1 2\n1 3 2\n";
+    CHECK(parse_qhull_command("cat " + filename).cells == mesh.cells);
+    CHECK(throws([&] { parse_qhull_command("cat " + filename + "; exit 3"); }));
+    CHECK(throws([&] { parse_qhull_command("exit 1"); }));
+    std::remove(filename.c_str());
+}
+
+// the cohomology basis of closed surfaces, orientable or not: its rank is
+// the first Betti number over the reals and the boundary of every triangle
+// is a boundary
+void check_basis(const std::string& name, std::vector< gsimp::cell_t > cells,
+                 size_t betti) {
+    context = "cohomology " + name;
+    size_t num_points = 0;
+    for (auto& cell : cells)
+        for (size_t v : cell) num_points = std::max(num_points, v + 1);
+    std::vector< gsimp::point_t > points;
+    for (size_t v = 0; v < num_points; ++v)
+        points.push_back({double(v), double(v * v % 7), double(v % 3)});
+    auto s_comp =
+        std::make_shared< gsimp::simplicial_complex >(points, cells);
+    gsimp::cohomology_basis basis(s_comp);
+    CHECK(basis.rank() == betti);
+    size_t n = s_comp->get_level_size(2);
+    for (size_t sigma = 0; sigma < n; ++sigma) {
+        gsimp::chain_v cell = s_comp->new_v_chain(2);
+        cell.second[sigma] = 1;
+        CHECK(basis.is_boundary(boundary_of(*s_comp, cell)));
+    }
+}
+
+void cohomology_checks() {
+    // the projective plane on six vertices
+    check_basis("RP2",
+                {{0, 1, 2}, {0, 2, 3}, {0, 3, 4}, {0, 4, 5}, {0, 1, 5},
+                 {1, 2, 4}, {2, 3, 5}, {1, 3, 4}, {2, 4, 5}, {1, 3, 5}},
+                0);
+    // 4 x 4 squares, the top row glued to the bottom one flipped (a Klein
+    // bottle) or not (a torus)
+    for (bool flip : {true, false}) {
+        const size_t k = 4;
+        auto vertex = [&](size_t i, size_t j) {
+            if (j == k) return (flip ? (k - i) % k : i % k) * k;
+            return (i % k) * k + j;
+        };
+        std::vector< gsimp::cell_t > cells;
+        for (size_t i = 0; i < k; ++i)
+            for (size_t j = 0; j < k; ++j) {
+                size_t a = vertex(i, j), b = vertex(i + 1, j);
+                size_t c = vertex(i, j + 1), d = vertex(i + 1, j + 1);
+                cells.push_back({a, b, d});
+                cells.push_back({a, d, c});
+            }
+        check_basis(flip ? "Klein bottle" : "torus", cells, flip ? 1 : 2);
+    }
+}
+
+// a complex in vertex labels, the same however it came about: the cells of
+// every level without the tombstones, the entries of the boundary matrices
+// (none stored for tombstones, none zero), the cofaces and the boundary
+// facets (in increasing index order)
+struct labelled_complex {
+    std::vector< std::set< gsimp::cell_t > > cells;
+    std::map< std::pair< gsimp::cell_t, gsimp::cell_t >, double > entries;
+    std::set< std::pair< gsimp::cell_t, gsimp::cell_t > > cofaces;
+    std::set< std::tuple< gsimp::cell_t, gsimp::cell_t, int > > boundary;
+
+    explicit labelled_complex(gsimp::simplicial_complex& s_comp) {
+        int dim = s_comp.dimension();
+        auto live = [&](int d, size_t i) {
+            auto& tombstones = s_comp.tombstones(d);
+            return tombstones.empty() || !tombstones[i];
+        };
+        cells.resize(dim + 1);
+        for (int d = 0; d <= dim; ++d)
+            for (size_t i = 0; i < size_t(s_comp.get_level_size(d)); ++i) {
+                if (!live(d, i)) continue;
+                gsimp::cell_t cell = s_comp.index_to_cell(d, i);
+                cells[d].insert(cell);
+                if (d == dim) continue;
+                for (size_t j : s_comp.get_cofaces_index(d, i))
+                    cofaces.emplace(cell, s_comp.index_to_cell(d + 1, j));
+            }
+        for (int d = 0; d < dim; ++d) {
+            gsimp::matrix_t matrix = s_comp.get_boundary_matrix(d);
+            for (int j = 0; j < matrix.outerSize(); ++j)
+                for (gsimp::matrix_t::InnerIterator it(matrix, j); it; ++it) {
+                    CHECK(live(d + 1, j) && it.value() != 0);
+                    entries[{s_comp.index_to_cell(d, it.row()),
+                             s_comp.index_to_cell(d + 1, j)}] = it.value();
+                }
+        }
+        size_t last = 0;
+        for (auto& f : s_comp.boundary_facets()) {
+            CHECK(boundary.empty() || f.facet > last);
+            last = f.facet;
+            boundary.emplace(s_comp.index_to_cell(dim - 1, f.facet),
+                             s_comp.index_to_cell(dim, f.coface), f.sign);
+        }
+    }
+};
+
+// a grid updated twice in place (cells removed, then some of them back with
+// new points and faces) against the complex built from its final cells
+void updates() {
+    context = "updates";
+    gsimp::grid_mesh gen(8, 8, 0.3, false, 5);
+    auto input = gsimp::complex_input(gsimp::generate_mesh(gen));
+    std::vector< gsimp::point_t > points = input.first;
+    gsimp::simplicial_complex s_comp(points, input.second);
+    s_comp.prepare();
+    size_t n = s_comp.get_level_size(2);
+
+    std::vector< gsimp::cell_t > removed, restored;
+    for (size_t sigma = 0; sigma < n; sigma += 3) {
+        removed.push_back(s_comp.index_to_cell(2, sigma));
+        if (sigma % 2 == 0) restored.push_back(removed.back());
+    }
+    s_comp.update_cells({}, removed, {});
+    CHECK(s_comp.num_tombstones(2) == removed.size());
+
+    // two points on the edge of the grid along vertices 0 1 2, and a
+    // triangle of its own
+    size_t p = points.size();
+    std::vector< gsimp::point_t > added{{-0.6, -0.5, 0}, {-0.6, -0.3, 0},
+                                        {2, 2, 0},       {3, 2, 0},
+                                        {2, 3, 0}};
+    std::vector< gsimp::cell_t > inserted(restored);
+    inserted.push_back({0, 1, p});
+    inserted.push_back({1, p, p + 1});
+    inserted.push_back({1, 2, p + 1});
+    inserted.push_back({p + 2, p + 3, p + 4});
+    std::vector< gsimp::cell_t > more{s_comp.index_to_cell(2, 1),
+                                      s_comp.index_to_cell(2, n - 1)};
+    auto report = s_comp.update_cells(added, more, inserted);
+    CHECK(report.first_point == p);
+    CHECK(report.added[2].size() == inserted.size());
+
+    std::vector< gsimp::cell_t > cells;
+    for (size_t sigma = 0; sigma < n; ++sigma) {
+        gsimp::cell_t cell = s_comp.index_to_cell(2, sigma);
+        if (!s_comp.tombstones(2)[sigma]) cells.push_back(cell);
+    }
+    for (size_t sigma = n; sigma < size_t(s_comp.get_level_size(2)); ++sigma)
+        cells.push_back(s_comp.index_to_cell(2, sigma));
+    CHECK(cells.size() == n - removed.size() - more.size() + inserted.size());
+    points.insert(points.end(), added.begin(), added.end());
+    gsimp::simplicial_complex rebuilt(points, cells);
+    rebuilt.prepare();
+
+    labelled_complex updated(s_comp), expected(rebuilt);
+    CHECK(updated.cells == expected.cells);
+    CHECK(updated.entries == expected.entries);
+    CHECK(updated.cofaces == expected.cofaces);
+    CHECK(updated.boundary == expected.boundary);
+}
+
+int main() {
+    local_flows();
+    sphere_bands();
+    chain_files();
+    weld_back();
+    surface_checks();
+    qhull_files();
+    cohomology_checks();
+    updates();
+    if (failures) std::cerr << failures << " checks failed\n";
+    return failures;
+}
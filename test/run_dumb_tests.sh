@@ -64,7 +64,7 @@ cat dumb_testlog | \
     grep '\(^test done$\|number of\|bounding chain\)' >> results.csv
 
 # remove the parts of the lines that aren't the data (i.e. the useless text)
-sed 's/\(.*number of [a-z]\+: \|test done\|\(calculated.\+\)\@=[0-9]\+\.\|calculated.*cycles \| seconds\)//g' -i results.csv
+sed 's/\(.*number of [a-z]\+: \|test done\|\(calculated.\+\)\@=[0-9]\+\.\|calculated.* in \| seconds\)//g' -i results.csv
 
 # put the data from each test into a single comma separated line
 sed ':a;/[0-9]$/{N;s/\n/ , /;ba}' -i results.csv